@@ -0,0 +1,259 @@
+/*
+ * Copyright 2015 - 2025
+ * Andr\xe9 Malo or his licensors, as applicable
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Microbenchmark for the token delimiter scanners
+ *
+ * Tokenizes a libsvm formatted buffer with the byte-wise switch loop the
+ * token reader used before and with each scanner implementation from
+ * pyliblinear/scan.c. Build and run from the source root:
+ *
+ *   cc -O2 -DEXT_MODULE=_bench -I. -Ipyliblinear -Ipyliblinear/liblinear \
+ *      $(python3-config --includes) bench/scan_bench.c -o scan_bench
+ *   ./scan_bench [file]
+ *
+ * Without a file argument, a1a-like data is generated, once with binary and
+ * once with real valued features.
+ */
+
+#include "scan.c"
+
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_ROUNDS (20)
+
+
+/*
+ * Generate a1a-like data: -1/+1 labels, 14 sorted features per line
+ *
+ * The features are either binary (like a1a) or real valued, printed with
+ * full precision (like scaled data sets).
+ */
+static char *
+bench_generate(size_t lines, int real, size_t *size_)
+{
+    char *data, *c;
+    size_t j, k;
+    int index;
+
+    if (!(data = malloc(lines * (real ? 400 : 80))))
+        return NULL;
+
+    srand(42);
+    for (c = data, j = 0; j < lines; ++j) {
+        c += sprintf(c, "%s", (rand() % 4) ? "-1" : "+1");
+        for (index = 0, k = 0; k < 14; ++k) {
+            index += 1 + rand() % 8;
+            if (real)
+                c += sprintf(c, " %d:%.17g", index,
+                             (double)rand() / RAND_MAX);
+            else
+                c += sprintf(c, " %d:1", index);
+        }
+        c += sprintf(c, " \n");
+    }
+    *size_ = (size_t)(c - data);
+
+    return data;
+}
+
+
+static char *
+bench_read(const char *filename, size_t *size_)
+{
+    FILE *fp;
+    char *data;
+    long size;
+
+    if (!(fp = fopen(filename, "rb")))
+        return NULL;
+    if (fseek(fp, 0, SEEK_END) || (size = ftell(fp)) < 0
+        || fseek(fp, 0, SEEK_SET) || !(data = malloc((size_t)size + 1))) {
+        fclose(fp);
+        return NULL;
+    }
+    *size_ = fread(data, 1, (size_t)size, fp);
+    fclose(fp);
+
+    return data;
+}
+
+
+/*
+ * The token reader's former scanning loop
+ */
+static size_t
+bench_tokenize_switch(const char *c, const char *s)
+{
+    size_t toks = 0;
+    int in_tok = 0, cr = 0;
+
+    while (c < s) {
+        if (in_tok) {
+            switch (*c) {
+            case ' ': case '\t': case '\n': case '\r':
+                in_tok = 0;
+                ++toks;
+                break;
+
+            case '\0':
+                return 0;
+
+            default:
+                ++c;
+                break;
+            }
+        }
+        else {
+            switch (*c++) {
+            case ' ': case '\t': case '\0':
+                if (cr) { cr = 0; ++toks; }
+                break;
+
+            case '\n':
+                cr = 0;
+                ++toks;
+                break;
+
+            case '\r':
+                if (cr) ++toks;
+                cr = 1;
+                break;
+
+            default:
+                in_tok = 1;
+                if (cr) { cr = 0; ++toks; }
+                break;
+            }
+        }
+    }
+
+    return toks + (size_t)in_tok;
+}
+
+
+/*
+ * The token reader's current scanning loop
+ */
+static size_t
+bench_tokenize_scan(pl_scan_delim_fn *scan, const char *c, const char *s)
+{
+    size_t toks = 0;
+    int in_tok = 0, cr = 0;
+
+    while (c < s) {
+        if (in_tok) {
+            if ((c = scan(c, s)) == s)
+                break;
+            if (!*c)
+                return 0;
+            in_tok = 0;
+            ++toks;
+        }
+        else {
+            switch (*c++) {
+            case ' ': case '\t': case '\0':
+                if (cr) { cr = 0; ++toks; }
+                break;
+
+            case '\n':
+                cr = 0;
+                ++toks;
+                break;
+
+            case '\r':
+                if (cr) ++toks;
+                cr = 1;
+                break;
+
+            default:
+                in_tok = 1;
+                if (cr) { cr = 0; ++toks; }
+                break;
+            }
+        }
+    }
+
+    return toks + (size_t)in_tok;
+}
+
+
+static void
+bench_report(const char *name, size_t size, size_t toks, clock_t ticks)
+{
+    double secs = (double)ticks / CLOCKS_PER_SEC;
+
+    printf("%-8s %10lu tokens %8.3f s %10.1f MB/s\n", name,
+           (unsigned long)toks, secs,
+           secs > 0 ? (double)size * BENCH_ROUNDS / secs / 1e6 : 0.0);
+}
+
+
+#define BENCH(name, expr) do {                  \
+    clock_t start = clock();                    \
+    for (toks = 0, r = 0; r < BENCH_ROUNDS; ++r) \
+        toks = (expr);                          \
+    bench_report(name, size, toks, clock() - start); \
+} while (0)
+
+
+static void
+bench_run(char *data, size_t size)
+{
+    size_t toks;
+    int r;
+
+    printf("%lu bytes, %d rounds\n", (unsigned long)size, BENCH_ROUNDS);
+
+    BENCH("switch", bench_tokenize_switch(data, data + size));
+    BENCH("bytes", bench_tokenize_scan(pl_scan_delim_bytes, data,
+                                       data + size));
+#ifdef PL_SCAN_SSE2
+    BENCH("sse2", bench_tokenize_scan(pl_scan_delim_sse2, data,
+                                      data + size));
+#endif
+#ifdef PL_SCAN_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        BENCH("avx2", bench_tokenize_scan(pl_scan_delim_avx2, data,
+                                          data + size));
+#endif
+
+    free(data);
+}
+
+
+int
+main(int argc, char **argv)
+{
+    char *data;
+    size_t size;
+    int real;
+
+    for (real = 0; real < (argc > 1 ? 1 : 2); ++real) {
+        data = argc > 1 ? bench_read(argv[1], &size)
+                        : bench_generate(200000, real, &size);
+        if (!data) {
+            fprintf(stderr, "Could not load data\n");
+            return 1;
+        }
+        bench_run(data, size);
+    }
+
+    return 0;
+}
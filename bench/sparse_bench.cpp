@@ -0,0 +1,313 @@
+/*
+ * Copyright 2015 - 2025
+ * Andr Malo or his licensors, as applicable
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Correctness check and microbenchmark for the sparse_operator kernels
+ *
+ * Compares the vectorized kernels for structure-of-arrays rows from
+ * pyliblinear/liblinear/linear.cpp against the scalar ones (on rows of all
+ * lengths up to 67) and fails if they differ by more than a relative
+ * 1e-12. Then times the feature_node kernels, the scalar and the vectorized
+ * structure-of-arrays kernels and the dispatching sparse_operator entry
+ * points (as used by the solvers) on a1a-like rows (14 features) and on
+ * denser rows. The rows fit into the cache, so the kernels are timed, not
+ * the memory bandwidth. Build and run from the source root:
+ *
+ *   c++ -O2 -Ipyliblinear/liblinear bench/sparse_bench.cpp \
+ *       pyliblinear/liblinear/newton.cpp \
+ *       -x c pyliblinear/liblinear/blas/d*.c -o sparse_bench
+ *   ./sparse_bench
+ */
+
+#include "linear.cpp"
+
+#include <time.h>
+
+#define BENCH_NODES (400000)
+#define BENCH_ROUNDS (200)
+#define BENCH_WIDTH (20000)
+
+typedef double (bench_csr_dot_fn)(const double *, csr_row);
+typedef double (bench_csr_nrm2_sq_fn)(csr_row);
+typedef void (bench_csr_axpy_fn)(const double, csr_row, double *);
+
+
+/*
+ * Generate rows with sorted random indices and random values
+ *
+ * Returns the rows, terminated by a NULL row.
+ */
+static feature_node **
+bench_generate(int nnz, int width, feature_node **space_)
+{
+	int rows = BENCH_NODES / nnz;
+	feature_node **x = Malloc(feature_node *, rows + 1);
+	feature_node *space = Malloc(feature_node, (size_t)rows * (nnz + 1));
+	feature_node *node = space;
+
+	for(int j=0; j<rows; j++)
+	{
+		int index = 0;
+		x[j] = node;
+		for(int k=0; k<nnz; k++, node++)
+		{
+			index += 1 + rand() % (width / nnz);
+			node->index = index;
+			node->value = (double)rand() / RAND_MAX - 0.5;
+		}
+		(node++)->index = -1;
+	}
+	x[rows] = NULL;
+	*space_ = space;
+
+	return x;
+}
+
+
+/*
+ * Copy rows into the structure-of-arrays layout
+ *
+ * Returns the rows, terminated by a row with NULL index.
+ */
+static csr_row *
+bench_csr(feature_node **x, int **index_, double **value_)
+{
+	problem prob;
+
+	for(prob.l=0; x[prob.l]; prob.l++)
+		;
+	prob.x = x;
+
+	int64_t *start;
+	build_csr(&prob, index_, value_, &start);
+
+	csr_row *rows = Malloc(csr_row, prob.l + 1);
+	for(int j=0; j<prob.l; j++)
+	{
+		rows[j].index = *index_ + start[j];
+		rows[j].value = *value_ + start[j];
+	}
+	rows[prob.l].index = NULL;
+	free(start);
+
+	return rows;
+}
+
+
+static double *
+bench_vector(int width)
+{
+	double *s = Malloc(double, width);
+
+	for(int k=0; k<width; k++)
+		s[k] = (double)rand() / RAND_MAX - 0.5;
+
+	return s;
+}
+
+
+static bool
+bench_close(const char *name, int nnz, double result, double expected,
+            double scale)
+{
+	if(fabs(result - expected) <= 1e-12 * scale)
+		return true;
+
+	fprintf(stderr, "%s mismatch (%d features): %.17g != %.17g\n", name,
+	        nnz, result, expected);
+	return false;
+}
+
+
+/*
+ * Compare a set of vectorized kernels against the scalar ones
+ */
+static bool
+bench_check(const char *name, bench_csr_dot_fn *dot,
+            bench_csr_nrm2_sq_fn *nrm2_sq)
+{
+	int width = 1000;
+	double *s = bench_vector(width);
+	bool ok = true;
+
+	for(int nnz=0; nnz<68; nnz++)
+	{
+		feature_node *node = Malloc(feature_node, nnz + 1);
+		double scale = 0;
+
+		// Unsorted, duplicate indices are fine for dot and nrm2_sq
+		for(int k=0; k<nnz; k++)
+		{
+			node[k].index = 1 + rand() % width;
+			node[k].value = (double)rand() / RAND_MAX - 0.5;
+			scale += fabs(node[k].value);
+		}
+		node[nnz].index = -1;
+
+		feature_node *x[] = {node, NULL};
+		int *index;
+		double *value;
+		csr_row *row = bench_csr(x, &index, &value);
+
+		ok = bench_close(name, nnz, dot(s, row[0]),
+		                 sparse_operator::dot(s, node), scale) && ok;
+		ok = bench_close(name, nnz, nrm2_sq(row[0]),
+		                 sparse_operator::nrm2_sq(node),
+		                 scale * scale) && ok;
+
+		free(row);
+		free(value);
+		free(index);
+		free(node);
+	}
+
+	free(s);
+	printf("%-8s %s\n", name, ok ? "ok" : "FAILED");
+	return ok;
+}
+
+
+static void
+bench_report(const char *name, const char *kernel, clock_t ticks)
+{
+	double secs = (double)ticks / CLOCKS_PER_SEC;
+
+	printf("%-8s %-8s %8.3f s %8.1f Mnodes/s\n", name, kernel, secs,
+	       secs > 0 ? (double)BENCH_NODES * BENCH_ROUNDS / secs / 1e6 : 0.0);
+}
+
+
+static double
+bench_run(feature_node **x, double *s, double *y)
+{
+	double sink = 0;
+	feature_node **row;
+	clock_t start;
+	int r;
+
+	start = clock();
+	for(r=0; r<BENCH_ROUNDS; r++)
+		for(row=x; *row; row++)
+			sink += sparse_operator::dot(s, *row);
+	bench_report("nodes", "dot", clock() - start);
+
+	start = clock();
+	for(r=0; r<BENCH_ROUNDS; r++)
+		for(row=x; *row; row++)
+			sink += sparse_operator::nrm2_sq(*row);
+	bench_report("nodes", "nrm2_sq", clock() - start);
+
+	start = clock();
+	for(r=0; r<BENCH_ROUNDS; r++)
+		for(row=x; *row; row++)
+			sparse_operator::axpy(1e-9, *row, y);
+	bench_report("nodes", "axpy", clock() - start);
+
+	return sink;
+}
+
+
+/*
+ * Time a set of structure-of-arrays kernels (axpy may be NULL)
+ */
+static double
+bench_run_csr(const char *name, bench_csr_dot_fn *dot,
+              bench_csr_nrm2_sq_fn *nrm2_sq, bench_csr_axpy_fn *axpy,
+              csr_row *x, double *s, double *y)
+{
+	double sink = 0;
+	csr_row *row;
+	clock_t start;
+	int r;
+
+	start = clock();
+	for(r=0; r<BENCH_ROUNDS; r++)
+		for(row=x; row->index; row++)
+			sink += dot(s, *row);
+	bench_report(name, "dot", clock() - start);
+
+	start = clock();
+	for(r=0; r<BENCH_ROUNDS; r++)
+		for(row=x; row->index; row++)
+			sink += nrm2_sq(*row);
+	bench_report(name, "nrm2_sq", clock() - start);
+
+	if(axpy)
+	{
+		start = clock();
+		for(r=0; r<BENCH_ROUNDS; r++)
+			for(row=x; row->index; row++)
+				axpy(1e-9, *row, y);
+		bench_report(name, "axpy", clock() - start);
+	}
+
+	return sink;
+}
+
+
+int
+main()
+{
+	static const int nnzs[] = {14, 100};
+	double sink = 0;
+	bool ok = true;
+
+	srand(42);
+#ifdef SPARSE_AVX2
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2"))
+		ok = bench_check("avx2", sparse_operator::dot_avx2,
+		                 sparse_operator::nrm2_sq_avx2);
+#endif
+	if(!ok)
+		return 1;
+
+	for(size_t j=0; j<sizeof nnzs / sizeof *nnzs; j++)
+	{
+		feature_node *space;
+		feature_node **x = bench_generate(nnzs[j], BENCH_WIDTH, &space);
+		int *index;
+		double *value;
+		csr_row *rows = bench_csr(x, &index, &value);
+		double *s = bench_vector(BENCH_WIDTH);
+		double *y = bench_vector(BENCH_WIDTH);
+
+		printf("%d nodes, %d features per row, %d rounds\n", BENCH_NODES,
+		       nnzs[j], BENCH_ROUNDS);
+		sink += bench_run(x, s, y);
+		sink += bench_run_csr("scalar", sparse_operator::dot_scalar,
+		                      sparse_operator::nrm2_sq_scalar,
+		                      sparse_operator::axpy, rows, s, y);
+		sink += bench_run_csr("dispatch", sparse_operator::dot,
+		                      sparse_operator::nrm2_sq, NULL, rows, s, y);
+#ifdef SPARSE_AVX2
+		if(__builtin_cpu_supports("avx2"))
+			sink += bench_run_csr("avx2", sparse_operator::dot_avx2,
+			                      sparse_operator::nrm2_sq_avx2, NULL,
+			                      rows, s, y);
+#endif
+		free(y);
+		free(s);
+		free(rows);
+		free(value);
+		free(index);
+		free(space);
+		free(x);
+	}
+
+	return sink == 42.0;
+}
@@ -28,7 +28,7 @@ pyliblinear - a liblinear python API
 __author__ = u"Andr\xe9 Malo"
 __license__ = "Apache License, Version 2.0"
 __version__ = "247.2"
-__all__ = ["FeatureMatrix", "Model", "Solver", "SOLVER_TYPES"]
+__all__ = ["Cancel", "FeatureMatrix", "Model", "Solver", "SOLVER_TYPES"]
 
 try:
     from pyliblinear._liblinear import __version__ as _c_version
@@ -41,6 +41,7 @@ if _c_version != __version__:
     )
 del _c_version
 
+from pyliblinear._liblinear import Cancel
 from pyliblinear._liblinear import FeatureMatrix
 from pyliblinear._liblinear import Model
 from pyliblinear._liblinear import Solver
@@ -24,6 +24,7 @@
 struct pl_bufwriter_t {
     PyObject *buf;
     PyObject *write;
+    const char *format;
     char *c;
     char *s;
 };
@@ -80,7 +81,7 @@ pl_bufwriter_close(pl_bufwriter_t **self_)
 
     if (self && self->write && self->buf
         && self->c > (b = PyString_AS_STRING(self->buf))) {
-        rw = PyObject_CallFunction(self->write, "(s#)", b,
+        rw = PyObject_CallFunction(self->write, self->format, b,
                                    (Py_ssize_t)(self->c - b));
         self->c = b;
         if (!rw)
@@ -115,9 +116,9 @@ pl_bufwriter_write(pl_bufwriter_t *self, const char *string, Py_ssize_t len)
         len = (Py_ssize_t)strlen(string);
 
     /* Check if flush needed */
-    if (len < (Py_ssize_t)(self->s - self->c)) {
+    if (len > (Py_ssize_t)(self->s - self->c)) {
         b = PyString_AS_STRING(self->buf);
-        rw = PyObject_CallFunction(self->write, "(s#)", b,
+        rw = PyObject_CallFunction(self->write, self->format, b,
                                    (Py_ssize_t)(self->c - b));
         self->c = b;
         if (!rw)
@@ -126,8 +127,9 @@ pl_bufwriter_write(pl_bufwriter_t *self, const char *string, Py_ssize_t len)
     }
 
     /* Buffer too small... well then, just push it out */
-    if (len < (Py_ssize_t)(self->s - self->c)) {
-        if (!(rw = PyObject_CallFunction(self->write, "(s#)", string, len)))
+    if (len > (Py_ssize_t)(self->s - self->c)) {
+        if (!(rw = PyObject_CallFunction(self->write, self->format, string,
+                                         len)))
             return -1;
         Py_DECREF(rw);
     }
@@ -145,12 +147,13 @@ pl_bufwriter_write(pl_bufwriter_t *self, const char *string, Py_ssize_t len)
 /*
  * Create new bufwriter
  *
- * write is stolen and cleared on error
+ * write is stolen and cleared on error. If binary is true, bytes are passed
+ * to write, otherwise strings.
  *
  * Return NULL on error
  */
 pl_bufwriter_t *
-pl_bufwriter_new(PyObject *write)
+pl_bufwriter_new(PyObject *write, int binary)
 {
     pl_bufwriter_t *result;
 
@@ -162,6 +165,12 @@ pl_bufwriter_new(PyObject *write)
         goto error_result;
 
     result->write = write;
+#ifdef EXT2
+    (void)binary; /* str is bytes */
+    result->format = "(s#)";
+#else
+    result->format = binary ? "(y#)" : "(s#)";
+#endif
     result->c = PyString_AS_STRING(result->buf);
     result->s = result->c + PyString_GET_SIZE(result->buf);
 
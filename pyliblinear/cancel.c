@@ -0,0 +1,202 @@
+/*
+ * Copyright 2015 - 2025
+ * Andr\xe9 Malo or his licensors, as applicable
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pyliblinear.h"
+
+
+/*
+ * Object structure for Cancel
+ */
+typedef struct {
+    PyObject_HEAD
+    PyObject *weakreflist;
+
+    volatile int canceled;
+} pl_cancel_t;
+
+/* ------------------------ BEGIN Helper Functions ----------------------- */
+
+/*
+ * Find the flag of a cancel handle
+ *
+ * The flag is read by the solvers (see struct parameter), without the GIL.
+ * It stays valid as long as the handle is alive.
+ *
+ * Return NULL on error
+ */
+volatile int *
+pl_cancel_flag(PyObject *self)
+{
+    if (!PL_CancelType_CheckExact(self) && !PL_CancelType_Check(self)) {
+        PyErr_SetString(PyExc_TypeError,
+                        "cancel must be a " EXT_MODULE_PATH ".Cancel "
+                        "instance.");
+        return NULL;
+    }
+
+    return &((pl_cancel_t *)self)->canceled;
+}
+
+/* ------------------------- END Helper Functions ------------------------ */
+
+/* ----------------------- BEGIN Cancel DEFINITION ----------------------- */
+
+PyDoc_STRVAR(PL_CancelType_cancel__doc__,
+"cancel(self)\n\
+\n\
+Cancel the trainings using this handle\n\
+\n\
+May be called from any thread. The solvers notice it at their next\n\
+iteration and return the model as trained so far (not converged).\n\
+Trainings started with the handle later on stop right away, until it's\n\
+reset.");
+
+static PyObject *
+PL_CancelType_cancel(pl_cancel_t *self, PyObject *args)
+{
+    self->canceled = 1;
+
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(PL_CancelType_reset__doc__,
+"reset(self)\n\
+\n\
+Reset the handle, so it can be used for another training");
+
+static PyObject *
+PL_CancelType_reset(pl_cancel_t *self, PyObject *args)
+{
+    self->canceled = 0;
+
+    Py_RETURN_NONE;
+}
+
+static struct PyMethodDef PL_CancelType_methods[] = {
+    {"cancel",
+     EXT_CFUNC(PL_CancelType_cancel),       METH_NOARGS,
+     PL_CancelType_cancel__doc__},
+
+    {"reset",
+     EXT_CFUNC(PL_CancelType_reset),        METH_NOARGS,
+     PL_CancelType_reset__doc__},
+
+    {NULL, NULL}  /* Sentinel */
+};
+
+PyDoc_STRVAR(PL_CancelType_canceled_doc,
+"Was the handle canceled?\n\
+\n\
+:Type: ``bool``");
+
+static PyObject *
+PL_CancelType_canceled_get(pl_cancel_t *self, void *closure)
+{
+    return PyBool_FromLong(self->canceled);
+}
+
+static PyGetSetDef PL_CancelType_getset[] = {
+    {"canceled",
+     (getter)PL_CancelType_canceled_get,
+     NULL,
+     PL_CancelType_canceled_doc,
+     NULL},
+
+    {NULL}  /* Sentinel */
+};
+
+static int
+PL_CancelType_clear(pl_cancel_t *self)
+{
+    if (self->weakreflist)
+        PyObject_ClearWeakRefs((PyObject *)self);
+
+    return 0;
+}
+
+static PyObject *
+PL_CancelType_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {NULL};
+    pl_cancel_t *self;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "", kwlist))
+        return NULL;
+
+    if (!(self = GENERIC_ALLOC(type)))
+        return NULL;
+
+    self->canceled = 0;
+
+    return (PyObject *)self;
+}
+
+DEFINE_GENERIC_DEALLOC(PL_CancelType)
+
+PyDoc_STRVAR(PL_CancelType__doc__,
+"Cancel()\n\
+\n\
+Cancellation handle for training\n\
+\n\
+Passed to `Model.train` or `Model.train_path`. Calling `cancel` (e.g.\n\
+from another thread) stops the training early. A ``KeyboardInterrupt``\n\
+during the training cancels the handle as well.");
+
+PyTypeObject PL_CancelType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    EXT_MODULE_PATH ".Cancel",                          /* tp_name */
+    sizeof(pl_cancel_t),                                /* tp_basicsize */
+    0,                                                  /* tp_itemsize */
+    (destructor)PL_CancelType_dealloc,                  /* tp_dealloc */
+    0,                                                  /* tp_print */
+    0,                                                  /* tp_getattr */
+    0,                                                  /* tp_setattr */
+    0,                                                  /* tp_compare */
+    0,                                                  /* tp_repr */
+    0,                                                  /* tp_as_number */
+    0,                                                  /* tp_as_sequence */
+    0,                                                  /* tp_as_mapping */
+    0,                                                  /* tp_hash */
+    0,                                                  /* tp_call */
+    0,                                                  /* tp_str */
+    0,                                                  /* tp_getattro */
+    0,                                                  /* tp_setattro */
+    0,                                                  /* tp_as_buffer */
+    Py_TPFLAGS_HAVE_CLASS                               /* tp_flags */
+    | Py_TPFLAGS_HAVE_WEAKREFS
+    | Py_TPFLAGS_BASETYPE,
+    PL_CancelType__doc__,                               /* tp_doc */
+    0,                                                  /* tp_traverse */
+    0,                                                  /* tp_clear */
+    0,                                                  /* tp_richcompare */
+    offsetof(pl_cancel_t, weakreflist),                 /* tp_weaklistoffset */
+    0,                                                  /* tp_iter */
+    0,                                                  /* tp_iternext */
+    PL_CancelType_methods,                              /* tp_methods */
+    0,                                                  /* tp_members */
+    PL_CancelType_getset,                               /* tp_getset */
+    0,                                                  /* tp_base */
+    0,                                                  /* tp_dict */
+    0,                                                  /* tp_descr_get */
+    0,                                                  /* tp_descr_set */
+    0,                                                  /* tp_dictoffset */
+    0,                                                  /* tp_init */
+    0,                                                  /* tp_alloc */
+    PL_CancelType_new                                   /* tp_new */
+};
+
+/* ------------------------ END Cancel DEFINITION ------------------------ */
@@ -37,3 +37,150 @@ pl_file_open(PyObject *filename, const char *mode)
     return result;
 }
 #endif
+
+
+/*
+ * Map a file into memory
+ *
+ * The mapping is read-only and advised for sequential access. If private_ is
+ * true, it's writable copy-on-write instead (changes are never written
+ * back).
+ *
+ * map is set to NULL if the file cannot be mapped (empty files or anything
+ * but regular files). The caller is expected to read it as a stream then.
+ *
+ * Return -1 on error
+ */
+int
+pl_file_map(PyObject *filename, int private_, PyObject **map_)
+{
+    PyObject *m_mmap, *m_os, *m_stat, *stream, *fileno, *st, *tmp, *tmp2;
+    PyObject *args, *kwds, *map = NULL;
+    int res;
+
+    if (!(m_mmap = PyImport_ImportModule("mmap")))
+        return -1;
+    if (!(m_os = PyImport_ImportModule("os")))
+        goto error_mmap;
+    if (!(m_stat = PyImport_ImportModule("stat")))
+        goto error_os;
+
+    if (!(stream = pl_file_open(filename, "rb")))
+        goto error_stat;
+    if (!(fileno = PyObject_CallMethod(stream, "fileno", "()")))
+        goto error_stream;
+    if (!(st = PyObject_CallMethod(m_os, "fstat", "(O)", fileno)))
+        goto error_fileno;
+
+    /* Regular file? */
+    if (!(tmp = PyObject_GetAttrString(st, "st_mode")))
+        goto error_st;
+    tmp2 = PyObject_CallMethod(m_stat, "S_ISREG", "(O)", tmp);
+    Py_DECREF(tmp);
+    if (!tmp2)
+        goto error_st;
+    res = PyObject_IsTrue(tmp2);
+    Py_DECREF(tmp2);
+    if (res == -1)
+        goto error_st;
+
+    /* Non-empty? */
+    if (res) {
+        if (!(tmp = PyObject_GetAttrString(st, "st_size")))
+            goto error_st;
+        res = PyObject_IsTrue(tmp);
+        Py_DECREF(tmp);
+        if (res == -1)
+            goto error_st;
+    }
+
+    if (res) {
+        if (!(kwds = PyDict_New()))
+            goto error_st;
+        tmp = PyObject_GetAttrString(m_mmap, private_ ? "ACCESS_COPY"
+                                                      : "ACCESS_READ");
+        if (!tmp) {
+            Py_DECREF(kwds);
+            goto error_st;
+        }
+        res = PyDict_SetItemString(kwds, "access", tmp);
+        Py_DECREF(tmp);
+        if (res == -1 || !(args = Py_BuildValue("(Oi)", fileno, 0))) {
+            Py_DECREF(kwds);
+            goto error_st;
+        }
+        if (!(tmp = PyObject_GetAttrString(m_mmap, "mmap"))) {
+            Py_DECREF(args);
+            Py_DECREF(kwds);
+            goto error_st;
+        }
+        map = PyObject_Call(tmp, args, kwds);
+        Py_DECREF(tmp);
+        Py_DECREF(args);
+        Py_DECREF(kwds);
+        if (!map)
+            goto error_st;
+
+        /* The file is scanned once from start to end. Tell the OS. */
+        if (private_)
+            tmp = NULL;
+        else if (pl_attr(m_mmap, "MADV_SEQUENTIAL", &tmp) == -1)
+            goto error_map;
+        if (tmp) {
+            if (pl_attr(map, "madvise", &tmp2) == -1) {
+                Py_DECREF(tmp);
+                goto error_map;
+            }
+            if (tmp2) {
+                args = PyObject_CallFunction(tmp2, "(O)", tmp);
+                Py_DECREF(tmp2);
+                if (!args) {
+                    Py_DECREF(tmp);
+                    goto error_map;
+                }
+                Py_DECREF(args);
+            }
+            Py_DECREF(tmp);
+        }
+    }
+
+    Py_DECREF(st);
+    Py_DECREF(fileno);
+    tmp = PyObject_CallMethod(stream, "close", "()");
+    Py_DECREF(stream);
+    if (!tmp) {
+        Py_XDECREF(map);
+        goto error_stat;
+    }
+    Py_DECREF(tmp);
+    Py_DECREF(m_stat);
+    Py_DECREF(m_os);
+    Py_DECREF(m_mmap);
+
+    *map_ = map;
+    return 0;
+
+error_map:
+    Py_DECREF(map);
+error_st:
+    Py_DECREF(st);
+error_fileno:
+    Py_DECREF(fileno);
+error_stream:
+    {
+        PyObject *ptype, *pvalue, *ptraceback;
+
+        PyErr_Fetch(&ptype, &pvalue, &ptraceback);
+        if ((tmp = PyObject_CallMethod(stream, "close", "()")))
+            Py_DECREF(tmp);
+        PyErr_Restore(ptype, pvalue, ptraceback);
+    }
+    Py_DECREF(stream);
+error_stat:
+    Py_DECREF(m_stat);
+error_os:
+    Py_DECREF(m_os);
+error_mmap:
+    Py_DECREF(m_mmap);
+    return -1;
+}
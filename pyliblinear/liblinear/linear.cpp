@@ -4,6 +4,9 @@
 #include <string.h>
 #include <stdarg.h>
 #include <locale.h>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
 #include "linear.h"
 #include "newton.h"
 int liblinear_version = LIBLINEAR_VERSION;
@@ -28,7 +31,6 @@ static void print_string_stdout(const char *s)
 	fputs(s,stdout);
 	fflush(stdout);
 }
-static void print_null(const char *s) {}
 
 static void (*liblinear_print_string) (const char *) = &print_string_stdout;
 
@@ -45,6 +47,369 @@ static void info(const char *fmt,...)
 #else
 static void info(const char *fmt,...) {}
 #endif
+
+static void (*liblinear_parallel_run) (int, void (*)(void *, int, int), void *) = NULL;
+
+// Run body(arg, t, nr_thread) for t = 0, ..., nr_thread-1, in parallel if
+// a parallel run function is set
+static void parallel_run(int nr_thread, void (*body)(void *, int, int), void *arg)
+{
+	if(nr_thread > 1 && liblinear_parallel_run != NULL)
+		liblinear_parallel_run(nr_thread, body, arg);
+	else
+		for(int t=0;t<nr_thread;t++)
+			body(arg, t, nr_thread);
+}
+
+// A team of threads for running many short parallel kernels in a row
+//
+// thread_team::run() starts the threads once (with parallel_run) and runs
+// main on the calling thread. The other threads wait for the kernels main
+// hands over with dispatch(), instead of being started for every kernel.
+// The slices of a kernel are claimed by whichever thread is free, so the
+// team works with any number of threads actually running. If none could be
+// started, the caller runs all slices itself.
+class thread_team
+{
+public:
+	static void run(int nr_thread, void (*main)(void *, thread_team *), void *arg)
+	{
+		thread_team team(main, arg);
+		parallel_run(nr_thread, entry, &team);
+	}
+
+	// Run body(arg, t, nr_slice) for t = 0, ..., nr_slice-1 and wait for it
+	void dispatch(int nr_slice, void (*body)(void *, int, int), void *arg)
+	{
+		std::unique_lock<std::mutex> hold(lock);
+		this->body = body;
+		this->arg = arg;
+		this->nr_slice = nr_slice;
+		next = 0;
+		finished = 0;
+		generation++;
+		wake.notify_all();
+		work(hold);
+		while(finished < nr_slice)
+			done.wait(hold);
+	}
+
+private:
+	thread_team(void (*main)(void *, thread_team *), void *main_arg) :
+		main(main), main_arg(main_arg), body(NULL), arg(NULL),
+		nr_slice(0), next(0), finished(0), generation(0), stop(false) {}
+
+	// Run unclaimed slices of the current kernel (lock is held)
+	void work(std::unique_lock<std::mutex> &hold)
+	{
+		while(next < nr_slice)
+		{
+			int t = next++;
+			hold.unlock();
+			body(arg, t, nr_slice);
+			hold.lock();
+			if(++finished == nr_slice)
+				done.notify_one();
+		}
+	}
+
+	static void entry(void *arg, int t, int nr_thread)
+	{
+		thread_team *team = (thread_team *)arg;
+		std::unique_lock<std::mutex> hold(team->lock);
+
+		if(t == 0)
+		{
+			hold.unlock();
+			team->main(team->main_arg, team);
+			hold.lock();
+			team->stop = true;
+			team->wake.notify_all();
+			return;
+		}
+
+		unsigned int seen = team->generation;
+		team->work(hold);
+		while(!team->stop)
+		{
+			if(team->generation == seen)
+			{
+				team->wake.wait(hold);
+				continue;
+			}
+			seen = team->generation;
+			team->work(hold);
+		}
+	}
+
+	void (*main)(void *, thread_team *);
+	void *main_arg;
+
+	std::mutex lock;
+	std::condition_variable wake;  // helpers: a new kernel or stop
+	std::condition_variable done;  // dispatch: all slices finished
+
+	// The current kernel
+	void (*body)(void *, int, int);
+	void *arg;
+	int nr_slice;
+	int next;                      // next unclaimed slice
+	int finished;
+	unsigned int generation;       // counts the kernels
+	bool stop;
+};
+
+// Random numbers of a solver run (xoshiro256**), instead of the shared
+// rand(). Each run seeds its own generator from parameter::seed, so runs
+// are reproducible and can be trained in parallel.
+class prng
+{
+public:
+	prng(uint64_t seed)
+	{
+		// splitmix64 expands the seed into the state
+		for(int k=0; k<4; k++)
+		{
+			uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+			state[k] = z ^ (z >> 31);
+		}
+	}
+
+	uint64_t next()
+	{
+		uint64_t result = rotl(state[1] * 5, 7) * 9;
+		uint64_t t = state[1] << 17;
+
+		state[2] ^= state[0];
+		state[3] ^= state[1];
+		state[1] ^= state[2];
+		state[0] ^= state[3];
+		state[2] ^= t;
+		state[3] = rotl(state[3], 45);
+		return result;
+	}
+
+	// Uniform in [0, n) for 0 < n <= INT_MAX (multiply-shift, the bias is
+	// below n / 2^32)
+	int below(int n)
+	{
+		return (int)(((next() >> 32) * (uint64_t)n) >> 32);
+	}
+
+	// Seed of the i-th subproblem (e.g. a one-vs-rest class) of a run
+	static uint64_t subseed(uint64_t seed, int i)
+	{
+		prng rng(seed ^ ((uint64_t)(i + 1) << 32));
+		return rng.next();
+	}
+
+private:
+	static uint64_t rotl(uint64_t x, int k)
+	{
+		return (x << k) | (x >> (64 - k));
+	}
+
+	uint64_t state[4];
+};
+
+// Random permutation of 0, ..., n-1 (Fisher-Yates). It assigns the rows to
+// the cross validation folds, so the same seed gives the same folds.
+static void random_permutation(int *perm, int n, uint64_t seed)
+{
+	prng rng(seed);
+	int i;
+	for(i=0;i<n;i++) perm[i]=i;
+	for(i=0;i<n;i++)
+	{
+		int j = i+rng.below(n-i);
+		swap(perm[i],perm[j]);
+	}
+}
+
+// Wall clock seconds
+static double wall_clock()
+{
+	return std::chrono::duration<double>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Solver runs recorded for parameter::stats (see train_budget)
+struct run_log
+{
+	int nr_run;
+	train_run_stats *run;
+};
+
+// Stopping rules of a training besides the tolerance (see
+// parameter::max_iter, time_limit and cancel) and its telemetry (see
+// parameter::stats)
+//
+// Shared by all solver runs of a model, also if they run in parallel. The
+// solvers check exhausted() before each outer iteration and call stop() if
+// they end at their iteration limit. Both mark the model as not converged.
+//
+// The solvers record their runs with begin(), iteration() and end(), which
+// do nothing unless the budget has a log. The one-vs-rest classes are
+// trained in parallel, so each of them records through a budget of its
+// own, which shares the stopping rules of the model's (see train_ovr).
+class train_budget
+{
+public:
+	train_budget(const parameter *param, run_log *log) : converged(1), param(param), shared(NULL), log(log), cls(-1), deadline(0), start(0)
+	{
+		if(param->time_limit > 0)
+			deadline = wall_clock() + param->time_limit;
+	}
+
+	// Budget of the one-vs-rest class cls
+	train_budget(train_budget *shared, int cls, run_log *log) : converged(1), param(shared->param), shared(shared), log(log), cls(cls), deadline(0), start(0)
+	{
+	}
+
+	// Iteration limit of a solver run, parameter::max_iter or the solver's
+	int max_iter(int solver_max_iter) const
+	{
+		return param->max_iter > 0 ? param->max_iter : solver_max_iter;
+	}
+
+	// Whether the run has to stop (canceled or out of time)
+	bool exhausted()
+	{
+		if(shared != NULL)
+			return shared->exhausted();
+		if((param->cancel != NULL && *param->cancel)
+				|| (deadline > 0 && wall_clock() >= deadline))
+		{
+			converged = 0;
+			return true;
+		}
+		return false;
+	}
+
+	// exhausted() for NEWTON::set_stop
+	static bool exhausted(void *budget)
+	{
+		return ((train_budget *)budget)->exhausted();
+	}
+
+	void stop()
+	{
+		if(shared != NULL)
+			shared->stop();
+		else
+			converged = 0;
+	}
+
+	// Statistics of the current run (NULL if not recorded)
+	train_run_stats *run() const
+	{
+		return log != NULL && log->nr_run > 0 ? &log->run[log->nr_run-1] : NULL;
+	}
+
+	// Start recording a solver run
+	void begin(int solver_type)
+	{
+		if(log == NULL)
+			return;
+
+		log->run = (train_run_stats *)realloc(log->run, (log->nr_run+1)*sizeof(train_run_stats));
+		train_run_stats *r = &log->run[log->nr_run++];
+		r->solver_type = solver_type;
+		r->cls = cls;
+		r->time = 0;
+		r->objective = NAN;
+		r->Xv_time = r->XTv_time = r->Hv_time = 0;
+		r->nr_Xv = r->nr_XTv = r->nr_Hv = 0;
+		r->nr_iter = 0;
+		r->iter = NULL;
+		start = wall_clock();
+	}
+
+	// Record an outer iteration of the current run (-1 or NaN for the
+	// values the solver doesn't know, see train_iter_stats)
+	void iteration(int iter, double violation, int active_size, int inner_iter=-1, double f=NAN, double step_size=NAN, int line_search=-1)
+	{
+		if(log == NULL)
+			return;
+
+		train_run_stats *r = run();
+		// The array grows to powers of two
+		if((r->nr_iter & (r->nr_iter-1)) == 0)
+			r->iter = (train_iter_stats *)realloc(r->iter, max(2*r->nr_iter, 1)*sizeof(train_iter_stats));
+		train_iter_stats *it = &r->iter[r->nr_iter++];
+		it->iter = iter;
+		it->time = wall_clock() - start;
+		it->f = f;
+		it->violation = violation;
+		it->step_size = step_size;
+		it->inner_iter = inner_iter;
+		it->line_search = line_search;
+		it->active_size = active_size;
+	}
+
+	// NEWTON::set_report callback
+	static void newton_iteration(void *budget_, const newton_report *r)
+	{
+		train_budget *budget = (train_budget *)budget_;
+
+		if(r->iter == 0)
+			budget->iteration(0, r->gnorm, -1, -1, r->f);
+		else
+			budget->iteration(r->iter, r->gnorm, -1, r->cg_iter, r->f, r->step_size, r->nr_linesearch);
+	}
+
+	// Finish the current run with its objective value (NaN: the f of the
+	// last iteration)
+	void end(double objective)
+	{
+		if(log == NULL)
+			return;
+
+		train_run_stats *r = run();
+		r->time = wall_clock() - start;
+		if(isnan(objective) && r->nr_iter > 0)
+			objective = r->iter[r->nr_iter-1].f;
+		r->objective = objective;
+	}
+
+	volatile int converged;
+
+private:
+	const parameter *param;
+	train_budget *shared;
+	run_log *log;
+	int cls;
+	double deadline;
+	double start;
+};
+
+// AVX2 versions of the sparse_operator kernels are selected at runtime
+// (gcc/clang target attribute). Other builds use the scalar kernels only.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SPARSE_AVX2
+#include <immintrin.h>
+#endif
+
+// Number of nodes processed one by one before switching to the vector
+// kernels. Most rows are short, and for them the plain loop is faster than
+// setting up the gathers (and the result stays exactly the same).
+#define SPARSE_PREFIX 16
+
+// A row of the structure-of-arrays layout (see problem::csr_index)
+struct csr_row
+{
+	const int *index;
+	const double *value;
+};
+
+static inline csr_row get_csr_row(const problem *prob, int i)
+{
+	csr_row row = {prob->csr_index + prob->csr_start[i], prob->csr_value + prob->csr_start[i]};
+	return row;
+}
+
 class sparse_operator
 {
 public:
@@ -100,6 +465,221 @@ public:
 			x++;
 		}
 	}
+
+	static double nrm2_sq(csr_row x)
+	{
+		double ret = 0;
+		for(int k=0; k<SPARSE_PREFIX; k++, x.index++, x.value++)
+		{
+			if(*x.index == -1)
+				return ret;
+			ret += *x.value**x.value;
+		}
+#ifdef SPARSE_AVX2
+		if(use_avx2)
+			return ret + nrm2_sq_avx2(x);
+#endif
+		return ret + nrm2_sq_scalar(x);
+	}
+
+	static double dot(const double *s, csr_row x)
+	{
+		double ret = 0;
+		for(int k=0; k<SPARSE_PREFIX; k++, x.index++, x.value++)
+		{
+			if(*x.index == -1)
+				return ret;
+			ret += s[*x.index-1]**x.value;
+		}
+#ifdef SPARSE_AVX2
+		if(use_avx2)
+			return ret + dot_avx2(s, x);
+#endif
+		return ret + dot_scalar(s, x);
+	}
+
+	static void axpy(const double a, csr_row x, double *y)
+	{
+		for(; *x.index != -1; x.index++, x.value++)
+			y[*x.index-1] += a**x.value;
+	}
+
+	static double nrm2_sq_scalar(csr_row x)
+	{
+		double ret = 0;
+		for(; *x.index != -1; x.index++, x.value++)
+			ret += *x.value**x.value;
+		return ret;
+	}
+
+	static double dot_scalar(const double *s, csr_row x)
+	{
+		double ret = 0;
+		for(; *x.index != -1; x.index++, x.value++)
+			ret += s[*x.index-1]**x.value;
+		return ret;
+	}
+
+#ifdef SPARSE_AVX2
+	static double nrm2_sq_avx2(csr_row x);
+	static double dot_avx2(const double *s, csr_row x);
+
+	static bool use_avx2;
+#endif
+};
+
+#ifdef SPARSE_AVX2
+// The AVX2 kernels process four entries at a time. The four indices are
+// loaded at once and checked for the sentinel, which may read up to 3
+// indices behind it (see problem::csr_index). The sums are reordered
+// compared to the scalar kernels.
+//
+// There's no AVX2 kernel for axpy: without a scatter only the products
+// could be vectorized, which doesn't pay off.
+#define CSR_LOAD4(x) _mm_loadu_si128((const __m128i *)(const void *)(x).index)
+#define CSR_BLOCK4(idx) (!_mm_movemask_epi8(_mm_cmpeq_epi32(idx, _mm_set1_epi32(-1))))
+
+__attribute__((target("avx2")))
+static inline double sparse_hsum(__m256d v)
+{
+	__m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+	return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+}
+
+__attribute__((target("avx2")))
+double sparse_operator::nrm2_sq_avx2(csr_row x)
+{
+	__m256d acc = _mm256_setzero_pd();
+	for(; CSR_BLOCK4(CSR_LOAD4(x)); x.index += 4, x.value += 4)
+	{
+		__m256d val = _mm256_loadu_pd(x.value);
+		acc = _mm256_add_pd(acc, _mm256_mul_pd(val, val));
+	}
+	return sparse_hsum(acc) + nrm2_sq_scalar(x);
+}
+
+__attribute__((target("avx2")))
+double sparse_operator::dot_avx2(const double *s, csr_row x)
+{
+	// The masked gather avoids a bogus gcc warning about its source operand
+	const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+	__m256d acc = _mm256_setzero_pd();
+	__m128i idx;
+	for(; CSR_BLOCK4(idx = CSR_LOAD4(x)); x.index += 4, x.value += 4)
+	{
+		__m256d sv = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), s - 1, idx, all, 8);
+		acc = _mm256_add_pd(acc, _mm256_mul_pd(sv, _mm256_loadu_pd(x.value)));
+	}
+	return sparse_hsum(acc) + dot_scalar(s, x);
+}
+#undef CSR_BLOCK4
+#undef CSR_LOAD4
+
+// LIBLINEAR_NO_AVX2 (set to anything) selects the scalar kernels, e.g. for
+// comparing the results
+static bool sparse_cpu_avx2()
+{
+	if(getenv("LIBLINEAR_NO_AVX2") != NULL)
+		return false;
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+}
+
+bool sparse_operator::use_avx2 = sparse_cpu_avx2();
+#endif
+
+// Minimum number of rows per thread in the parallel kernels
+#define MIN_ROWS_PER_THREAD 4096
+
+// Row parallel kernels for Xv, X^Tv and the Hessian-vector products
+//
+// Thread t works on rows [l*t/nr_thread, l*(t+1)/nr_thread). The X^Tv like
+// kernels let thread 0 accumulate into out and the other threads into their
+// own part of acc. reduce then adds acc to out, split by features.
+struct sparse_kernel
+{
+	const problem *prob;
+	const int *I;       // rows to use (NULL: rows 0, ..., l-1)
+	int l;
+	int w_size;
+	const double *v;
+	const double *C;    // Hv: row factor C[i] (times D[i] if D is set)
+	const double *D;
+	double *out;
+	double *acc;        // (nr_thread-1) * w_size per thread accumulators
+
+	static void range(int n, int t, int nr_thread, int *begin, int *end)
+	{
+		*begin = (int)((long long)n * t / nr_thread);
+		*end = (int)((long long)n * (t + 1) / nr_thread);
+	}
+
+	double *buffer(int t)
+	{
+		double *buf = t ? acc + (size_t)(t-1) * w_size : out;
+
+		for(int j=0;j<w_size;j++)
+			buf[j] = 0;
+		return buf;
+	}
+
+	static void Xv(void *arg, int t, int nr_thread)
+	{
+		sparse_kernel *k = (sparse_kernel *)arg;
+		int i, begin, end;
+
+		range(k->l, t, nr_thread, &begin, &end);
+		for(i=begin;i<end;i++)
+			k->out[i] = sparse_operator::dot(k->v, get_csr_row(k->prob, i));
+	}
+
+	static void XTv(void *arg, int t, int nr_thread)
+	{
+		sparse_kernel *k = (sparse_kernel *)arg;
+		double *buf = k->buffer(t);
+		int i, begin, end;
+
+		range(k->l, t, nr_thread, &begin, &end);
+		for(i=begin;i<end;i++)
+			sparse_operator::axpy(k->v[i], get_csr_row(k->prob, k->I ? k->I[i] : i), buf);
+	}
+
+	static void Hv(void *arg, int t, int nr_thread)
+	{
+		sparse_kernel *k = (sparse_kernel *)arg;
+		double *buf = k->buffer(t);
+		int i, begin, end;
+
+		range(k->l, t, nr_thread, &begin, &end);
+		for(i=begin;i<end;i++)
+		{
+			int idx = k->I ? k->I[i] : i;
+			const csr_row xi = get_csr_row(k->prob, idx);
+			double xTs = sparse_operator::dot(k->v, xi);
+
+			if(k->D)
+				xTs = k->C[idx]*k->D[idx]*xTs;
+			else
+				xTs = k->C[idx]*xTs;
+
+			sparse_operator::axpy(xTs, xi, buf);
+		}
+	}
+
+	static void reduce(void *arg, int t, int nr_thread)
+	{
+		sparse_kernel *k = (sparse_kernel *)arg;
+		int j, s, begin, end;
+
+		range(k->w_size, t, nr_thread, &begin, &end);
+		for(j=begin;j<end;j++)
+		{
+			double sum = k->out[j];
+			for(s=0;s<nr_thread-1;s++)
+				sum += k->acc[(size_t)s * k->w_size + j];
+			k->out[j] = sum;
+		}
+	}
 };
 
 // L2-regularized empirical risk minimization
@@ -114,11 +694,18 @@ public:
 	double fun(double *w);
 	double linesearch_and_update(double *w, double *d, double *f, double *g, double alpha);
 	int get_nr_variable(void);
+	void set_stats(train_run_stats *stats);
+	int get_nr_thread(void);
+	void set_team(thread_team *team);
 
 protected:
 	virtual double C_times_loss(int i, double wx_i) = 0;
 	void Xv(double *v, double *Xv);
 	void XTv(double *v, double *XTv);
+	void subXTv(const int *I, int sizeI, double *v, double *XTv);
+	void subHv(const int *I, int sizeI, const double *D, double *s, double *Hs);
+	int threads_for(int rows);
+	void run_kernel(int nr_slice, void (*body)(void *, int, int), void *arg);
 
 	double *C;
 	const problem *prob;
@@ -126,6 +713,10 @@ protected:
 	double *tmp; // a working array
 	double wTw;
 	int regularize_bias;
+	int nr_thread;
+	double *acc; // per thread accumulators for the X^Tv like kernels
+	thread_team *team; // runs the kernels (or NULL)
+	train_run_stats *stats; // times of the kernels (or NULL)
 };
 
 l2r_erm_fun::l2r_erm_fun(const problem *prob, const parameter *param, double *C)
@@ -138,12 +729,31 @@ l2r_erm_fun::l2r_erm_fun(const problem *prob, const parameter *param, double *C)
 	tmp = new double[l];
 	this->C = C;
 	this->regularize_bias = param->regularize_bias;
+
+	nr_thread = param->nr_thread;
+	if(nr_thread < 1 || liblinear_parallel_run == NULL)
+		nr_thread = 1;
+	nr_thread = threads_for(l);
+	acc = nr_thread > 1 ? new double[(size_t)(nr_thread-1) * prob->n] : NULL;
+	team = NULL;
+	stats = NULL;
 }
 
 l2r_erm_fun::~l2r_erm_fun()
 {
 	delete[] wx;
 	delete[] tmp;
+	delete[] acc;
+}
+
+// Number of threads worth using for a kernel over rows
+int l2r_erm_fun::threads_for(int rows)
+{
+	int n = rows / MIN_ROWS_PER_THREAD;
+
+	if(n > nr_thread)
+		n = nr_thread;
+	return n < 1 ? 1 : n;
 }
 
 double l2r_erm_fun::fun(double *w)
@@ -172,6 +782,32 @@ int l2r_erm_fun::get_nr_variable(void)
 	return prob->n;
 }
 
+// Record the time spent in the kernels into stats
+void l2r_erm_fun::set_stats(train_run_stats *stats)
+{
+	this->stats = stats;
+}
+
+// Number of threads the kernels may use
+int l2r_erm_fun::get_nr_thread(void)
+{
+	return nr_thread;
+}
+
+// Run the kernels with team (NULL: start threads per kernel)
+void l2r_erm_fun::set_team(thread_team *team)
+{
+	this->team = team;
+}
+
+void l2r_erm_fun::run_kernel(int nr_slice, void (*body)(void *, int, int), void *arg)
+{
+	if(team != NULL && nr_slice > 1)
+		team->dispatch(nr_slice, body, arg);
+	else
+		parallel_run(nr_slice, body, arg);
+}
+
 // On entry *f must be the function value of w
 // On exit w is updated and *f is the new function value
 double l2r_erm_fun::linesearch_and_update(double *w, double *s, double *f, double *g, double alpha)
@@ -220,6 +856,7 @@ double l2r_erm_fun::linesearch_and_update(double *w, double *s, double *f, doubl
 			alpha *= 0.5;
 	}
 
+	nr_linesearch = min(num_linesearch+1, max_num_linesearch);
 	if (num_linesearch >= max_num_linesearch)
 	{
 		*f = fold;
@@ -235,25 +872,54 @@ double l2r_erm_fun::linesearch_and_update(double *w, double *s, double *f, doubl
 
 void l2r_erm_fun::Xv(double *v, double *Xv)
 {
-	int i;
-	int l=prob->l;
-	feature_node **x=prob->x;
+	sparse_kernel k = {prob, NULL, prob->l, get_nr_variable(), v, NULL, NULL, Xv, acc};
+	double start = stats != NULL ? wall_clock() : 0;
 
-	for(i=0;i<l;i++)
-		Xv[i]=sparse_operator::dot(v, x[i]);
+	run_kernel(threads_for(prob->l), sparse_kernel::Xv, &k);
+	if(stats != NULL)
+	{
+		stats->Xv_time += wall_clock() - start;
+		stats->nr_Xv++;
+	}
 }
 
 void l2r_erm_fun::XTv(double *v, double *XTv)
 {
-	int i;
-	int l=prob->l;
-	int w_size=get_nr_variable();
-	feature_node **x=prob->x;
+	subXTv(NULL, prob->l, v, XTv);
+}
 
-	for(i=0;i<w_size;i++)
-		XTv[i]=0;
-	for(i=0;i<l;i++)
-		sparse_operator::axpy(v[i], x[i], XTv);
+// X_I^T v, where v is indexed by the position in I (all rows if I is NULL)
+void l2r_erm_fun::subXTv(const int *I, int sizeI, double *v, double *XTv)
+{
+	sparse_kernel k = {prob, I, sizeI, get_nr_variable(), v, NULL, NULL, XTv, acc};
+	int n = threads_for(sizeI);
+	double start = stats != NULL ? wall_clock() : 0;
+
+	run_kernel(n, sparse_kernel::XTv, &k);
+	if(n > 1)
+		run_kernel(n, sparse_kernel::reduce, &k);
+	if(stats != NULL)
+	{
+		stats->XTv_time += wall_clock() - start;
+		stats->nr_XTv++;
+	}
+}
+
+// X_I^T diag(C_I D_I) X_I s (D may be NULL, all rows if I is NULL)
+void l2r_erm_fun::subHv(const int *I, int sizeI, const double *D, double *s, double *Hs)
+{
+	sparse_kernel k = {prob, I, sizeI, get_nr_variable(), s, C, D, Hs, acc};
+	int n = threads_for(sizeI);
+	double start = stats != NULL ? wall_clock() : 0;
+
+	run_kernel(n, sparse_kernel::Hv, &k);
+	if(n > 1)
+		run_kernel(n, sparse_kernel::reduce, &k);
+	if(stats != NULL)
+	{
+		stats->Hv_time += wall_clock() - start;
+		stats->nr_Hv++;
+	}
 }
 
 class l2r_lr_fun: public l2r_erm_fun
@@ -319,7 +985,6 @@ void l2r_lr_fun::get_diag_preconditioner(double *M)
 	int i;
 	int l = prob->l;
 	int w_size=get_nr_variable();
-	feature_node **x = prob->x;
 
 	for (i=0; i<w_size; i++)
 		M[i] = 1;
@@ -328,11 +993,12 @@ void l2r_lr_fun::get_diag_preconditioner(double *M)
 
 	for (i=0; i<l; i++)
 	{
-		feature_node *xi = x[i];
-		while (xi->index!=-1)
+		csr_row xi = get_csr_row(prob, i);
+		while (*xi.index!=-1)
 		{
-			M[xi->index-1] += xi->value*xi->value*C[i]*D[i];
-			xi++;
+			M[*xi.index-1] += *xi.value**xi.value*C[i]*D[i];
+			xi.index++;
+			xi.value++;
 		}
 	}
 }
@@ -340,21 +1006,9 @@ void l2r_lr_fun::get_diag_preconditioner(double *M)
 void l2r_lr_fun::Hv(double *s, double *Hs)
 {
 	int i;
-	int l=prob->l;
 	int w_size=get_nr_variable();
-	feature_node **x=prob->x;
-
-	for(i=0;i<w_size;i++)
-		Hs[i] = 0;
-	for(i=0;i<l;i++)
-	{
-		feature_node * const xi=x[i];
-		double xTs = sparse_operator::dot(s, xi);
-
-		xTs = C[i]*D[i]*xTs;
 
-		sparse_operator::axpy(xTs, xi, Hs);
-	}
+	subHv(NULL, prob->l, D, s, Hs);
 	for(i=0;i<w_size;i++)
 		Hs[i] = s[i] + Hs[i];
 	if(regularize_bias == 0)
@@ -373,8 +1027,6 @@ public:
 	void get_diag_preconditioner(double *M);
 
 protected:
-	void subXTv(double *v, double *XTv);
-
 	int *I;
 	int sizeI;
 
@@ -420,7 +1072,7 @@ void l2r_l2_svc_fun::grad(double *w, double *g)
 			sizeI++;
 		}
 	}
-	subXTv(tmp, g);
+	subXTv(I, sizeI, tmp, g);
 
 	for(i=0;i<w_size;i++)
 		g[i] = w[i] + 2*g[i];
@@ -432,7 +1084,6 @@ void l2r_l2_svc_fun::get_diag_preconditioner(double *M)
 {
 	int i;
 	int w_size=get_nr_variable();
-	feature_node **x = prob->x;
 
 	for (i=0; i<w_size; i++)
 		M[i] = 1;
@@ -442,48 +1093,26 @@ void l2r_l2_svc_fun::get_diag_preconditioner(double *M)
 	for (i=0; i<sizeI; i++)
 	{
 		int idx = I[i];
-		feature_node *xi = x[idx];
-		while (xi->index!=-1)
+		csr_row xi = get_csr_row(prob, idx);
+		while (*xi.index!=-1)
 		{
-			M[xi->index-1] += xi->value*xi->value*C[idx]*2;
-			xi++;
+			M[*xi.index-1] += *xi.value**xi.value*C[idx]*2;
+			xi.index++;
+			xi.value++;
 		}
 	}
 }
 
-void l2r_l2_svc_fun::Hv(double *s, double *Hs)
-{
-	int i;
-	int w_size=get_nr_variable();
-	feature_node **x=prob->x;
-
-	for(i=0;i<w_size;i++)
-		Hs[i]=0;
-	for(i=0;i<sizeI;i++)
-	{
-		feature_node * const xi=x[I[i]];
-		double xTs = sparse_operator::dot(s, xi);
-
-		xTs = C[I[i]]*xTs;
-
-		sparse_operator::axpy(xTs, xi, Hs);
-	}
-	for(i=0;i<w_size;i++)
-		Hs[i] = s[i] + 2*Hs[i];
-	if(regularize_bias == 0)
-		Hs[w_size-1] -= s[w_size-1];
-}
-
-void l2r_l2_svc_fun::subXTv(double *v, double *XTv)
+void l2r_l2_svc_fun::Hv(double *s, double *Hs)
 {
 	int i;
 	int w_size=get_nr_variable();
-	feature_node **x=prob->x;
 
+	subHv(I, sizeI, NULL, s, Hs);
 	for(i=0;i<w_size;i++)
-		XTv[i]=0;
-	for(i=0;i<sizeI;i++)
-		sparse_operator::axpy(v[i], x[I[i]], XTv);
+		Hs[i] = s[i] + 2*Hs[i];
+	if(regularize_bias == 0)
+		Hs[w_size-1] -= s[w_size-1];
 }
 
 class l2r_l2_svr_fun: public l2r_l2_svc_fun
@@ -543,7 +1172,7 @@ void l2r_l2_svr_fun::grad(double *w, double *g)
 		}
 
 	}
-	subXTv(tmp, g);
+	subXTv(I, sizeI, tmp, g);
 
 	for(i=0;i<w_size;i++)
 		g[i] = w[i] + 2*g[i];
@@ -577,7 +1206,7 @@ void l2r_l2_svr_fun::grad(double *w, double *g)
 class Solver_MCSVM_CS
 {
 	public:
-		Solver_MCSVM_CS(const problem *prob, int nr_class, double *C, double eps=0.1, int max_iter=100000);
+		Solver_MCSVM_CS(const problem *prob, int nr_class, double *C, double eps, uint64_t seed, train_budget *budget);
 		~Solver_MCSVM_CS();
 		void Solve(double *w);
 	private:
@@ -589,15 +1218,18 @@ class Solver_MCSVM_CS
 		int max_iter;
 		double eps;
 		const problem *prob;
+		prng rng;
+		train_budget *budget;
 };
 
-Solver_MCSVM_CS::Solver_MCSVM_CS(const problem *prob, int nr_class, double *weighted_C, double eps, int max_iter)
+Solver_MCSVM_CS::Solver_MCSVM_CS(const problem *prob, int nr_class, double *weighted_C, double eps, uint64_t seed, train_budget *budget) : rng(seed)
 {
 	this->w_size = prob->n;
 	this->l = prob->l;
 	this->nr_class = nr_class;
 	this->eps = eps;
-	this->max_iter = max_iter;
+	this->max_iter = budget->max_iter(100000);
+	this->budget = budget;
 	this->prob = prob;
 	this->B = new double[nr_class];
 	this->G = new double[nr_class];
@@ -671,6 +1303,8 @@ void Solver_MCSVM_CS::Solve(double *w)
 	double eps_shrink = max(10.0*eps, 1.0); // stopping tolerance for shrinking
 	bool start_from_all = true;
 
+	budget->begin(MCSVM_CS);
+
 	// Initial alpha can be set here. Note that
 	// sum_m alpha[i*nr_class+m] = 0, for all i=1,...,l-1
 	// alpha[i*nr_class+m] <= C[GETI(i)] if prob->y[i] == m
@@ -702,12 +1336,12 @@ void Solver_MCSVM_CS::Solve(double *w)
 		index[i] = i;
 	}
 
-	while(iter < max_iter)
+	while(iter < max_iter && !budget->exhausted())
 	{
 		double stopping = -INF;
 		for(i=0;i<active_size;i++)
 		{
-			int j = i+rand()%(active_size-i);
+			int j = i+rng.below(active_size-i);
 			swap(index[i], index[j]);
 		}
 		for(s=0;s<active_size;s++)
@@ -815,6 +1449,7 @@ void Solver_MCSVM_CS::Solve(double *w)
 		{
 			info(".");
 		}
+		budget->iteration(iter, stopping, active_size);
 
 		if(stopping < eps_shrink)
 		{
@@ -836,7 +1471,10 @@ void Solver_MCSVM_CS::Solve(double *w)
 
 	info("\noptimization finished, #iter = %d\n",iter);
 	if (iter >= max_iter)
+	{
 		info("\nWARNING: reaching max number of iterations\n");
+		budget->stop();
+	}
 
 	// calculate objective value
 	double v = 0;
@@ -854,6 +1492,7 @@ void Solver_MCSVM_CS::Solve(double *w)
 		v -= alpha[i*nr_class+(int)prob->y[i]];
 	info("Objective value = %lf\n",v);
 	info("nSV = %d\n",nSV);
+	budget->end(v);
 
 	delete [] alpha;
 	delete [] alpha_new;
@@ -866,6 +1505,92 @@ void Solver_MCSVM_CS::Solve(double *w)
 	delete [] active_size_i;
 }
 
+// Number of threads for an epoch of the coordinate descent solvers over
+// active_size coordinates (see parameter.hogwild)
+static int dual_threads(const parameter *param, int active_size)
+{
+	if(!param->hogwild || liblinear_parallel_run == NULL)
+		return 1;
+	return max(1, min(param->nr_thread, active_size / MIN_ROWS_PER_THREAD));
+}
+
+// Hogwild style epoch of the dual coordinate descent solvers
+//
+// The shuffled active indices are split into contiguous shards, one per
+// thread. Each thread runs Epoch::run over its shard and updates the shared
+// w without locks (some of the concurrent updates are lost). Shrinking
+// happens within each shard. Afterwards the remaining active indices of all
+// shards are moved to the front and the shards' results are merged.
+//
+// See Niu et al., NIPS 2011 and Hsieh et al., ICML 2015
+template<class Epoch>
+struct dual_shards
+{
+	const Epoch *epoch;
+	int *index;
+	int active_size;
+	int *end;                        // end of each shard's active part
+	typename Epoch::result *result;  // of each shard
+
+	static void run(void *arg, int t, int nr_shard)
+	{
+		dual_shards *d = (dual_shards *)arg;
+		int begin;
+
+		sparse_kernel::range(d->active_size, t, nr_shard, &begin, &d->end[t]);
+		d->epoch->run(d->index, begin, &d->end[t], &d->result[t]);
+	}
+};
+
+// Move the active indices of the nr_shard shards of index[0, active_size)
+// to the front, followed by the shrunk ones. Shard t's active part ends at
+// end[t].
+//
+// Returns the number of active indices
+static int compact_shards(int *index, int active_size, int nr_shard, const int *end)
+{
+	int *shrunk = new int[active_size];
+	int nr_active = 0, nr_shrunk = 0;
+	for(int t=0; t<nr_shard; t++)
+	{
+		int begin, shard_end, s;
+		sparse_kernel::range(active_size, t, nr_shard, &begin, &shard_end);
+		for(s=end[t]; s<shard_end; s++)
+			shrunk[nr_shrunk++] = index[s];
+		for(s=begin; s<end[t]; s++)
+			index[nr_active++] = index[s];
+	}
+	for(int s=0; s<nr_shrunk; s++)
+		index[nr_active+s] = shrunk[s];
+
+	delete [] shrunk;
+	return nr_active;
+}
+
+// Run an epoch over index[0, *active_size), with nr_shard threads
+template<class Epoch>
+static typename Epoch::result dual_epoch(const Epoch &epoch, int *index, int *active_size, int nr_shard)
+{
+	typename Epoch::result r;
+	if(nr_shard <= 1)
+	{
+		epoch.run(index, 0, active_size, &r);
+		return r;
+	}
+
+	dual_shards<Epoch> d = {&epoch, index, *active_size, new int[nr_shard],
+		new typename Epoch::result[nr_shard]};
+	parallel_run(nr_shard, dual_shards<Epoch>::run, &d);
+
+	*active_size = compact_shards(index, d.active_size, nr_shard, d.end);
+	for(int t=0; t<nr_shard; t++)
+		r.merge(d.result[t]);
+
+	delete [] d.result;
+	delete [] d.end;
+	return r;
+}
+
 // A coordinate descent algorithm for
 // L1-loss and L2-loss SVM dual problems
 //
@@ -898,22 +1623,112 @@ void Solver_MCSVM_CS::Solve(double *w)
 #define GETI(i) (y[i]+1)
 // To support weights for instances, use GETI(i) (i)
 
-static int solve_l2r_l1l2_svc(const problem *prob, const parameter *param, double *w, double Cp, double Cn, int max_iter=300)
+// One epoch of solve_l2r_l1l2_svc over index[begin, *end)
+//
+// Shrunk indices are moved to the end of the range, which ends at *end then.
+struct l2r_l1l2_svc_epoch
+{
+	const problem *prob;
+	double *w;
+	double *alpha;
+	const double *QD;
+	const schar *y;
+	const double *diag;
+	const double *upper_bound;
+	double PGmax_old;
+	double PGmin_old;
+
+	struct result
+	{
+		double PGmax, PGmin;
+
+		result() : PGmax(-INF), PGmin(INF) {}
+		void merge(const result &r)
+		{
+			PGmax = max(PGmax, r.PGmax);
+			PGmin = min(PGmin, r.PGmin);
+		}
+	};
+
+	void run(int *index, int begin, int *end, result *r) const
+	{
+		int i, s;
+		double C, d, G;
+
+		// PG: projected gradient, for shrinking and stopping
+		double PG;
+
+		for (s=begin; s<*end; s++)
+		{
+			i = index[s];
+			const schar yi = y[i];
+			const csr_row xi = get_csr_row(prob, i);
+
+			G = yi*sparse_operator::dot(w, xi)-1;
+
+			C = upper_bound[GETI(i)];
+			G += alpha[i]*diag[GETI(i)];
+
+			PG = 0;
+			if (alpha[i] == 0)
+			{
+				if (G > PGmax_old)
+				{
+					(*end)--;
+					swap(index[s], index[*end]);
+					s--;
+					continue;
+				}
+				else if (G < 0)
+					PG = G;
+			}
+			else if (alpha[i] == C)
+			{
+				if (G < PGmin_old)
+				{
+					(*end)--;
+					swap(index[s], index[*end]);
+					s--;
+					continue;
+				}
+				else if (G > 0)
+					PG = G;
+			}
+			else
+				PG = G;
+
+			r->PGmax = max(r->PGmax, PG);
+			r->PGmin = min(r->PGmin, PG);
+
+			if(fabs(PG) > 1.0e-12)
+			{
+				double alpha_old = alpha[i];
+				alpha[i] = min(max(alpha[i] - G/QD[i], 0.0), C);
+				d = (alpha[i] - alpha_old)*yi;
+				sparse_operator::axpy(d, xi, w);
+			}
+		}
+	}
+};
+
+static int solve_l2r_l1l2_svc(const problem *prob, const parameter *param, double *w, double Cp, double Cn, train_budget *budget, int max_iter=300)
 {
 	int l = prob->l;
 	int w_size = prob->n;
 	double eps = param->eps;
 	int solver_type = param->solver_type;
-	int i, s, iter = 0;
-	double C, d, G;
+	int i, iter = 0;
 	double *QD = new double[l];
 	int *index = new int[l];
 	double *alpha = new double[l];
 	schar *y = new schar[l];
 	int active_size = l;
+	prng rng(param->seed);
+	bool parallel = false;
+
+	budget->begin(solver_type);
 
 	// PG: projected gradient, for shrinking and stopping
-	double PG;
 	double PGmax_old = INF;
 	double PGmin_old = -INF;
 	double PGmax_new, PGmin_new;
@@ -952,78 +1767,34 @@ static int solve_l2r_l1l2_svc(const problem *prob, const parameter *param, doubl
 	{
 		QD[i] = diag[GETI(i)];
 
-		feature_node * const xi = prob->x[i];
+		const csr_row xi = get_csr_row(prob, i);
 		QD[i] += sparse_operator::nrm2_sq(xi);
 		sparse_operator::axpy(y[i]*alpha[i], xi, w);
 
 		index[i] = i;
 	}
 
-	while (iter < max_iter)
+	l2r_l1l2_svc_epoch epoch = {prob, w, alpha, QD, y, diag, upper_bound, INF, -INF};
+	while (iter < max_iter && !budget->exhausted())
 	{
-		PGmax_new = -INF;
-		PGmin_new = INF;
-
 		for (i=0; i<active_size; i++)
 		{
-			int j = i+rand()%(active_size-i);
+			int j = i+rng.below(active_size-i);
 			swap(index[i], index[j]);
 		}
 
-		for (s=0; s<active_size; s++)
-		{
-			i = index[s];
-			const schar yi = y[i];
-			feature_node * const xi = prob->x[i];
-
-			G = yi*sparse_operator::dot(w, xi)-1;
-
-			C = upper_bound[GETI(i)];
-			G += alpha[i]*diag[GETI(i)];
-
-			PG = 0;
-			if (alpha[i] == 0)
-			{
-				if (G > PGmax_old)
-				{
-					active_size--;
-					swap(index[s], index[active_size]);
-					s--;
-					continue;
-				}
-				else if (G < 0)
-					PG = G;
-			}
-			else if (alpha[i] == C)
-			{
-				if (G < PGmin_old)
-				{
-					active_size--;
-					swap(index[s], index[active_size]);
-					s--;
-					continue;
-				}
-				else if (G > 0)
-					PG = G;
-			}
-			else
-				PG = G;
-
-			PGmax_new = max(PGmax_new, PG);
-			PGmin_new = min(PGmin_new, PG);
-
-			if(fabs(PG) > 1.0e-12)
-			{
-				double alpha_old = alpha[i];
-				alpha[i] = min(max(alpha[i] - G/QD[i], 0.0), C);
-				d = (alpha[i] - alpha_old)*yi;
-				sparse_operator::axpy(d, xi, w);
-			}
-		}
+		int nr_shard = dual_threads(param, active_size);
+		parallel = parallel || nr_shard > 1;
+		epoch.PGmax_old = PGmax_old;
+		epoch.PGmin_old = PGmin_old;
+		l2r_l1l2_svc_epoch::result r = dual_epoch(epoch, index, &active_size, nr_shard);
+		PGmax_new = r.PGmax;
+		PGmin_new = r.PGmin;
 
 		iter++;
 		if(iter % 10 == 0)
 			info(".");
+		budget->iteration(iter, PGmax_new - PGmin_new, active_size);
 
 		if(PGmax_new - PGmin_new <= eps &&
 			fabs(PGmax_new) <= eps && fabs(PGmin_new) <= eps)
@@ -1049,6 +1820,15 @@ static int solve_l2r_l1l2_svc(const problem *prob, const parameter *param, doubl
 
 	info("\noptimization finished, #iter = %d\n",iter);
 
+	// The parallel epochs may have lost updates of w
+	if(parallel)
+	{
+		for(i=0; i<w_size; i++)
+			w[i] = 0;
+		for(i=0; i<l; i++)
+			sparse_operator::axpy(y[i]*alpha[i], get_csr_row(prob, i), w);
+	}
+
 	// calculate objective value
 
 	double v = 0;
@@ -1063,6 +1843,7 @@ static int solve_l2r_l1l2_svc(const problem *prob, const parameter *param, doubl
 	}
 	info("Objective value = %lf\n",v/2);
 	info("nSV = %d\n",nSV);
+	budget->end(v/2);
 
 	delete [] QD;
 	delete [] alpha;
@@ -1103,72 +1884,45 @@ static int solve_l2r_l1l2_svc(const problem *prob, const parameter *param, doubl
 #define GETI(i) (0)
 // To support weights for instances, use GETI(i) (i)
 
-static int solve_l2r_l1l2_svr(const problem *prob, const parameter *param, double *w, int max_iter=300)
+// One epoch of solve_l2r_l1l2_svr over index[begin, *end)
+//
+// Shrunk indices are moved to the end of the range, which ends at *end then.
+struct l2r_l1l2_svr_epoch
 {
-	const int solver_type = param->solver_type;
-	int l = prob->l;
-	double C = param->C;
-	double p = param->p;
-	int w_size = prob->n;
-	double eps = param->eps;
-	int i, s, iter = 0;
-	int active_size = l;
-	int *index = new int[l];
-
-	double d, G, H;
-	double Gmax_old = INF;
-	double Gmax_new, Gnorm1_new;
-	double Gnorm1_init = -1.0; // Gnorm1_init is initialized at the first iteration
-	double *beta = new double[l];
-	double *QD = new double[l];
-	double *y = prob->y;
-
-	// L2R_L2LOSS_SVR_DUAL
-	double lambda[1], upper_bound[1];
-	lambda[0] = 0.5/C;
-	upper_bound[0] = INF;
-
-	if(solver_type == L2R_L1LOSS_SVR_DUAL)
-	{
-		lambda[0] = 0;
-		upper_bound[0] = C;
-	}
-
-	// Initial beta can be set here. Note that
-	// -upper_bound <= beta[i] <= upper_bound
-	for(i=0; i<l; i++)
-		beta[i] = 0;
-
-	for(i=0; i<w_size; i++)
-		w[i] = 0;
-	for(i=0; i<l; i++)
-	{
-		feature_node * const xi = prob->x[i];
-		QD[i] = sparse_operator::nrm2_sq(xi);
-		sparse_operator::axpy(beta[i], xi, w);
-
-		index[i] = i;
-	}
-
+	const problem *prob;
+	double *w;
+	double *beta;
+	const double *QD;
+	const double *y;
+	const double *lambda;
+	const double *upper_bound;
+	double p;
+	double Gmax_old;
 
-	while(iter < max_iter)
+	struct result
 	{
-		Gmax_new = 0;
-		Gnorm1_new = 0;
+		double Gmax, Gnorm1;
 
-		for(i=0; i<active_size; i++)
+		result() : Gmax(0), Gnorm1(0) {}
+		void merge(const result &r)
 		{
-			int j = i+rand()%(active_size-i);
-			swap(index[i], index[j]);
+			Gmax = max(Gmax, r.Gmax);
+			Gnorm1 += r.Gnorm1;
 		}
+	};
 
-		for(s=0; s<active_size; s++)
+	void run(int *index, int begin, int *end, result *r) const
+	{
+		int i, s;
+		double d, G, H;
+
+		for(s=begin; s<*end; s++)
 		{
 			i = index[s];
 			G = -y[i] + lambda[GETI(i)]*beta[i];
 			H = QD[i] + lambda[GETI(i)];
 
-			feature_node * const xi = prob->x[i];
+			const csr_row xi = get_csr_row(prob, i);
 			G += sparse_operator::dot(w, xi);
 
 			double Gp = G+p;
@@ -1182,8 +1936,8 @@ static int solve_l2r_l1l2_svr(const problem *prob, const parameter *param, doubl
 					violation = Gn;
 				else if(Gp>Gmax_old && Gn<-Gmax_old)
 				{
-					active_size--;
-					swap(index[s], index[active_size]);
+					(*end)--;
+					swap(index[s], index[*end]);
 					s--;
 					continue;
 				}
@@ -1194,8 +1948,8 @@ static int solve_l2r_l1l2_svr(const problem *prob, const parameter *param, doubl
 					violation = Gp;
 				else if(Gp < -Gmax_old)
 				{
-					active_size--;
-					swap(index[s], index[active_size]);
+					(*end)--;
+					swap(index[s], index[*end]);
 					s--;
 					continue;
 				}
@@ -1206,8 +1960,8 @@ static int solve_l2r_l1l2_svr(const problem *prob, const parameter *param, doubl
 					violation = -Gn;
 				else if(Gn > Gmax_old)
 				{
-					active_size--;
-					swap(index[s], index[active_size]);
+					(*end)--;
+					swap(index[s], index[*end]);
 					s--;
 					continue;
 				}
@@ -1217,8 +1971,8 @@ static int solve_l2r_l1l2_svr(const problem *prob, const parameter *param, doubl
 			else
 				violation = fabs(Gn);
 
-			Gmax_new = max(Gmax_new, violation);
-			Gnorm1_new += violation;
+			r->Gmax = max(r->Gmax, violation);
+			r->Gnorm1 += violation;
 
 			// obtain Newton direction d
 			if(Gp < H*beta[i])
@@ -1238,12 +1992,82 @@ static int solve_l2r_l1l2_svr(const problem *prob, const parameter *param, doubl
 			if(d != 0)
 				sparse_operator::axpy(d, xi, w);
 		}
+	}
+};
+
+static int solve_l2r_l1l2_svr(const problem *prob, const parameter *param, double *w, train_budget *budget, int max_iter=300)
+{
+	const int solver_type = param->solver_type;
+	int l = prob->l;
+	double C = param->C;
+	double p = param->p;
+	int w_size = prob->n;
+	double eps = param->eps;
+	int i, iter = 0;
+	int active_size = l;
+	int *index = new int[l];
+	prng rng(param->seed);
+	bool parallel = false;
+
+	double Gmax_old = INF;
+	double Gmax_new, Gnorm1_new;
+	double Gnorm1_init = -1.0; // Gnorm1_init is initialized at the first iteration
+	double *beta = new double[l];
+	double *QD = new double[l];
+	double *y = prob->y;
+
+	budget->begin(solver_type);
+
+	// L2R_L2LOSS_SVR_DUAL
+	double lambda[1], upper_bound[1];
+	lambda[0] = 0.5/C;
+	upper_bound[0] = INF;
+
+	if(solver_type == L2R_L1LOSS_SVR_DUAL)
+	{
+		lambda[0] = 0;
+		upper_bound[0] = C;
+	}
+
+	// Initial beta can be set here. Note that
+	// -upper_bound <= beta[i] <= upper_bound
+	for(i=0; i<l; i++)
+		beta[i] = 0;
+
+	for(i=0; i<w_size; i++)
+		w[i] = 0;
+	for(i=0; i<l; i++)
+	{
+		const csr_row xi = get_csr_row(prob, i);
+		QD[i] = sparse_operator::nrm2_sq(xi);
+		sparse_operator::axpy(beta[i], xi, w);
+
+		index[i] = i;
+	}
+
+
+	l2r_l1l2_svr_epoch epoch = {prob, w, beta, QD, y, lambda, upper_bound, p, INF};
+	while(iter < max_iter && !budget->exhausted())
+	{
+		for(i=0; i<active_size; i++)
+		{
+			int j = i+rng.below(active_size-i);
+			swap(index[i], index[j]);
+		}
+
+		int nr_shard = dual_threads(param, active_size);
+		parallel = parallel || nr_shard > 1;
+		epoch.Gmax_old = Gmax_old;
+		l2r_l1l2_svr_epoch::result r = dual_epoch(epoch, index, &active_size, nr_shard);
+		Gmax_new = r.Gmax;
+		Gnorm1_new = r.Gnorm1;
 
 		if(iter == 0)
 			Gnorm1_init = Gnorm1_new;
 		iter++;
 		if(iter % 10 == 0)
 			info(".");
+		budget->iteration(iter, Gnorm1_new, active_size);
 
 		if(Gnorm1_new <= eps*Gnorm1_init)
 		{
@@ -1263,6 +2087,15 @@ static int solve_l2r_l1l2_svr(const problem *prob, const parameter *param, doubl
 
 	info("\noptimization finished, #iter = %d\n", iter);
 
+	// The parallel epochs may have lost updates of w
+	if(parallel)
+	{
+		for(i=0; i<w_size; i++)
+			w[i] = 0;
+		for(i=0; i<l; i++)
+			sparse_operator::axpy(beta[i], get_csr_row(prob, i), w);
+	}
+
 	// calculate objective value
 	double v = 0;
 	int nSV = 0;
@@ -1278,6 +2111,7 @@ static int solve_l2r_l1l2_svr(const problem *prob, const parameter *param, doubl
 
 	info("Objective value = %lf\n", v);
 	info("nSV = %d\n",nSV);
+	budget->end(v);
 
 	delete [] beta;
 	delete [] QD;
@@ -1311,68 +2145,42 @@ static int solve_l2r_l1l2_svr(const problem *prob, const parameter *param, doubl
 #define GETI(i) (y[i]+1)
 // To support weights for instances, use GETI(i) (i)
 
-static int solve_l2r_lr_dual(const problem *prob, const parameter *param, double *w, double Cp, double Cn, int max_iter=300)
+// One epoch of solve_l2r_lr_dual over index[begin, *end)
+struct l2r_lr_dual_epoch
 {
-	int l = prob->l;
-	int w_size = prob->n;
-	double eps = param->eps;
-	int i, s, iter = 0;
-	double *xTx = new double[l];
-	int *index = new int[l];
-	double *alpha = new double[2*l]; // store alpha and C - alpha
-	schar *y = new schar[l];
-	int max_inner_iter = 100; // for inner Newton
-	double innereps = 1e-2;
-	double innereps_min = min(1e-8, eps);
-	double upper_bound[3] = {Cn, 0, Cp};
+	const problem *prob;
+	double *w;
+	double *alpha;
+	const double *xTx;
+	const schar *y;
+	const double *upper_bound;
+	int max_inner_iter;
+	double innereps;
 
-	for(i=0; i<l; i++)
+	struct result
 	{
-		if(prob->y[i] > 0)
-		{
-			y[i] = +1;
-		}
-		else
+		double Gmax;
+		int newton_iter;
+
+		result() : Gmax(0), newton_iter(0) {}
+		void merge(const result &r)
 		{
-			y[i] = -1;
+			Gmax = max(Gmax, r.Gmax);
+			newton_iter += r.newton_iter;
 		}
-	}
-
-	// Initial alpha can be set here. Note that
-	// 0 < alpha[i] < upper_bound[GETI(i)]
-	// alpha[2*i] + alpha[2*i+1] = upper_bound[GETI(i)]
-	for(i=0; i<l; i++)
-	{
-		alpha[2*i] = min(0.001*upper_bound[GETI(i)], 1e-8);
-		alpha[2*i+1] = upper_bound[GETI(i)] - alpha[2*i];
-	}
+	};
 
-	for(i=0; i<w_size; i++)
-		w[i] = 0;
-	for(i=0; i<l; i++)
+	void run(int *index, int begin, int *end, result *r) const
 	{
-		feature_node * const xi = prob->x[i];
-		xTx[i] = sparse_operator::nrm2_sq(xi);
-		sparse_operator::axpy(y[i]*alpha[2*i], xi, w);
-		index[i] = i;
-	}
+		int i, s;
 
-	while (iter < max_iter)
-	{
-		for (i=0; i<l; i++)
-		{
-			int j = i+rand()%(l-i);
-			swap(index[i], index[j]);
-		}
-		int newton_iter = 0;
-		double Gmax = 0;
-		for (s=0; s<l; s++)
+		for (s=begin; s<*end; s++)
 		{
 			i = index[s];
 			const schar yi = y[i];
 			double C = upper_bound[GETI(i)];
 			double ywTx = 0, xisq = xTx[i];
-			feature_node * const xi = prob->x[i];
+			const csr_row xi = get_csr_row(prob, i);
 			ywTx = yi*sparse_operator::dot(w, xi);
 			double a = xisq, b = ywTx;
 
@@ -1391,7 +2199,7 @@ static int solve_l2r_lr_dual(const problem *prob, const parameter *param, double
 			if(C - z < 0.5 * C)
 				z = 0.1*z;
 			double gp = a*(z-alpha_old)+sign*b+log(z/(C-z));
-			Gmax = max(Gmax, fabs(gp));
+			r->Gmax = max(r->Gmax, fabs(gp));
 
 			// Newton method on the sub-problem
 			const double eta = 0.1; // xi in the paper
@@ -1407,7 +2215,7 @@ static int solve_l2r_lr_dual(const problem *prob, const parameter *param, double
 				else // tmpz in (0, C)
 					z = tmpz;
 				gp = a*(z-alpha_old)+sign*b+log(z/(C-z));
-				newton_iter++;
+				r->newton_iter++;
 				inner_iter++;
 			}
 
@@ -1418,10 +2226,80 @@ static int solve_l2r_lr_dual(const problem *prob, const parameter *param, double
 				sparse_operator::axpy(sign*(z-alpha_old)*yi, xi, w);
 			}
 		}
+	}
+};
+
+static int solve_l2r_lr_dual(const problem *prob, const parameter *param, double *w, double Cp, double Cn, train_budget *budget, int max_iter=300)
+{
+	int l = prob->l;
+	int w_size = prob->n;
+	double eps = param->eps;
+	int i, iter = 0;
+	double *xTx = new double[l];
+	int *index = new int[l];
+	double *alpha = new double[2*l]; // store alpha and C - alpha
+	schar *y = new schar[l];
+	prng rng(param->seed);
+	bool parallel = false;
+	int max_inner_iter = 100; // for inner Newton
+	double innereps = 1e-2;
+	double innereps_min = min(1e-8, eps);
+	double upper_bound[3] = {Cn, 0, Cp};
+
+	budget->begin(param->solver_type);
+
+	for(i=0; i<l; i++)
+	{
+		if(prob->y[i] > 0)
+		{
+			y[i] = +1;
+		}
+		else
+		{
+			y[i] = -1;
+		}
+	}
+
+	// Initial alpha can be set here. Note that
+	// 0 < alpha[i] < upper_bound[GETI(i)]
+	// alpha[2*i] + alpha[2*i+1] = upper_bound[GETI(i)]
+	for(i=0; i<l; i++)
+	{
+		alpha[2*i] = min(0.001*upper_bound[GETI(i)], 1e-8);
+		alpha[2*i+1] = upper_bound[GETI(i)] - alpha[2*i];
+	}
+
+	for(i=0; i<w_size; i++)
+		w[i] = 0;
+	for(i=0; i<l; i++)
+	{
+		const csr_row xi = get_csr_row(prob, i);
+		xTx[i] = sparse_operator::nrm2_sq(xi);
+		sparse_operator::axpy(y[i]*alpha[2*i], xi, w);
+		index[i] = i;
+	}
+
+	l2r_lr_dual_epoch epoch = {prob, w, alpha, xTx, y, upper_bound, max_inner_iter, innereps};
+	while (iter < max_iter && !budget->exhausted())
+	{
+		for (i=0; i<l; i++)
+		{
+			int j = i+rng.below(l-i);
+			swap(index[i], index[j]);
+		}
+
+		int end = l;
+		int nr_shard = dual_threads(param, l);
+		parallel = parallel || nr_shard > 1;
+		epoch.innereps = innereps;
+		l2r_lr_dual_epoch::result r = dual_epoch(epoch, index, &end, nr_shard);
+		int newton_iter = r.newton_iter;
+		double Gmax = r.Gmax;
 
 		iter++;
 		if(iter % 10 == 0)
 			info(".");
+		budget->iteration(iter, Gmax, l, newton_iter);
 
 		if(Gmax < eps)
 			break;
@@ -1433,6 +2311,15 @@ static int solve_l2r_lr_dual(const problem *prob, const parameter *param, double
 
 	info("\noptimization finished, #iter = %d\n",iter);
 
+	// The parallel epochs may have lost updates of w
+	if(parallel)
+	{
+		for(i=0; i<w_size; i++)
+			w[i] = 0;
+		for(i=0; i<l; i++)
+			sparse_operator::axpy(y[i]*alpha[2*i], get_csr_row(prob, i), w);
+	}
+
 	// calculate objective value
 
 	double v = 0;
@@ -1443,6 +2330,7 @@ static int solve_l2r_lr_dual(const problem *prob, const parameter *param, double
 		v += alpha[2*i] * log(alpha[2*i]) + alpha[2*i+1] * log(alpha[2*i+1])
 			- upper_bound[GETI(i)] * log(upper_bound[GETI(i)]);
 	info("Objective value = %lf\n", v);
+	budget->end(v);
 
 	delete [] xTx;
 	delete [] alpha;
@@ -1452,6 +2340,174 @@ static int solve_l2r_lr_dual(const problem *prob, const parameter *param, double
 	return iter;
 }
 
+// Number of threads for the shotgun epochs over the columns of prob_col
+//
+// Each thread copies the row vector (l doubles) every epoch. There are at
+// most as many threads as nonzeros per row on average, so the copies don't
+// outweigh the work of an epoch.
+static int shotgun_threads(const parameter *param, const problem *prob_col)
+{
+	int nr_thread = dual_threads(param, prob_col->n);
+	if(nr_thread <= 1 || prob_col->l <= 0)
+		return nr_thread;
+
+	int64_t nnz = 0;
+	for(int j=0; j<prob_col->n; j++)
+		for(feature_node *x=prob_col->x[j]; x->index != -1; x++)
+			nnz++;
+	return (int)max((int64_t)1, min((int64_t)nr_thread, nnz/prob_col->l));
+}
+
+// Shotgun style epochs of the L1-regularized coordinate descent solvers
+//
+// The shuffled active features are split into contiguous shards, one per
+// thread. Each thread runs Epoch::run over its shard, which updates the
+// thread's features of Epoch::coord() and the thread's own copy of the row
+// vector v (b[] or xTd[]). The changes of the copies are added up
+// afterwards. If the combined step doesn't decrease the objective, it's
+// halved a few times, and finally replaced by a sequential epoch.
+//
+// The copies take nr_thread*l doubles and are refreshed every epoch. Lock
+// free updates of a shared v (as in dual_epoch) would lose some of them,
+// and v can't be recomputed cheaply like w in the dual solvers, so
+// shotgun_threads() limits the number of threads instead.
+//
+// See Bradley et al., ICML 2011
+template<class Epoch>
+class shotgun
+{
+public:
+	shotgun(int l, int w_size, int nr_thread) : l(l), nr_thread(nr_thread)
+	{
+		local = nr_thread > 1 ? new double[(size_t)nr_thread * l] : NULL;
+		coord_old = nr_thread > 1 ? new double[w_size] : NULL;
+		end = new int[nr_thread];
+		result = new typename Epoch::result[nr_thread];
+	}
+
+	~shotgun()
+	{
+		delete [] local;
+		delete [] coord_old;
+		delete [] end;
+		delete [] result;
+	}
+
+	// Run an epoch over index[0, *active_size), with up to nr_shard threads
+	typename Epoch::result run(const Epoch &epoch, int *index, int *active_size, double *v, int nr_shard)
+	{
+		typename Epoch::result r;
+		double *coord = epoch.coord();
+		int i, j, s, t;
+
+		if(nr_shard > nr_thread)
+			nr_shard = nr_thread;
+		if(nr_shard <= 1)
+		{
+			epoch.run(index, 0, active_size, v, &r);
+			return r;
+		}
+
+		job = &epoch;
+		this->index = index;
+		this->v = v;
+		n = *active_size;
+		for(s=0; s<n; s++)
+			coord_old[index[s]] = coord[index[s]];
+
+		this->nr_shard = nr_shard;
+		parallel_run(nr_shard, shard, this);
+		parallel_run(nr_shard, sum, this);
+
+		*active_size = compact_shards(index, n, nr_shard, end);
+		for(t=0; t<nr_shard; t++)
+			r.merge(result[t]);
+
+		double f_old = objective(v, coord_old);
+		double f_new = objective(local, coord);
+		for(int k=0; k<max_halving && f_new > f_old; k++)
+		{
+			for(s=0; s<n; s++)
+			{
+				j = index[s];
+				coord[j] = 0.5*(coord_old[j] + coord[j]);
+			}
+			for(i=0; i<l; i++)
+				local[i] = 0.5*(v[i] + local[i]);
+			f_new = objective(local, coord);
+		}
+
+		if(f_new > f_old)
+		{
+			for(s=0; s<n; s++)
+				coord[index[s]] = coord_old[index[s]];
+			*active_size = n;
+			r = typename Epoch::result();
+			epoch.run(index, 0, active_size, v, &r);
+			return r;
+		}
+
+		for(i=0; i<l; i++)
+			v[i] = local[i];
+		return r;
+	}
+
+private:
+	static const int max_halving = 4;
+
+	int l;
+	int nr_thread;
+	double *local;         // the threads' copies of v
+	double *coord_old;     // the active coordinates before the epoch
+	int *end;              // end of each shard's active part
+	typename Epoch::result *result;  // of each shard
+
+	// The running epoch
+	const Epoch *job;
+	int *index;
+	int n;
+	const double *v;
+	int nr_shard;
+
+	// Objective over the rows and the features index[0, n)
+	double objective(const double *v, const double *coord) const
+	{
+		double f = job->row_objective(v);
+		for(int s=0; s<n; s++)
+			f += job->coord_objective(index[s], coord[index[s]]);
+		return f;
+	}
+
+	static void shard(void *arg, int t, int nr_shard)
+	{
+		shotgun *g = (shotgun *)arg;
+		double *v = g->local + (size_t)t * g->l;
+		int begin;
+
+		for(int i=0; i<g->l; i++)
+			v[i] = g->v[i];
+		sparse_kernel::range(g->n, t, nr_shard, &begin, &g->end[t]);
+		g->result[t] = typename Epoch::result();
+		g->job->run(g->index, begin, &g->end[t], v, &g->result[t]);
+	}
+
+	// Add the changes of the other threads' copies of v to the first one
+	static void sum(void *arg, int t, int nr_thread)
+	{
+		shotgun *g = (shotgun *)arg;
+		int begin, end;
+
+		sparse_kernel::range(g->l, t, nr_thread, &begin, &end);
+		for(int i=begin; i<end; i++)
+		{
+			double vi = g->local[i];
+			for(int k=1; k<g->nr_shard; k++)
+				vi += g->local[(size_t)k * g->l + i] - g->v[i];
+			g->local[i] = vi;
+		}
+	}
+};
+
 // A coordinate descent algorithm for
 // L1-regularized L2-loss support vector classification
 //
@@ -1474,73 +2530,91 @@ static int solve_l2r_lr_dual(const problem *prob, const parameter *param, double
 #define GETI(i) (y[i]+1)
 // To support weights for instances, use GETI(i) (i)
 
-static int solve_l1r_l2_svc(const problem *prob_col, const parameter* param, double *w, double Cp, double Cn, double eps)
+// One epoch of solve_l1r_l2_svc over the features index[begin, *end)
+//
+// b is the shared b[] or a thread's copy of it (see shotgun). Shrunk
+// features are moved to the end of the range, which ends at *end then.
+struct l1r_l2_svc_epoch
 {
-	int l = prob_col->l;
-	int w_size = prob_col->n;
-	int regularize_bias = param->regularize_bias;
-	int j, s, iter = 0;
-	int max_iter = 1000;
-	int active_size = w_size;
-	int max_num_linesearch = 20;
+	const problem *prob_col;
+	double *w;
+	double *b_shared;
+	const double *xj_sq;
+	const schar *y;
+	const double *C;
+	int regularize_bias;
+	double Gmax_old;
 
-	double sigma = 0.01;
-	double d, G_loss, G, H;
-	double Gmax_old = INF;
-	double Gmax_new, Gnorm1_new;
-	double Gnorm1_init = -1.0; // Gnorm1_init is initialized at the first iteration
-	double d_old, d_diff;
-	double loss_old = 0, loss_new;
-	double appxcond, cond;
+	struct result
+	{
+		double Gmax, Gnorm1;
+		bool recompute;     // b[] needs to be recomputed from w
 
-	int *index = new int[w_size];
-	schar *y = new schar[l];
-	double *b = new double[l]; // b = 1-ywTx
-	double *xj_sq = new double[w_size];
-	feature_node *x;
+		result() : Gmax(0), Gnorm1(0), recompute(false) {}
+		void merge(const result &r)
+		{
+			Gmax = max(Gmax, r.Gmax);
+			Gnorm1 += r.Gnorm1;
+			recompute = recompute || r.recompute;
+		}
+	};
 
-	double C[3] = {Cn,0,Cp};
+	double *coord() const
+	{
+		return w;
+	}
 
-	// Initial w can be set here.
-	for(j=0; j<w_size; j++)
-		w[j] = 0;
+	double row_objective(const double *b) const
+	{
+		double v = 0;
+		for(int i=0; i<prob_col->l; i++)
+			if(b[i] > 0)
+				v += C[GETI(i)]*b[i]*b[i];
+		return v;
+	}
 
-	for(j=0; j<l; j++)
+	double coord_objective(int j, double wj) const
 	{
-		b[j] = 1;
-		if(prob_col->y[j] > 0)
-			y[j] = 1;
-		else
-			y[j] = -1;
+		if(j == prob_col->n-1 && regularize_bias == 0)
+			return 0;
+		return fabs(wj);
 	}
-	for(j=0; j<w_size; j++)
+
+	// b += a*yi*xij over column x (the columns hold xij, not yi*xij)
+	void axpy(double a, const feature_node *x, double *b) const
 	{
-		index[j] = j;
-		xj_sq[j] = 0;
-		x = prob_col->x[j];
-		while(x->index != -1)
-		{
-			int ind = x->index-1;
-			x->value *= y[ind]; // x->value stores yi*xij
-			double val = x->value;
-			b[ind] -= w[j]*val;
-			xj_sq[j] += C[GETI(ind)]*val*val;
-			x++;
-		}
+		for(; x->index != -1; x++)
+			b[x->index-1] += a*(y[x->index-1]*x->value);
 	}
 
-	while(iter < max_iter)
+	// b = 1-ywTx
+	void recompute(double *b) const
 	{
-		Gmax_new = 0;
-		Gnorm1_new = 0;
+		for(int i=0; i<prob_col->l; i++)
+			b[i] = 1;
 
-		for(j=0; j<active_size; j++)
+		for(int i=0; i<prob_col->n; i++)
 		{
-			int i = j+rand()%(active_size-j);
-			swap(index[i], index[j]);
+			if(w[i]==0) continue;
+			axpy(-w[i], prob_col->x[i], b);
 		}
+	}
 
-		for(s=0; s<active_size; s++)
+	void run(int *index, int begin, int *end, double *b, result *r) const
+	{
+		int l = prob_col->l;
+		int w_size = prob_col->n;
+		int j, s;
+		int max_num_linesearch = 20;
+
+		double sigma = 0.01;
+		double d, G_loss, G, H;
+		double d_old, d_diff;
+		double loss_old = 0, loss_new;
+		double appxcond, cond;
+		feature_node *x;
+
+		for(s=begin; s<*end; s++)
 		{
 			j = index[s];
 			G_loss = 0;
@@ -1552,7 +2626,7 @@ static int solve_l1r_l2_svc(const problem *prob_col, const parameter* param, dou
 				int ind = x->index-1;
 				if(b[ind] > 0)
 				{
-					double val = x->value;
+					double val = y[ind]*x->value;
 					double tmp = C[GETI(ind)]*val;
 					G_loss -= tmp*b[ind];
 					H += tmp*val;
@@ -1581,8 +2655,8 @@ static int solve_l1r_l2_svc(const problem *prob_col, const parameter* param, dou
 						violation = Gn;
 					else if(Gp>Gmax_old/l && Gn<-Gmax_old/l)
 					{
-						active_size--;
-						swap(index[s], index[active_size]);
+						(*end)--;
+						swap(index[s], index[*end]);
 						s--;
 						continue;
 					}
@@ -1592,8 +2666,8 @@ static int solve_l1r_l2_svc(const problem *prob_col, const parameter* param, dou
 				else
 					violation = fabs(Gn);
 			}
-			Gmax_new = max(Gmax_new, violation);
-			Gnorm1_new += violation;
+			r->Gmax = max(r->Gmax, violation);
+			r->Gnorm1 += violation;
 
 			// obtain Newton direction d
 			if(j == w_size-1 && regularize_bias == 0)
@@ -1629,8 +2703,7 @@ static int solve_l1r_l2_svc(const problem *prob_col, const parameter* param, dou
 				appxcond = xj_sq[j]*d*d + G_loss*d + cond;
 				if(appxcond <= 0)
 				{
-					x = prob_col->x[j];
-					sparse_operator::axpy(d_diff, x, b);
+					axpy(d_diff, prob_col->x[j], b);
 					break;
 				}
 
@@ -1644,7 +2717,7 @@ static int solve_l1r_l2_svc(const problem *prob_col, const parameter* param, dou
 						int ind = x->index-1;
 						if(b[ind] > 0)
 							loss_old += C[GETI(ind)]*b[ind]*b[ind];
-						double b_new = b[ind] + d_diff*x->value;
+						double b_new = b[ind] + d_diff*(y[ind]*x->value);
 						b[ind] = b_new;
 						if(b_new > 0)
 							loss_new += C[GETI(ind)]*b_new*b_new;
@@ -1658,7 +2731,7 @@ static int solve_l1r_l2_svc(const problem *prob_col, const parameter* param, dou
 					while(x->index != -1)
 					{
 						int ind = x->index-1;
-						double b_new = b[ind] + d_diff*x->value;
+						double b_new = b[ind] + d_diff*(y[ind]*x->value);
 						b[ind] = b_new;
 						if(b_new > 0)
 							loss_new += C[GETI(ind)]*b_new*b_new;
@@ -1666,40 +2739,113 @@ static int solve_l1r_l2_svc(const problem *prob_col, const parameter* param, dou
 					}
 				}
 
-				cond = cond + loss_new - loss_old;
-				if(cond <= 0)
-					break;
-				else
-				{
-					d_old = d;
-					d *= 0.5;
-					delta *= 0.5;
-				}
-			}
+				cond = cond + loss_new - loss_old;
+				if(cond <= 0)
+					break;
+				else
+				{
+					d_old = d;
+					d *= 0.5;
+					delta *= 0.5;
+				}
+			}
+
+			w[j] += d;
+
+			// recompute b[] if line search takes too many steps
+			if(num_linesearch >= max_num_linesearch)
+			{
+				// A thread's copy is recomputed after the epoch, from
+				// all threads' w
+				if(b != b_shared)
+					r->recompute = true;
+				else
+				{
+					info("#");
+					recompute(b);
+				}
+			}
+		}
+	}
+};
+
+static int solve_l1r_l2_svc(const problem *prob_col, const parameter* param, double *w, double Cp, double Cn, double eps, train_budget *budget)
+{
+	int l = prob_col->l;
+	int w_size = prob_col->n;
+	int regularize_bias = param->regularize_bias;
+	int j, iter = 0;
+	int max_iter = budget->max_iter(1000);
+	int active_size = w_size;
+	prng rng(param->seed);
+
+	double Gmax_old = INF;
+	double Gmax_new, Gnorm1_new;
+	double Gnorm1_init = -1.0; // Gnorm1_init is initialized at the first iteration
+
+	int *index = new int[w_size];
+	schar *y = new schar[l];
+	double *b = new double[l]; // b = 1-ywTx
+	double *xj_sq = new double[w_size];
+	feature_node *x;
 
-			w[j] += d;
+	double C[3] = {Cn,0,Cp};
 
-			// recompute b[] if line search takes too many steps
-			if(num_linesearch >= max_num_linesearch)
-			{
-				info("#");
-				for(int i=0; i<l; i++)
-					b[i] = 1;
+	budget->begin(param->solver_type);
 
-				for(int i=0; i<w_size; i++)
-				{
-					if(w[i]==0) continue;
-					x = prob_col->x[i];
-					sparse_operator::axpy(-w[i], x, b);
-				}
-			}
+	// Initial w can be set here.
+	for(j=0; j<w_size; j++)
+		w[j] = 0;
+
+	for(j=0; j<l; j++)
+	{
+		b[j] = 1;
+		if(prob_col->y[j] > 0)
+			y[j] = 1;
+		else
+			y[j] = -1;
+	}
+	for(j=0; j<w_size; j++)
+	{
+		index[j] = j;
+		xj_sq[j] = 0;
+		x = prob_col->x[j];
+		while(x->index != -1)
+		{
+			int ind = x->index-1;
+			double val = y[ind]*x->value;
+			b[ind] -= w[j]*val;
+			xj_sq[j] += C[GETI(ind)]*val*val;
+			x++;
+		}
+	}
+
+	l1r_l2_svc_epoch epoch = {prob_col, w, b, xj_sq, y, C, regularize_bias, INF};
+	shotgun<l1r_l2_svc_epoch> shards(l, w_size, shotgun_threads(param, prob_col));
+	while(iter < max_iter && !budget->exhausted())
+	{
+		for(j=0; j<active_size; j++)
+		{
+			int i = j+rng.below(active_size-j);
+			swap(index[i], index[j]);
+		}
+
+		epoch.Gmax_old = Gmax_old;
+		l1r_l2_svc_epoch::result r = shards.run(epoch, index, &active_size, b, dual_threads(param, active_size));
+		if(r.recompute)
+		{
+			info("#");
+			epoch.recompute(b);
 		}
+		Gmax_new = r.Gmax;
+		Gnorm1_new = r.Gnorm1;
 
 		if(iter == 0)
 			Gnorm1_init = Gnorm1_new;
 		iter++;
 		if(iter % 10 == 0)
 			info(".");
+		budget->iteration(iter, Gnorm1_new, active_size);
 
 		if(Gnorm1_new <= eps*Gnorm1_init)
 		{
@@ -1719,7 +2865,10 @@ static int solve_l1r_l2_svc(const problem *prob_col, const parameter* param, dou
 
 	info("\noptimization finished, #iter = %d\n", iter);
 	if(iter >= max_iter)
+	{
 		info("\nWARNING: reaching max number of iterations\n");
+		budget->stop();
+	}
 
 	// calculate objective value
 
@@ -1727,12 +2876,6 @@ static int solve_l1r_l2_svc(const problem *prob_col, const parameter* param, dou
 	int nnz = 0;
 	for(j=0; j<w_size; j++)
 	{
-		x = prob_col->x[j];
-		while(x->index != -1)
-		{
-			x->value *= prob_col->y[x->index-1]; // restore x->value
-			x++;
-		}
 		if(w[j] != 0)
 		{
 			v += fabs(w[j]);
@@ -1747,6 +2890,7 @@ static int solve_l1r_l2_svc(const problem *prob_col, const parameter* param, dou
 
 	info("Objective value = %lf\n", v);
 	info("#nonzeros/#features = %d/%d\n", nnz, w_size);
+	budget->end(v);
 
 	delete [] index;
 	delete [] y;
@@ -1778,23 +2922,186 @@ static int solve_l1r_l2_svc(const problem *prob_col, const parameter* param, dou
 #define GETI(i) (y[i]+1)
 // To support weights for instances, use GETI(i) (i)
 
-static int solve_l1r_lr(const problem *prob_col, const parameter *param, double *w, double Cp, double Cn, double eps)
+// Diagonal Hessian and gradient of solve_l1r_lr, for the features
+// [w_size*t/nr_thread, w_size*(t+1)/nr_thread)
+struct l1r_lr_grad
+{
+	const problem *prob_col;
+	double *Hdiag;
+	double *Grad;
+	const double *xjneg_sum;
+	const double *tau;
+	const double *D;
+	double nu;
+
+	static void run(void *arg, int t, int nr_thread)
+	{
+		l1r_lr_grad *k = (l1r_lr_grad *)arg;
+		int j, begin, end;
+
+		sparse_kernel::range(k->prob_col->n, t, nr_thread, &begin, &end);
+		for(j=begin; j<end; j++)
+		{
+			k->Hdiag[j] = k->nu;
+			k->Grad[j] = 0;
+
+			double tmp = 0;
+			feature_node *x = k->prob_col->x[j];
+			while(x->index != -1)
+			{
+				int ind = x->index-1;
+				k->Hdiag[j] += x->value*x->value*k->D[ind];
+				tmp += x->value*k->tau[ind];
+				x++;
+			}
+			k->Grad[j] = -tmp + k->xjneg_sum[j];
+		}
+	}
+};
+
+// One epoch of the QP of solve_l1r_lr over the features index[begin, *end)
+//
+// xTd is the shared xTd[] or a thread's copy of it (see shotgun). Shrunk
+// features are moved to the end of the range, which ends at *end then.
+struct l1r_lr_qp_epoch
+{
+	const problem *prob_col;
+	const double *w;
+	double *wpd;
+	const double *Hdiag;
+	const double *Grad;
+	const double *D;
+	double nu;
+	int regularize_bias;
+	double QP_Gmax_old;
+
+	struct result
+	{
+		double Gmax, Gnorm1;
+
+		result() : Gmax(0), Gnorm1(0) {}
+		void merge(const result &r)
+		{
+			Gmax = max(Gmax, r.Gmax);
+			Gnorm1 += r.Gnorm1;
+		}
+	};
+
+	double *coord() const
+	{
+		return wpd;
+	}
+
+	double row_objective(const double *xTd) const
+	{
+		double v = 0;
+		for(int i=0; i<prob_col->l; i++)
+			v += D[i]*xTd[i]*xTd[i];
+		return 0.5*v;
+	}
+
+	double coord_objective(int j, double wpdj) const
+	{
+		double dj = wpdj-w[j];
+		double v = Grad[j]*dj + 0.5*nu*dj*dj;
+		if(j == prob_col->n-1 && regularize_bias == 0)
+			return v;
+		return v + fabs(wpdj);
+	}
+
+	void run(int *index, int begin, int *end, double *xTd, result *r) const
+	{
+		int l = prob_col->l;
+		int w_size = prob_col->n;
+		int j, s;
+		double z = 0, G, H;
+		feature_node *x;
+
+		for(s=begin; s<*end; s++)
+		{
+			j = index[s];
+			H = Hdiag[j];
+
+			x = prob_col->x[j];
+			G = Grad[j] + (wpd[j]-w[j])*nu;
+			while(x->index != -1)
+			{
+				int ind = x->index-1;
+				G += x->value*D[ind]*xTd[ind];
+				x++;
+			}
+
+			double violation = 0;
+			if (j == w_size-1 && regularize_bias == 0)
+			{
+				// bias term not shrunken
+				violation = fabs(G);
+				z = -G/H;
+			}
+			else
+			{
+				double Gp = G+1;
+				double Gn = G-1;
+				if(wpd[j] == 0)
+				{
+					if(Gp < 0)
+						violation = -Gp;
+					else if(Gn > 0)
+						violation = Gn;
+					//inner-level shrinking
+					else if(Gp>QP_Gmax_old/l && Gn<-QP_Gmax_old/l)
+					{
+						(*end)--;
+						swap(index[s], index[*end]);
+						s--;
+						continue;
+					}
+				}
+				else if(wpd[j] > 0)
+					violation = fabs(Gp);
+				else
+					violation = fabs(Gn);
+
+				// obtain solution of one-variable problem
+				if(Gp < H*wpd[j])
+					z = -Gp/H;
+				else if(Gn > H*wpd[j])
+					z = -Gn/H;
+				else
+					z = -wpd[j];
+			}
+			r->Gmax = max(r->Gmax, violation);
+			r->Gnorm1 += violation;
+
+			if(fabs(z) < 1.0e-12)
+				continue;
+			z = min(max(z,-10.0),10.0);
+
+			wpd[j] += z;
+
+			x = prob_col->x[j];
+			sparse_operator::axpy(z, x, xTd);
+		}
+	}
+};
+
+static int solve_l1r_lr(const problem *prob_col, const parameter *param, double *w, double Cp, double Cn, double eps, train_budget *budget)
 {
 	int l = prob_col->l;
 	int w_size = prob_col->n;
 	int regularize_bias = param->regularize_bias;
 	int j, s, newton_iter=0, iter=0;
-	int max_newton_iter = 100;
+	int max_newton_iter = budget->max_iter(100);
 	int max_iter = 1000;
 	int max_num_linesearch = 20;
 	int active_size;
 	int QP_active_size;
+	prng rng(param->seed);
 
 	double nu = 1e-12;
 	double inner_eps = 1;
 	double sigma = 0.01;
 	double w_norm, w_norm_new;
-	double z, G, H;
 	double Gnorm1_init = -1.0; // Gnorm1_init is initialized at the first iteration
 	double Gmax_old = INF;
 	double Gmax_new, Gnorm1_new;
@@ -1817,6 +3124,8 @@ static int solve_l1r_lr(const problem *prob_col, const parameter *param, double
 
 	double C[3] = {Cn,0,Cp};
 
+	budget->begin(param->solver_type);
+
 	// Initial w can be set here.
 	for(j=0; j<w_size; j++)
 		w[j] = 0;
@@ -1860,28 +3169,20 @@ static int solve_l1r_lr(const problem *prob_col, const parameter *param, double
 		D[j] = C[GETI(j)]*exp_wTx[j]*tau_tmp*tau_tmp;
 	}
 
-	while(newton_iter < max_newton_iter)
+	l1r_lr_grad grad = {prob_col, Hdiag, Grad, xjneg_sum, tau, D, nu};
+	l1r_lr_qp_epoch epoch = {prob_col, w, wpd, Hdiag, Grad, D, nu, regularize_bias, INF};
+	shotgun<l1r_lr_qp_epoch> shards(l, w_size, shotgun_threads(param, prob_col));
+	while(newton_iter < max_newton_iter && !budget->exhausted())
 	{
 		Gmax_new = 0;
 		Gnorm1_new = 0;
 		active_size = w_size;
 
+		parallel_run(dual_threads(param, w_size), l1r_lr_grad::run, &grad);
+
 		for(s=0; s<active_size; s++)
 		{
 			j = index[s];
-			Hdiag[j] = nu;
-			Grad[j] = 0;
-
-			double tmp = 0;
-			x = prob_col->x[j];
-			while(x->index != -1)
-			{
-				int ind = x->index-1;
-				Hdiag[j] += x->value*x->value*D[ind];
-				tmp += x->value*tau[ind];
-				x++;
-			}
-			Grad[j] = -tmp + xjneg_sum[j];
 
 			double violation = 0;
 			if (j == w_size-1 && regularize_bias == 0)
@@ -1930,80 +3231,16 @@ static int solve_l1r_lr(const problem *prob_col, const parameter *param, double
 		// optimize QP over wpd
 		while(iter < max_iter)
 		{
-			QP_Gmax_new = 0;
-			QP_Gnorm1_new = 0;
-
 			for(j=0; j<QP_active_size; j++)
 			{
-				int i = j+rand()%(QP_active_size-j);
+				int i = j+rng.below(QP_active_size-j);
 				swap(index[i], index[j]);
 			}
 
-			for(s=0; s<QP_active_size; s++)
-			{
-				j = index[s];
-				H = Hdiag[j];
-
-				x = prob_col->x[j];
-				G = Grad[j] + (wpd[j]-w[j])*nu;
-				while(x->index != -1)
-				{
-					int ind = x->index-1;
-					G += x->value*D[ind]*xTd[ind];
-					x++;
-				}
-
-				double violation = 0;
-				if (j == w_size-1 && regularize_bias == 0)
-				{
-					// bias term not shrunken
-					violation = fabs(G);
-					z = -G/H;
-				}
-				else
-				{
-					double Gp = G+1;
-					double Gn = G-1;
-					if(wpd[j] == 0)
-					{
-						if(Gp < 0)
-							violation = -Gp;
-						else if(Gn > 0)
-							violation = Gn;
-						//inner-level shrinking
-						else if(Gp>QP_Gmax_old/l && Gn<-QP_Gmax_old/l)
-						{
-							QP_active_size--;
-							swap(index[s], index[QP_active_size]);
-							s--;
-							continue;
-						}
-					}
-					else if(wpd[j] > 0)
-						violation = fabs(Gp);
-					else
-						violation = fabs(Gn);
-
-					// obtain solution of one-variable problem
-					if(Gp < H*wpd[j])
-						z = -Gp/H;
-					else if(Gn > H*wpd[j])
-						z = -Gn/H;
-					else
-						z = -wpd[j];
-				}
-				QP_Gmax_new = max(QP_Gmax_new, violation);
-				QP_Gnorm1_new += violation;
-
-				if(fabs(z) < 1.0e-12)
-					continue;
-				z = min(max(z,-10.0),10.0);
-
-				wpd[j] += z;
-
-				x = prob_col->x[j];
-				sparse_operator::axpy(z, x, xTd);
-			}
+			epoch.QP_Gmax_old = QP_Gmax_old;
+			l1r_lr_qp_epoch::result r = shards.run(epoch, index, &QP_active_size, xTd, dual_threads(param, QP_active_size));
+			QP_Gmax_new = r.Gmax;
+			QP_Gnorm1_new = r.Gnorm1;
 
 			iter++;
 
@@ -2112,12 +3349,18 @@ static int solve_l1r_lr(const problem *prob_col, const parameter *param, double
 		Gmax_old = Gmax_new;
 
 		info("iter %3d  #CD cycles %d\n", newton_iter, iter);
+		budget->iteration(newton_iter, Gnorm1_new, active_size, iter, NAN,
+			num_linesearch < max_num_linesearch ? ldexp(1.0, -num_linesearch) : 0,
+			min(num_linesearch+1, max_num_linesearch));
 	}
 
 	info("=========================\n");
 	info("optimization finished, #iter = %d\n", newton_iter);
 	if(newton_iter >= max_newton_iter)
+	{
 		info("WARNING: reaching max number of iterations\n");
+		budget->stop();
+	}
 
 	// calculate objective value
 
@@ -2139,6 +3382,7 @@ static int solve_l1r_lr(const problem *prob_col, const parameter *param, double
 
 	info("Objective value = %lf\n", v);
 	info("#nonzeros/#features = %d/%d\n", nnz, w_size);
+	budget->end(v);
 
 	delete [] index;
 	delete [] y;
@@ -2175,12 +3419,12 @@ static int compare_feature_node(const void *a, const void *b)
 }
 
 // elements before the returned index are < pivot, while those after are >= pivot
-static int partition(feature_node *nodes, int low, int high)
+static int partition(feature_node *nodes, int low, int high, prng &rng)
 {
 	int i;
 	int index;
 
-	swap(nodes[low + rand()%(high-low+1)], nodes[high]); // select and move pivot to the end
+	swap(nodes[low + rng.below(high-low+1)], nodes[high]); // select and move pivot to the end
 
 	index = low;
 	for(i = low; i < high; i++)
@@ -2195,18 +3439,18 @@ static int partition(feature_node *nodes, int low, int high)
 }
 
 // rearrange nodes so that nodes[:k] contains nodes with the k smallest values.
-static void quick_select_min_k(feature_node *nodes, int low, int high, int k)
+static void quick_select_min_k(feature_node *nodes, int low, int high, int k, prng &rng)
 {
 	int pivot;
 	if(low == high)
 		return;
-	pivot = partition(nodes, low, high);
+	pivot = partition(nodes, low, high, rng);
 	if(pivot == k)
 		return;
 	else if(k-1 < pivot)
-		return quick_select_min_k(nodes, low, pivot-1, k);
+		return quick_select_min_k(nodes, low, pivot-1, k, rng);
 	else
-		return quick_select_min_k(nodes, pivot+1, high, k);
+		return quick_select_min_k(nodes, pivot+1, high, k, rng);
 }
 
 // A two-level coordinate descent algorithm for
@@ -2228,7 +3472,7 @@ static void quick_select_min_k(feature_node *nodes, int low, int high, int k)
 //
 // See Algorithm 7 in supplementary materials of Chou et al., SDM 2020.
 
-static int solve_oneclass_svm(const problem *prob, const parameter *param, double *w, double *rho)
+static int solve_oneclass_svm(const problem *prob, const parameter *param, double *w, double *rho, train_budget *budget)
 {
 	int l = prob->l;
 	int w_size = prob->n;
@@ -2241,9 +3485,10 @@ static int solve_oneclass_svm(const problem *prob, const parameter *param, doubl
 	double *QD = new double[l];
 	double *G = new double[l];
 	int *index = new int[l];
+	prng rng(param->seed);
 	double *alpha = new double[l];
 	int max_inner_iter;
-	int max_iter = 1000;
+	int max_iter = budget->max_iter(1000);
 	int active_size = l;
 
 	double negGmax;                 // max { -grad(f)_i | i in Iup }
@@ -2253,6 +3498,8 @@ static int solve_oneclass_svm(const problem *prob, const parameter *param, doubl
 	feature_node *min_negG_of_Ilow = new feature_node[l];
 	feature_node node;
 
+	budget->begin(ONECLASS_SVM);
+
 	int n = (int)(nu*l);            // # of alpha's at upper bound
 	for(i=0; i<n; i++)
 		alpha[i] = 1;
@@ -2272,7 +3519,7 @@ static int solve_oneclass_svm(const problem *prob, const parameter *param, doubl
 		index[i] = i;
 	}
 
-	while (iter < max_iter)
+	while (iter < max_iter && !budget->exhausted())
 	{
 		negGmax = -INF;
 		negGmin = INF;
@@ -2335,10 +3582,10 @@ static int solve_oneclass_svm(const problem *prob, const parameter *param, doubl
 		}
 		max_inner_iter = min(max_inner_iter, min(len_Iup, len_Ilow));
 
-		quick_select_min_k(max_negG_of_Iup, 0, len_Iup-1, len_Iup-max_inner_iter);
+		quick_select_min_k(max_negG_of_Iup, 0, len_Iup-1, len_Iup-max_inner_iter, rng);
 		qsort(&(max_negG_of_Iup[len_Iup-max_inner_iter]), max_inner_iter, sizeof(struct feature_node), compare_feature_node);
 
-		quick_select_min_k(min_negG_of_Ilow, 0, len_Ilow-1, max_inner_iter);
+		quick_select_min_k(min_negG_of_Ilow, 0, len_Ilow-1, max_inner_iter, rng);
 		qsort(min_negG_of_Ilow, max_inner_iter, sizeof(struct feature_node), compare_feature_node);
 
 		for (s=0; s<max_inner_iter; s++)
@@ -2413,10 +3660,14 @@ static int solve_oneclass_svm(const problem *prob, const parameter *param, doubl
 		iter++;
 		if (iter % 10 == 0)
 			info(".");
+		budget->iteration(iter, negGmax - negGmin, active_size, max_inner_iter);
 	}
 	info("\noptimization finished, #iter = %d\n",iter);
 	if (iter >= max_iter)
+	{
 		info("\nWARNING: reaching max number of iterations\n\n");
+		budget->stop();
+	}
 
 	// calculate object value
 	double v = 0;
@@ -2430,6 +3681,7 @@ static int solve_oneclass_svm(const problem *prob, const parameter *param, doubl
 	}
 	info("Objective value = %lf\n", v/2);
 	info("nSV = %d\n", nSV);
+	budget->end(v/2);
 
 	// calculate rho
 	double nr_free = 0;
@@ -2464,14 +3716,53 @@ static int solve_oneclass_svm(const problem *prob, const parameter *param, doubl
 	return iter;
 }
 
+// Row parallel transpose (see transpose)
+//
+// Pass 0 counts the features of each column in the thread's rows, pass 1
+// writes them at the column positions prepared from the counts. Thread t
+// works on offset[t*n, (t+1)*n).
+struct transpose_job
+{
+	const problem *prob;
+	feature_node *x_space;
+	size_t *offset;
+	int pass;
+
+	static void run(void *arg, int t, int nr_thread)
+	{
+		transpose_job *job = (transpose_job *)arg;
+		const problem *prob = job->prob;
+		size_t *offset = job->offset + (size_t)t*prob->n;
+		int i, begin, end;
+
+		sparse_kernel::range(prob->l, t, nr_thread, &begin, &end);
+		for(i=begin; i<end; i++)
+		{
+			feature_node *x = prob->x[i];
+			if(job->pass == 0)
+				for(; x->index != -1; x++)
+					offset[x->index-1]++;
+			else
+				for(; x->index != -1; x++)
+				{
+					feature_node *node = &job->x_space[offset[x->index-1]++];
+					node->index = i+1; // starts from 1
+					node->value = x->value;
+				}
+		}
+	}
+};
+
 // transpose matrix X from row format to column format
-static void transpose(const problem *prob, feature_node **x_space_ret, problem *prob_col)
+//
+// The rows are split between up to nr_thread threads. The columns are the
+// same for any number of threads.
+static void transpose(const problem *prob, feature_node **x_space_ret, problem *prob_col, int nr_thread)
 {
-	int i;
+	int i, t;
 	int l = prob->l;
 	int n = prob->n;
 	size_t nnz = 0;
-	size_t *col_ptr = new size_t [n+1];
 	feature_node *x_space;
 	prob_col->l = l;
 	prob_col->n = n;
@@ -2481,43 +3772,42 @@ static void transpose(const problem *prob, feature_node **x_space_ret, problem *
 	for(i=0; i<l; i++)
 		prob_col->y[i] = prob->y[i];
 
-	for(i=0; i<n+1; i++)
-		col_ptr[i] = 0;
-	for(i=0; i<l; i++)
-	{
-		feature_node *x = prob->x[i];
-		while(x->index != -1)
-		{
-			nnz++;
-			col_ptr[x->index]++;
-			x++;
-		}
-	}
-	for(i=1; i<n+1; i++)
-		col_ptr[i] += col_ptr[i-1] + 1;
+	if(liblinear_parallel_run == NULL)
+		nr_thread = 1;
+	nr_thread = max(1, min(nr_thread, l / MIN_ROWS_PER_THREAD));
 
+	size_t size = (size_t)nr_thread*n;
+	size_t *offset = new size_t[size];
+	for(size_t k=0; k<size; k++)
+		offset[k] = 0;
+	transpose_job job = {prob, NULL, offset, 0};
+	parallel_run(nr_thread, transpose_job::run, &job);
+
+	for(size_t k=0; k<size; k++)
+		nnz += offset[k];
 	x_space = new feature_node[nnz+n];
-	for(i=0; i<n; i++)
-		prob_col->x[i] = &x_space[col_ptr[i]];
 
-	for(i=0; i<l; i++)
+	// column i holds the features of thread 0, 1, ... and the -1 sentinel
+	nnz = 0;
+	for(i=0; i<n; i++)
 	{
-		feature_node *x = prob->x[i];
-		while(x->index != -1)
+		prob_col->x[i] = &x_space[nnz];
+		for(t=0; t<nr_thread; t++)
 		{
-			int ind = x->index-1;
-			x_space[col_ptr[ind]].index = i+1; // starts from 1
-			x_space[col_ptr[ind]].value = x->value;
-			col_ptr[ind]++;
-			x++;
+			size_t count = offset[(size_t)t*n+i];
+			offset[(size_t)t*n+i] = nnz;
+			nnz += count;
 		}
+		x_space[nnz++].index = -1;
 	}
-	for(i=0; i<n; i++)
-		x_space[col_ptr[i]].index = -1;
+
+	job.x_space = x_space;
+	job.pass = 1;
+	parallel_run(nr_thread, transpose_job::run, &job);
 
 	*x_space_ret = x_space;
 
-	delete [] col_ptr;
+	delete [] offset;
 }
 
 // label: label name, start: begin of each class, count: #data of classes, perm: indices to the original data
@@ -2597,10 +3887,112 @@ static void group_classes(const problem *prob, int *nr_class_ret, int **label_re
 	free(data_label);
 }
 
-static void train_one(const problem *prob, const parameter *param, double *w, double Cp, double Cn)
+// Transposed x of a problem, shared by the L1R solvers of all classes
+//
+// Its rows are in the order of the original problem (see problem::col_x),
+// row maps the rows of the grouped problem to them.
+struct col_problem
+{
+	problem cols;             // y unused
+	const int *row;           // NULL: same order
+};
+
+// Transposed problem for the L1R solvers
+//
+// cols (if not NULL) contains the already transposed x of prob, which is
+// used instead of transposing again. The solvers don't modify the columns,
+// so they may share them.
+static void get_prob_col(const problem *prob, const col_problem *cols, problem *prob_col, feature_node **x_space)
+{
+	if(cols != NULL)
+	{
+		*prob_col = cols->cols;
+		if(cols->row != NULL)
+		{
+			prob_col->y = new double[prob->l];
+			for(int i=0; i<prob->l; i++)
+				prob_col->y[cols->row[i]] = prob->y[i];
+		}
+		else
+			prob_col->y = prob->y;
+		*x_space = NULL;
+	}
+	else
+		transpose(prob, x_space, prob_col, 1);
+}
+
+static void free_prob_col(problem *prob_col, const col_problem *cols, feature_node *x_space)
+{
+	if(x_space != NULL)
+	{
+		delete [] prob_col->y;
+		delete [] prob_col->x;
+		delete [] x_space;
+	}
+	else if(cols->row != NULL)
+		delete [] prob_col->y;
+}
+
+// Run the primal newton solver within budget
+struct newton_job
+{
+	l2r_erm_fun *fun_obj;
+	NEWTON *newton_obj;
+	double *w;
+	bool converged;
+
+	static void run(void *arg, thread_team *team)
+	{
+		newton_job *job = (newton_job *)arg;
+
+		job->fun_obj->set_team(team);
+		job->converged = job->newton_obj->newton(job->w);
+		job->fun_obj->set_team(NULL);
+	}
+};
+
+// The kernels of a multi-threaded run share one thread_team
+static void solve_newton(l2r_erm_fun *fun_obj, int solver_type, double eps, double *w, train_budget *budget)
+{
+	NEWTON newton_obj(fun_obj, eps, 0.5, budget->max_iter(1000));
+	newton_obj.set_print_string(liblinear_print_string);
+	newton_obj.set_stop(train_budget::exhausted, budget);
+	budget->begin(solver_type);
+	if(budget->run() != NULL)
+	{
+		fun_obj->set_stats(budget->run());
+		newton_obj.set_report(train_budget::newton_iteration, budget);
+	}
+	newton_job job = {fun_obj, &newton_obj, w, true};
+	if(fun_obj->get_nr_thread() > 1)
+		thread_team::run(fun_obj->get_nr_thread(), newton_job::run, &job);
+	else
+		newton_job::run(&job, NULL);
+	if(!job.converged)
+		budget->stop();
+	budget->end(NAN);
+}
+
+// Whether a dual solver run ending after iter iterations is continued by
+// the primal solver. It is, if it reached the default iteration limit. A
+// limit set by parameter::max_iter is final.
+static bool dual_fallback(const parameter *param, train_budget *budget, int iter, int max_iter)
+{
+	if(iter < max_iter)
+		return false;
+	if(param->max_iter > 0)
+	{
+		info("\nWARNING: reaching max number of iterations\n");
+		budget->stop();
+		return false;
+	}
+	return true;
+}
+
+static void train_one(const problem *prob, const parameter *param, double *w, double Cp, double Cn, const col_problem *cols, train_budget *budget)
 {
 	int solver_type = param->solver_type;
-	int dual_solver_max_iter = 300;
+	int dual_solver_max_iter = budget->max_iter(300);
 	int iter;
 
 	bool is_regression = (solver_type==L2R_L2LOSS_SVR ||
@@ -2637,106 +4029,96 @@ static void train_one(const problem *prob, const parameter *param, double *w, do
 		case L2R_LR:
 		{
 			l2r_lr_fun fun_obj(prob, param, C);
-			NEWTON newton_obj(&fun_obj, primal_solver_tol);
-			newton_obj.set_print_string(liblinear_print_string);
-			newton_obj.newton(w);
+			solve_newton(&fun_obj, L2R_LR, primal_solver_tol, w, budget);
 			break;
 		}
 		case L2R_L2LOSS_SVC:
 		{
 			l2r_l2_svc_fun fun_obj(prob, param, C);
-			NEWTON newton_obj(&fun_obj, primal_solver_tol);
-			newton_obj.set_print_string(liblinear_print_string);
-			newton_obj.newton(w);
+			solve_newton(&fun_obj, L2R_L2LOSS_SVC, primal_solver_tol, w, budget);
 			break;
 		}
 		case L2R_L2LOSS_SVC_DUAL:
 		{
-			iter = solve_l2r_l1l2_svc(prob, param, w, Cp, Cn, dual_solver_max_iter);
-			if(iter >= dual_solver_max_iter)
+			iter = solve_l2r_l1l2_svc(prob, param, w, Cp, Cn, budget, dual_solver_max_iter);
+			if(dual_fallback(param, budget, iter, dual_solver_max_iter))
 			{
 				info("\nWARNING: reaching max number of iterations\nSwitching to use -s 2\n\n");
 				// primal_solver_tol obtained from eps for dual may be too loose
 				primal_solver_tol *= 0.1;
 				l2r_l2_svc_fun fun_obj(prob, param, C);
-				NEWTON newton_obj(&fun_obj, primal_solver_tol);
-				newton_obj.set_print_string(liblinear_print_string);
-				newton_obj.newton(w);
+				solve_newton(&fun_obj, L2R_L2LOSS_SVC, primal_solver_tol, w, budget);
 			}
 			break;
 		}
 		case L2R_L1LOSS_SVC_DUAL:
 		{
-			iter = solve_l2r_l1l2_svc(prob, param, w, Cp, Cn, dual_solver_max_iter);
+			iter = solve_l2r_l1l2_svc(prob, param, w, Cp, Cn, budget, dual_solver_max_iter);
 			if(iter >= dual_solver_max_iter)
-				info("\nWARNING: reaching max number of iterations\nUsing -s 2 may be faster (also see FAQ)\n\n");			
+			{
+				info("\nWARNING: reaching max number of iterations\nUsing -s 2 may be faster (also see FAQ)\n\n");
+				budget->stop();
+			}
 			break;
 		}
 		case L1R_L2LOSS_SVC:
 		{
 			problem prob_col;
-			feature_node *x_space = NULL;
-			transpose(prob, &x_space ,&prob_col);
-			solve_l1r_l2_svc(&prob_col, param, w, Cp, Cn, primal_solver_tol);
-			delete [] prob_col.y;
-			delete [] prob_col.x;
-			delete [] x_space;
+			feature_node *x_space;
+			get_prob_col(prob, cols, &prob_col, &x_space);
+			solve_l1r_l2_svc(&prob_col, param, w, Cp, Cn, primal_solver_tol, budget);
+			free_prob_col(&prob_col, cols, x_space);
 			break;
 		}
 		case L1R_LR:
 		{
 			problem prob_col;
-			feature_node *x_space = NULL;
-			transpose(prob, &x_space ,&prob_col);
-			solve_l1r_lr(&prob_col, param, w, Cp, Cn, primal_solver_tol);
-			delete [] prob_col.y;
-			delete [] prob_col.x;
-			delete [] x_space;
+			feature_node *x_space;
+			get_prob_col(prob, cols, &prob_col, &x_space);
+			solve_l1r_lr(&prob_col, param, w, Cp, Cn, primal_solver_tol, budget);
+			free_prob_col(&prob_col, cols, x_space);
 			break;
 		}
 		case L2R_LR_DUAL:
 		{
-			iter = solve_l2r_lr_dual(prob, param, w, Cp, Cn, dual_solver_max_iter);
-			if(iter >= dual_solver_max_iter)
+			iter = solve_l2r_lr_dual(prob, param, w, Cp, Cn, budget, dual_solver_max_iter);
+			if(dual_fallback(param, budget, iter, dual_solver_max_iter))
 			{
 				info("\nWARNING: reaching max number of iterations\nSwitching to use -s 0\n\n");
 				// primal_solver_tol obtained from eps for dual may be too loose
 				primal_solver_tol *= 0.1;
 				l2r_lr_fun fun_obj(prob, param, C);
-				NEWTON newton_obj(&fun_obj, primal_solver_tol);
-				newton_obj.set_print_string(liblinear_print_string);
-				newton_obj.newton(w);
+				solve_newton(&fun_obj, L2R_LR, primal_solver_tol, w, budget);
 			}
 			break;
 		}
 		case L2R_L2LOSS_SVR:
 		{
 			l2r_l2_svr_fun fun_obj(prob, param, C);
-			NEWTON newton_obj(&fun_obj, primal_solver_tol);
-			newton_obj.set_print_string(liblinear_print_string);
-			newton_obj.newton(w);
+			solve_newton(&fun_obj, L2R_L2LOSS_SVR, primal_solver_tol, w, budget);
 			break;
 		}
 		case L2R_L1LOSS_SVR_DUAL:
 		{
-			iter = solve_l2r_l1l2_svr(prob, param, w, dual_solver_max_iter);
+			iter = solve_l2r_l1l2_svr(prob, param, w, budget, dual_solver_max_iter);
 			if(iter >= dual_solver_max_iter)
-				info("\nWARNING: reaching max number of iterations\nUsing -s 11 may be faster (also see FAQ)\n\n");			
+			{
+				info("\nWARNING: reaching max number of iterations\nUsing -s 11 may be faster (also see FAQ)\n\n");
+				budget->stop();
+			}
 
 			break;
 		}
 		case L2R_L2LOSS_SVR_DUAL:
 		{
-			iter = solve_l2r_l1l2_svr(prob, param, w, dual_solver_max_iter);
-			if(iter >= dual_solver_max_iter)
+			iter = solve_l2r_l1l2_svr(prob, param, w, budget, dual_solver_max_iter);
+			if(dual_fallback(param, budget, iter, dual_solver_max_iter))
 			{
 				info("\nWARNING: reaching max number of iterations\nSwitching to use -s 11\n\n");
 				// primal_solver_tol obtained from eps for dual may be too loose
 				primal_solver_tol *= 0.001;
 				l2r_l2_svr_fun fun_obj(prob, param, C);
-				NEWTON newton_obj(&fun_obj, primal_solver_tol);
-				newton_obj.set_print_string(liblinear_print_string);
-				newton_obj.newton(w);
+				solve_newton(&fun_obj, L2R_L2LOSS_SVR, primal_solver_tol, w, budget);
 			}
 			break;
 		}
@@ -2803,78 +4185,197 @@ static double calc_max_p(const problem *prob)
 	return max_p;
 }
 
-static void find_parameter_C(const problem *prob, parameter *param_tmp, double start_C, double max_C, double *best_C, double *best_score, const int *fold_start, const int *perm, const problem *subprob, int nr_fold)
+// Cross validation folds
+//
+// The permuted rows are stored twice in a row, so the training rows of fold
+// i (all rows but fold_start[i], ..., fold_start[i+1]-1) are the window
+// starting at fold_start[i+1]. The subproblems point into these arrays
+// instead of copying the rows for each fold.
+struct cv_folds
 {
-	// variables for CV
-	int i;
-	double *target = Malloc(double, prob->l);
-
-	// variables for warm start
-	double ratio = 2;
-	double **prev_w = Malloc(double*, nr_fold);
-	for(i = 0; i < nr_fold; i++)
-		prev_w[i] = NULL;
-	int num_unchanged_w = 0;
-	void (*default_print_string) (const char *) = liblinear_print_string;
+	int nr_fold;
+	int *fold_start;
+	int *perm;
+	feature_node **x;
+	double *y;
+	int64_t *csr_start;
+	problem *subprob;
+};
 
-	if(param_tmp->solver_type == L2R_LR || param_tmp->solver_type == L2R_L2LOSS_SVC)
-		*best_score = 0.0;
-	else if(param_tmp->solver_type == L2R_L2LOSS_SVR)
-		*best_score = INF;
-	*best_C = start_C;
+static void init_folds(cv_folds *folds, const problem *prob, const parameter *param, int nr_fold)
+{
+	int i, l = prob->l;
+
+	folds->nr_fold = nr_fold;
+	folds->fold_start = Malloc(int,nr_fold+1);
+	folds->perm = Malloc(int,l);
+	folds->x = Malloc(feature_node*,2*(size_t)l);
+	folds->y = Malloc(double,2*(size_t)l);
+	folds->csr_start = NULL;
+	if(prob->csr_index != NULL)
+		folds->csr_start = Malloc(int64_t,2*(size_t)l);
+	folds->subprob = Malloc(problem,nr_fold);
+
+	random_permutation(folds->perm, l, param->seed);
+	for(i=0;i<l;i++)
+	{
+		folds->x[i] = folds->x[l+i] = prob->x[folds->perm[i]];
+		folds->y[i] = folds->y[l+i] = prob->y[folds->perm[i]];
+		if(folds->csr_start != NULL)
+			folds->csr_start[i] = folds->csr_start[l+i] = prob->csr_start[folds->perm[i]];
+	}
+	for(i=0;i<=nr_fold;i++)
+		folds->fold_start[i]=(int)((int64_t)i*l/nr_fold);
 
-	param_tmp->C = start_C;
-	while(param_tmp->C <= max_C)
+	for(i=0;i<nr_fold;i++)
 	{
-		//Output disabled for running CV at a particular C
-		set_print_string_function(&print_null);
+		int begin = folds->fold_start[i];
+		int end = folds->fold_start[i+1];
+		problem *subprob = &folds->subprob[i];
+
+		subprob->bias = prob->bias;
+		subprob->n = prob->n;
+		subprob->l = l-(end-begin);
+		subprob->x = folds->x + end;
+		subprob->y = folds->y + end;
+		subprob->csr_index = prob->csr_index;
+		subprob->csr_value = prob->csr_value;
+		subprob->csr_start = folds->csr_start ? folds->csr_start + end : NULL;
+		subprob->col_x = NULL;
+	}
+}
 
-		for(i=0; i<nr_fold; i++)
-		{
-			int j;
-			int begin = fold_start[i];
-			int end = fold_start[i+1];
+static void free_folds(cv_folds *folds)
+{
+	free(folds->fold_start);
+	free(folds->perm);
+	free(folds->x);
+	free(folds->y);
+	free(folds->csr_start);
+	free(folds->subprob);
+}
+
+// The folds are trained in parallel, sharing the threads
+static int fold_workers(const parameter *param, int nr_fold, parameter *param_fold)
+{
+	int nr_worker = 1;
+	if(liblinear_parallel_run != NULL)
+		nr_worker = max(1, min(param->nr_thread, nr_fold));
+	*param_fold = *param;
+	param_fold->nr_thread = max(1, param->nr_thread/nr_worker);
+	return nr_worker;
+}
+
+// Cross validation folds at a single C
+//
+// Worker t trains the folds t, t+nr_worker, ..., each warm-started from the
+// fold's previous solution if prev_w is set. The folds only share the
+// (read-only) problem and write disjoint parts of target.
+struct fold_job
+{
+	const problem *prob;
+	const parameter *param;
+	const cv_folds *folds;
+	double **prev_w;
+	int check_w;              // compare w to prev_w?
+	int *changed_w;           // per fold: w changed?
+	double *target;
+};
+
+static void train_folds(void *arg, int t, int nr_worker)
+{
+	fold_job *job = (fold_job *)arg;
+	parameter param = *job->param;
+	int i, j;
+
+	const cv_folds *folds = job->folds;
+	for(i=t;i<folds->nr_fold;i+=nr_worker)
+	{
+		int begin = folds->fold_start[i];
+		int end = folds->fold_start[i+1];
+		double *prev_w = job->prev_w ? job->prev_w[i] : NULL;
 
-			param_tmp->init_sol = prev_w[i];
-			struct model *submodel = train(&subprob[i],param_tmp);
+		param.init_sol = prev_w;
+		struct model *submodel = train(&folds->subprob[i],&param);
 
+		if(job->prev_w != NULL)
+		{
 			int total_w_size;
 			if(submodel->nr_class == 2)
-				total_w_size = subprob[i].n;
+				total_w_size = folds->subprob[i].n;
 			else
-				total_w_size = subprob[i].n * submodel->nr_class;
+				total_w_size = folds->subprob[i].n * submodel->nr_class;
 
-			if(prev_w[i] == NULL)
+			job->changed_w[i] = 0;
+			if(prev_w == NULL)
 			{
-				prev_w[i] = Malloc(double, total_w_size);
+				prev_w = job->prev_w[i] = Malloc(double, total_w_size);
 				for(j=0; j<total_w_size; j++)
-					prev_w[i][j] = submodel->w[j];
+					prev_w[j] = submodel->w[j];
 			}
-			else if(num_unchanged_w >= 0)
+			else if(job->check_w)
 			{
 				double norm_w_diff = 0;
 				for(j=0; j<total_w_size; j++)
 				{
-					norm_w_diff += (submodel->w[j] - prev_w[i][j])*(submodel->w[j] - prev_w[i][j]);
-					prev_w[i][j] = submodel->w[j];
+					norm_w_diff += (submodel->w[j] - prev_w[j])*(submodel->w[j] - prev_w[j]);
+					prev_w[j] = submodel->w[j];
 				}
 				norm_w_diff = sqrt(norm_w_diff);
 
 				if(norm_w_diff > 1e-15)
-					num_unchanged_w = -1;
+					job->changed_w[i] = 1;
 			}
 			else
 			{
 				for(j=0; j<total_w_size; j++)
-					prev_w[i][j] = submodel->w[j];
+					prev_w[j] = submodel->w[j];
 			}
+		}
 
-			for(j=begin; j<end; j++)
-				target[perm[j]] = predict(submodel,prob->x[perm[j]]);
+		for(j=begin; j<end; j++)
+			job->target[folds->perm[j]] = predict(submodel,folds->x[j]);
 
-			free_and_destroy_model(&submodel);
-		}
-		set_print_string_function(default_print_string);
+		free_and_destroy_model(&submodel);
+	}
+}
+
+static void find_parameter_C(const problem *prob, parameter *param_tmp, double start_C, double max_C, double *best_C, double *best_score, const cv_folds *folds)
+{
+	int nr_fold = folds->nr_fold;
+	// variables for CV
+	int i;
+	double *target = Malloc(double, prob->l);
+
+	// variables for warm start
+	double ratio = 2;
+	double **prev_w = Malloc(double*, nr_fold);
+	for(i = 0; i < nr_fold; i++)
+		prev_w[i] = NULL;
+	int num_unchanged_w = 0;
+
+	int *changed_w = Malloc(int, nr_fold);
+	parameter param_fold;
+	int nr_worker = fold_workers(param_tmp, nr_fold, &param_fold);
+	fold_job job = {prob, &param_fold, folds, prev_w, 0, changed_w, target};
+
+	if(param_tmp->solver_type == L2R_LR || param_tmp->solver_type == L2R_L2LOSS_SVC)
+		*best_score = 0.0;
+	else if(param_tmp->solver_type == L2R_L2LOSS_SVR)
+		*best_score = INF;
+	*best_C = start_C;
+
+	param_tmp->C = start_C;
+	while(param_tmp->C <= max_C)
+	{
+		// The output isn't disabled here: the print function is global and
+		// may be set concurrently, and pyliblinear discards it anyway
+		param_fold.C = param_tmp->C;
+		job.check_w = (num_unchanged_w >= 0);
+		parallel_run(nr_worker, train_folds, &job);
+		for(i=0; i<nr_fold; i++)
+			if(changed_w[i])
+				num_unchanged_w = -1;
 
 		if(param_tmp->solver_type == L2R_LR || param_tmp->solver_type == L2R_L2LOSS_SVC)
 		{
@@ -2919,22 +4420,302 @@ static void find_parameter_C(const problem *prob, parameter *param_tmp, double s
 	if(param_tmp->C > max_C)
 		info("WARNING: maximum C reached.\n");
 	free(target);
+	free(changed_w);
 	for(i=0; i<nr_fold; i++)
 		free(prev_w[i]);
 	free(prev_w);
 }
 
 
+// One-vs-rest training of all classes
 //
-// Interface functions
-//
-model* train(const problem *prob, const parameter *param)
+// Worker t trains the classes t, t+nr_worker, ... with its own y and w
+// buffers. The binary subproblems are independent and every class draws
+// its random numbers from its own seed, so the result doesn't depend on
+// the thread scheduling.
+struct ovr_job
+{
+	const problem *prob;      // x grouped by class
+	const parameter *param;
+	int nr_class;
+	const int *start;
+	const int *count;
+	const double *weighted_C;
+	double *w;                // model w, w_size * nr_class
+	const col_problem *cols;  // transposed x (L1R solvers) or NULL
+	train_budget *budget;
+	run_log *logs;            // runs of each class (parameter::stats) or NULL
+};
+
+static void train_ovr(void *arg, int t, int nr_worker)
+{
+	ovr_job *job = (ovr_job *)arg;
+	const parameter *param = job->param;
+	parameter param_class = *param;
+	int nr_class = job->nr_class;
+	int w_size = job->prob->n;
+	int i, j, k;
+
+	problem sub_prob = *job->prob;
+	sub_prob.y = Malloc(double,sub_prob.l);
+	double *w=Malloc(double, w_size);
+
+	for(i=t;i<nr_class;i+=nr_worker)
+	{
+		int si = job->start[i];
+		int ei = si+job->count[i];
+
+		k=0;
+		for(; k<si; k++)
+			sub_prob.y[k] = -1;
+		for(; k<ei; k++)
+			sub_prob.y[k] = +1;
+		for(; k<sub_prob.l; k++)
+			sub_prob.y[k] = -1;
+
+		if(param->init_sol != NULL)
+			for(j=0;j<w_size;j++)
+				w[j] = param->init_sol[j*nr_class+i];
+		else
+			for(j=0;j<w_size;j++)
+				w[j] = 0;
+
+		param_class.seed = prng::subseed(param->seed, i);
+		train_budget budget(job->budget, i, job->logs != NULL ? &job->logs[i] : NULL);
+		train_one(&sub_prob, &param_class, w, job->weighted_C[i], param->C, job->cols, &budget);
+
+		for(j=0;j<w_size;j++)
+			job->w[j*nr_class+i] = w[j];
+	}
+	free(w);
+	free(sub_prob.y);
+}
+
+// Number of classes to train in parallel
+static int ovr_workers(const parameter *param, int nr_class)
+{
+	if(liblinear_parallel_run == NULL)
+		return 1;
+	return max(1, min(param->nr_thread, nr_class));
+}
+
+// Training data of a problem, prepared once for training it with one or
+// more parameter sets of the same solver type (see train_path)
+struct train_data
+{
+	int nr_class;
+	int *label;
+	int *start;
+	int *count;
+	problem sub_prob;         // x grouped by class (classification only)
+	int *perm;                // row of prob for each row of sub_prob
+	col_problem cols;         // transposed prob->x (L1R solvers only)
+	feature_node *x_space;    // storage of cols, if prob comes without one
+	int *csr_index;           // storage of sub_prob's structure-of-arrays
+	double *csr_value;        // layout, if prob comes without one
+	int64_t *csr_start;       // row starts of sub_prob (if grouped or built)
+	double prepare_time;      // seconds spent here (parameter::stats only)
+};
+
+static bool is_regression_solver(int solver_type)
+{
+	return (solver_type==L2R_L2LOSS_SVR ||
+		solver_type==L2R_L1LOSS_SVR_DUAL ||
+		solver_type==L2R_L2LOSS_SVR_DUAL);
+}
+
+// The dual coordinate descent and primal newton solvers work on the
+// structure-of-arrays layout (see problem::csr_index)
+int check_csr_solver(const struct parameter *param)
+{
+	int solver_type = param->solver_type;
+	return (solver_type != MCSVM_CS &&
+		solver_type != L1R_L2LOSS_SVC &&
+		solver_type != L1R_LR &&
+		solver_type != ONECLASS_SVM);
+}
+
+// Build the structure-of-arrays layout of prob->x
+static void build_csr(const problem *prob, int **index_ret, double **value_ret, int64_t **start_ret)
+{
+	int i;
+	int l = prob->l;
+	int64_t nnz = 0;
+
+	for(i=0;i<l;i++)
+	{
+		feature_node *x = prob->x[i];
+		while(x->index != -1)
+			x++;
+		nnz += (x - prob->x[i]) + 1;
+	}
+
+	// The vector kernels may read up to 3 indices behind the last sentinel
+	int *index = Malloc(int, nnz + 3);
+	double *value = Malloc(double, nnz);
+	int64_t *start = Malloc(int64_t, l);
+
+	nnz = 0;
+	for(i=0;i<l;i++)
+	{
+		feature_node *x = prob->x[i];
+		start[i] = nnz;
+		for(; x->index != -1; x++, nnz++)
+		{
+			index[nnz] = x->index;
+			value[nnz] = x->value;
+		}
+		index[nnz] = -1;
+		value[nnz++] = 0;
+	}
+	for(i=0;i<3;i++)
+		index[nnz+i] = -1;
+
+	*index_ret = index;
+	*value_ret = value;
+	*start_ret = start;
+}
+
+static void init_train_data(const problem *prob, const parameter *param, train_data *data)
 {
 	int i,j;
 	int l = prob->l;
+	double start = param->stats ? wall_clock() : 0;
+
+	data->nr_class = 0;
+	data->label = NULL;
+	data->start = NULL;
+	data->count = NULL;
+	data->sub_prob = *prob;
+	data->perm = NULL;
+	data->cols.cols.x = NULL;
+	data->cols.row = NULL;
+	data->x_space = NULL;
+	data->csr_index = NULL;
+	data->csr_value = NULL;
+	data->csr_start = NULL;
+
+	if(!is_regression_solver(param->solver_type) && param->solver_type != ONECLASS_SVM)
+	{
+		int nr_class;
+		int *perm = Malloc(int,l);
+
+		// group training data of the same class
+		group_classes(prob,&nr_class,&data->label,&data->start,&data->count,perm);
+		data->nr_class = nr_class;
+
+		// constructing the subproblem
+		problem *sub_prob = &data->sub_prob;
+		sub_prob->x = Malloc(feature_node *,l);
+		sub_prob->y = Malloc(double,l);
+		for(i=0;i<l;i++)
+			sub_prob->x[i] = prob->x[perm[i]];
+		if(prob->csr_index != NULL)
+		{
+			data->csr_start = Malloc(int64_t,l);
+			for(i=0;i<l;i++)
+				data->csr_start[i] = prob->csr_start[perm[i]];
+			sub_prob->csr_start = data->csr_start;
+		}
+		sub_prob->col_x = NULL;
+		data->perm = perm;
+
+		// multi-class svm by Crammer and Singer
+		if(param->solver_type == MCSVM_CS)
+		{
+			for(i=0;i<nr_class;i++)
+				for(j=data->start[i];j<data->start[i]+data->count[i];j++)
+					sub_prob->y[j] = i;
+		}
+		else if(nr_class == 2)
+		{
+			int e0 = data->start[0]+data->count[0];
+			for(i=0; i<e0; i++)
+				sub_prob->y[i] = +1;
+			for(; i<l; i++)
+				sub_prob->y[i] = -1;
+		}
+		// one-vs-rest: the labels are set per class (see train_ovr)
+	}
+
+	if(data->sub_prob.csr_index == NULL && check_csr_solver(param))
+	{
+		build_csr(&data->sub_prob, &data->csr_index, &data->csr_value, &data->csr_start);
+		data->sub_prob.csr_index = data->csr_index;
+		data->sub_prob.csr_value = data->csr_value;
+		data->sub_prob.csr_start = data->csr_start;
+	}
+
+	// The columns don't depend on the labels, so all classes share them.
+	// They keep the row order of prob, so they may come with it.
+	if(param->solver_type == L1R_L2LOSS_SVC || param->solver_type == L1R_LR)
+	{
+		problem *cols = &data->cols.cols;
+		if(prob->col_x != NULL)
+		{
+			*cols = *prob;
+			cols->x = prob->col_x;
+			cols->col_x = NULL;
+		}
+		else
+		{
+			transpose(prob, &data->x_space, cols, param->nr_thread);
+			delete [] cols->y;
+		}
+		cols->y = NULL;
+		cols->csr_index = NULL;
+		cols->csr_value = NULL;
+		cols->csr_start = NULL;
+		data->cols.row = data->perm;
+	}
+
+	data->prepare_time = param->stats ? wall_clock() - start : 0;
+}
+
+static void free_train_data(train_data *data)
+{
+	if(data->label != NULL)
+	{
+		free(data->sub_prob.x);
+		free(data->sub_prob.y);
+	}
+	free(data->label);
+	free(data->start);
+	free(data->count);
+	free(data->perm);
+	if(data->x_space != NULL)
+	{
+		delete [] data->cols.cols.x;
+		delete [] data->x_space;
+	}
+	free(data->csr_index);
+	free(data->csr_value);
+	free(data->csr_start);
+}
+
+// Append the runs of other to log
+static void append_runs(run_log *log, run_log *other)
+{
+	if(other->nr_run == 0)
+		return;
+
+	log->run = (train_run_stats *)realloc(log->run, (log->nr_run+other->nr_run)*sizeof(train_run_stats));
+	memcpy(log->run+log->nr_run, other->run, other->nr_run*sizeof(train_run_stats));
+	log->nr_run += other->nr_run;
+	free(other->run);
+}
+
+static model* train_prepared(const train_data *data, const parameter *param)
+{
+	int i,j;
+	const problem *prob = &data->sub_prob;
+	const col_problem *cols = (data->cols.cols.x != NULL) ? &data->cols : NULL;
 	int n = prob->n;
 	int w_size = prob->n;
 	model *model_ = Malloc(model,1);
+	run_log log = {0, NULL};
+	train_budget budget(param, param->stats ? &log : NULL);
+	double start = param->stats ? wall_clock() : 0;
 
 	if(prob->bias>=0)
 		model_->nr_feature=n-1;
@@ -2956,25 +4737,20 @@ model* train(const problem *prob, const parameter *param)
 
 		model_->nr_class = 2;
 		model_->label = NULL;
-		train_one(prob, param, model_->w, 0, 0);
+		train_one(prob, param, model_->w, 0, 0, cols, &budget);
 	}
 	else if(check_oneclass_model(model_))
 	{
 		model_->w = Malloc(double, w_size);
 		model_->nr_class = 2;
 		model_->label = NULL;
-		solve_oneclass_svm(prob, param, model_->w, &(model_->rho));
+		solve_oneclass_svm(prob, param, model_->w, &(model_->rho), &budget);
 	}
 	else
 	{
-		int nr_class;
-		int *label = NULL;
-		int *start = NULL;
-		int *count = NULL;
-		int *perm = Malloc(int,l);
-
-		// group training data of the same class
-		group_classes(prob,&nr_class,&label,&start,&count,perm);
+		int nr_class = data->nr_class;
+		const int *label = data->label;
+		const problem *sub_prob = &data->sub_prob;
 
 		model_->nr_class=nr_class;
 		model_->label = Malloc(int,nr_class);
@@ -2996,29 +4772,11 @@ model* train(const problem *prob, const parameter *param)
 				weighted_C[j] *= param->weight[i];
 		}
 
-		// constructing the subproblem
-		feature_node **x = Malloc(feature_node *,l);
-		for(i=0;i<l;i++)
-			x[i] = prob->x[perm[i]];
-
-		int k;
-		problem sub_prob;
-		sub_prob.l = l;
-		sub_prob.n = n;
-		sub_prob.x = Malloc(feature_node *,sub_prob.l);
-		sub_prob.y = Malloc(double,sub_prob.l);
-
-		for(k=0; k<sub_prob.l; k++)
-			sub_prob.x[k] = x[k];
-
 		// multi-class svm by Crammer and Singer
 		if(param->solver_type == MCSVM_CS)
 		{
 			model_->w=Malloc(double, n*nr_class);
-			for(i=0;i<nr_class;i++)
-				for(j=start[i];j<start[i]+count[i];j++)
-					sub_prob.y[j] = i;
-			Solver_MCSVM_CS Solver(&sub_prob, nr_class, weighted_C, param->eps);
+			Solver_MCSVM_CS Solver(sub_prob, nr_class, weighted_C, param->eps, param->seed, &budget);
 			Solver.Solve(model_->w);
 		}
 		else
@@ -3027,13 +4785,6 @@ model* train(const problem *prob, const parameter *param)
 			{
 				model_->w=Malloc(double, w_size);
 
-				int e0 = start[0]+count[0];
-				k=0;
-				for(; k<e0; k++)
-					sub_prob.y[k] = +1;
-				for(; k<sub_prob.l; k++)
-					sub_prob.y[k] = -1;
-
 				if(param->init_sol != NULL)
 					for(i=0;i<w_size;i++)
 						model_->w[i] = param->init_sol[i];
@@ -3041,110 +4792,102 @@ model* train(const problem *prob, const parameter *param)
 					for(i=0;i<w_size;i++)
 						model_->w[i] = 0;
 
-				train_one(&sub_prob, param, model_->w, weighted_C[0], weighted_C[1]);
+				train_one(sub_prob, param, model_->w, weighted_C[0], weighted_C[1], cols, &budget);
 			}
 			else
 			{
 				model_->w=Malloc(double, w_size*nr_class);
-				double *w=Malloc(double, w_size);
-				for(i=0;i<nr_class;i++)
+
+				// The threads are shared between the classes trained in
+				// parallel
+				int nr_worker = ovr_workers(param, nr_class);
+				parameter param_ovr = *param;
+				param_ovr.nr_thread = max(1, param->nr_thread / nr_worker);
+
+				run_log *logs = param->stats ? (run_log *)calloc(nr_class, sizeof(run_log)) : NULL;
+				ovr_job job = {sub_prob, &param_ovr, nr_class, data->start, data->count, weighted_C, model_->w, cols, &budget, logs};
+				parallel_run(nr_worker, train_ovr, &job);
+
+				if(logs != NULL)
 				{
-					int si = start[i];
-					int ei = si+count[i];
-
-					k=0;
-					for(; k<si; k++)
-						sub_prob.y[k] = -1;
-					for(; k<ei; k++)
-						sub_prob.y[k] = +1;
-					for(; k<sub_prob.l; k++)
-						sub_prob.y[k] = -1;
-
-					if(param->init_sol != NULL)
-						for(j=0;j<w_size;j++)
-							w[j] = param->init_sol[j*nr_class+i];
-					else
-						for(j=0;j<w_size;j++)
-							w[j] = 0;
-
-					train_one(&sub_prob, param, w, weighted_C[i], param->C);
-
-					for(j=0;j<w_size;j++)
-						model_->w[j*nr_class+i] = w[j];
+					for(i=0;i<nr_class;i++)
+						append_runs(&log, &logs[i]);
+					free(logs);
 				}
-				free(w);
 			}
 
 		}
 
-		free(x);
-		free(label);
-		free(start);
-		free(count);
-		free(perm);
-		free(sub_prob.x);
-		free(sub_prob.y);
 		free(weighted_C);
 	}
+	model_->converged = budget.converged;
+	model_->stats = NULL;
+	if(param->stats)
+	{
+		model_->stats = Malloc(train_stats,1);
+		model_->stats->prepare_time = data->prepare_time;
+		model_->stats->solve_time = wall_clock() - start;
+		model_->stats->nr_run = log.nr_run;
+		model_->stats->run = log.run;
+	}
 	return model_;
 }
 
-void cross_validation(const problem *prob, const parameter *param, int nr_fold, double *target)
+//
+// Interface functions
+//
+model* train(const problem *prob, const parameter *param)
 {
-	int i;
-	int *fold_start;
-	int l = prob->l;
-	int *perm = Malloc(int,l);
-	if (nr_fold > l)
-	{
-		nr_fold = l;
-		fprintf(stderr,"WARNING: # folds > # data. Will use # folds = # data instead (i.e., leave-one-out cross validation)\n");
-	}
-	fold_start = Malloc(int,nr_fold+1);
-	for(i=0;i<l;i++) perm[i]=i;
-	for(i=0;i<l;i++)
+	train_data data;
+	init_train_data(prob, param, &data);
+	model *model_ = train_prepared(&data, param);
+	free_train_data(&data);
+	return model_;
+}
+
+// Train models for a sequence of C values
+//
+// The grouped (and transposed) problem is prepared once for all of them
+// (the first model's stats report the time). The primal solvers supporting
+// an initial solution start each C from the solution of the previous one,
+// so C should be ascending.
+void train_path(const problem *prob, const parameter *param, int nr_C, const double *C, model **models)
+{
+	train_data data;
+	parameter param_C = *param;
+	bool warm_start = (param->solver_type == L2R_LR
+		|| param->solver_type == L2R_L2LOSS_SVC
+		|| param->solver_type == L2R_L2LOSS_SVR);
+
+	init_train_data(prob, param, &data);
+	for(int i=0;i<nr_C;i++)
 	{
-		int j = i+rand()%(l-i);
-		swap(perm[i],perm[j]);
+		param_C.C = C[i];
+		if(warm_start && i > 0)
+			param_C.init_sol = models[i-1]->w;
+		models[i] = train_prepared(&data, &param_C);
+		models[i]->param.init_sol = NULL;
+		data.prepare_time = 0;
 	}
-	for(i=0;i<=nr_fold;i++)
-		fold_start[i]=i*l/nr_fold;
+	free_train_data(&data);
+}
 
-	for(i=0;i<nr_fold;i++)
+void cross_validation(const problem *prob, const parameter *param, int nr_fold, double *target)
+{
+	if (nr_fold > prob->l)
 	{
-		int begin = fold_start[i];
-		int end = fold_start[i+1];
-		int j,k;
-		struct problem subprob;
+		nr_fold = prob->l;
+		fprintf(stderr,"WARNING: # folds > # data. Will use # folds = # data instead (i.e., leave-one-out cross validation)\n");
+	}
+	cv_folds folds;
+	init_folds(&folds, prob, param, nr_fold);
 
-		subprob.bias = prob->bias;
-		subprob.n = prob->n;
-		subprob.l = l-(end-begin);
-		subprob.x = Malloc(struct feature_node*,subprob.l);
-		subprob.y = Malloc(double,subprob.l);
+	parameter param_fold;
+	int nr_worker = fold_workers(param, nr_fold, &param_fold);
+	fold_job job = {prob, &param_fold, &folds, NULL, 0, NULL, target};
+	parallel_run(nr_worker, train_folds, &job);
 
-		k=0;
-		for(j=0;j<begin;j++)
-		{
-			subprob.x[k] = prob->x[perm[j]];
-			subprob.y[k] = prob->y[perm[j]];
-			++k;
-		}
-		for(j=end;j<l;j++)
-		{
-			subprob.x[k] = prob->x[perm[j]];
-			subprob.y[k] = prob->y[perm[j]];
-			++k;
-		}
-		struct model *submodel = train(&subprob,param);
-		for(j=begin;j<end;j++)
-			target[perm[j]] = predict(submodel,prob->x[perm[j]]);
-		free_and_destroy_model(&submodel);
-		free(subprob.x);
-		free(subprob.y);
-	}
-	free(fold_start);
-	free(perm);
+	free_folds(&folds);
 }
 
 
@@ -3153,52 +4896,13 @@ void find_parameters(const problem *prob, const parameter *param, int nr_fold, d
 	// prepare CV folds
 
 	int i;
-	int *fold_start;
-	int l = prob->l;
-	int *perm = Malloc(int, l);
-	struct problem *subprob = Malloc(problem,nr_fold);
-
-	if (nr_fold > l)
+	if (nr_fold > prob->l)
 	{
-		nr_fold = l;
+		nr_fold = prob->l;
 		fprintf(stderr,"WARNING: # folds > # data. Will use # folds = # data instead (i.e., leave-one-out cross validation)\n");
 	}
-	fold_start = Malloc(int,nr_fold+1);
-	for(i=0;i<l;i++) perm[i]=i;
-	for(i=0;i<l;i++)
-	{
-		int j = i+rand()%(l-i);
-		swap(perm[i],perm[j]);
-	}
-	for(i=0;i<=nr_fold;i++)
-		fold_start[i]=i*l/nr_fold;
-
-	for(i=0;i<nr_fold;i++)
-	{
-		int begin = fold_start[i];
-		int end = fold_start[i+1];
-		int j,k;
-
-		subprob[i].bias = prob->bias;
-		subprob[i].n = prob->n;
-		subprob[i].l = l-(end-begin);
-		subprob[i].x = Malloc(struct feature_node*,subprob[i].l);
-		subprob[i].y = Malloc(double,subprob[i].l);
-
-		k=0;
-		for(j=0;j<begin;j++)
-		{
-			subprob[i].x[k] = prob->x[perm[j]];
-			subprob[i].y[k] = prob->y[perm[j]];
-			++k;
-		}
-		for(j=end;j<l;j++)
-		{
-			subprob[i].x[k] = prob->x[perm[j]];
-			subprob[i].y[k] = prob->y[perm[j]];
-			++k;
-		}
-	}
+	cv_folds folds;
+	init_folds(&folds, prob, param, nr_fold);
 
 	struct parameter param_tmp = *param;
 	*best_p = -1;
@@ -3210,7 +4914,7 @@ void find_parameters(const problem *prob, const parameter *param, int nr_fold, d
 		start_C = min(start_C, max_C);
 		double best_C_tmp, best_score_tmp;
 
-		find_parameter_C(prob, &param_tmp, start_C, max_C, &best_C_tmp, &best_score_tmp, fold_start, perm, subprob, nr_fold);
+		find_parameter_C(prob, &param_tmp, start_C, max_C, &best_C_tmp, &best_score_tmp, &folds);
 
 		*best_C = best_C_tmp;
 		*best_score = best_score_tmp;
@@ -3236,7 +4940,7 @@ void find_parameters(const problem *prob, const parameter *param, int nr_fold, d
 			start_C_tmp = min(start_C_tmp, max_C);
 			double best_C_tmp, best_score_tmp;
 
-			find_parameter_C(prob, &param_tmp, start_C_tmp, max_C, &best_C_tmp, &best_score_tmp, fold_start, perm, subprob, nr_fold);
+			find_parameter_C(prob, &param_tmp, start_C_tmp, max_C, &best_C_tmp, &best_score_tmp, &folds);
 
 			if(best_score_tmp < *best_score)
 			{
@@ -3247,14 +4951,7 @@ void find_parameters(const problem *prob, const parameter *param, int nr_fold, d
 		}
 	}
 
-	free(fold_start);
-	free(perm);
-	for(i=0; i<nr_fold; i++)
-	{
-		free(subprob[i].x);
-		free(subprob[i].y);
-	}
-	free(subprob);
+	free_folds(&folds);
 }
 
 double predict_values(const struct model *model_, const struct feature_node *x, double *dec_values)
@@ -3464,8 +5161,12 @@ struct model *load_model(const char *model_file_name)
 	param.weight_label = NULL;
 	param.weight = NULL;
 	param.init_sol = NULL;
+	param.cancel = NULL;
+	param.stats = 0;
 
 	model_->label = NULL;
+	model_->converged = 1;
+	model_->stats = NULL;
 
 	char *old_locale = setlocale(LC_ALL, NULL);
 	if (old_locale)
@@ -3649,6 +5350,14 @@ void free_model_content(struct model *model_ptr)
 	model_ptr->w = NULL;
 	free(model_ptr->label);
 	model_ptr->label = NULL;
+	if(model_ptr->stats != NULL)
+	{
+		for(int i=0;i<model_ptr->stats->nr_run;i++)
+			free(model_ptr->stats->run[i].iter);
+		free(model_ptr->stats->run);
+		free(model_ptr->stats);
+		model_ptr->stats = NULL;
+	}
 }
 
 void free_and_destroy_model(struct model **model_ptr_ptr)
@@ -3748,3 +5457,8 @@ void set_print_string_function(void (*print_func)(const char*))
 		liblinear_print_string = print_func;
 }
 
+void set_parallel_run_function(void (*run_func)(int, void (*)(void *, int, int), void *))
+{
+	liblinear_parallel_run = run_func;
+}
+
@@ -1,6 +1,8 @@
 #ifndef _LIBLINEAR_H
 #define _LIBLINEAR_H
 
+#include <stdint.h>
+
 #define LIBLINEAR_VERSION 247
 
 #ifdef __cplusplus
@@ -21,6 +23,25 @@ struct problem
 	double *y;
 	struct feature_node **x;
 	double bias;            /* < 0 if no bias term */
+
+	/*
+	 * Optional structure-of-arrays copy of x, used by the dual coordinate
+	 * descent and primal newton solvers (see check_csr_solver(); NULL:
+	 * built by train()). Row i starts at csr_index + csr_start[i] and
+	 * csr_value + csr_start[i] and ends with index -1. csr_index must be
+	 * readable for 3 more entries behind the end of the last row.
+	 */
+	const int *csr_index;
+	const double *csr_value;
+	const int64_t *csr_start;
+
+	/*
+	 * Optional transposed x, used by the L1R solvers (NULL: built by
+	 * train()). Column j holds the features j+1 of all rows as (row
+	 * number starting from 1, value) nodes, in the order of x, and ends
+	 * with index -1. The solvers don't modify it.
+	 */
+	struct feature_node **col_x;
 };
 
 enum { L2R_LR, L2R_L2LOSS_SVC_DUAL, L2R_L2LOSS_SVC, L2R_L1LOSS_SVC_DUAL, MCSVM_CS, L1R_L2LOSS_SVC, L1R_LR, L2R_LR_DUAL, L2R_L2LOSS_SVR = 11, L2R_L2LOSS_SVR_DUAL, L2R_L1LOSS_SVR_DUAL, ONECLASS_SVM = 21 }; /* solver_type */
@@ -39,6 +60,51 @@ struct parameter
 	double nu;
 	double *init_sol;
 	int regularize_bias;
+	int nr_thread;          /* threads for the primal newton solvers */
+	uint64_t seed;          /* seed of the solvers' random numbers */
+	int hogwild;            /* parallel coordinate descent (dual and L1R) */
+	int max_iter;           /* outer iterations per solver run (0: default) */
+	double time_limit;      /* seconds per model (0: no limit) */
+	volatile int *cancel;   /* stop training once *cancel != 0 (or NULL) */
+	int stats;              /* record the training into model::stats */
+};
+
+/*
+ * Telemetry of a training (see parameter::stats). Times are wall clock
+ * seconds. Values a solver doesn't know are NaN (double) or -1 (int).
+ */
+struct train_iter_stats
+{
+	int iter;               /* outer iteration (0: starting point) */
+	double time;            /* since the start of the run */
+	double f;               /* objective value (primal newton solvers) */
+	double violation;       /* gradient norm (newton) or stopping measure */
+	double step_size;       /* line search step (newton, L1R_LR) */
+	int inner_iter;         /* CG steps (newton) or inner iterations */
+	int line_search;        /* function evaluations of the line search */
+	int active_size;        /* variables left after shrinking */
+};
+
+struct train_run_stats
+{
+	int solver_type;        /* differs from the parameter's after a fallback */
+	int cls;                /* one-vs-rest class (index into label) or -1 */
+	double time;
+	double objective;       /* final objective value */
+	double Xv_time;         /* in X v products (primal newton solvers) */
+	double XTv_time;        /* in X^T v products */
+	double Hv_time;         /* in Hessian-vector products */
+	int nr_Xv, nr_XTv, nr_Hv;
+	int nr_iter;
+	struct train_iter_stats *iter;
+};
+
+struct train_stats
+{
+	double prepare_time;    /* grouping, copying and transposing the rows */
+	double solve_time;      /* running the solvers */
+	int nr_run;             /* solver runs, by class */
+	struct train_run_stats *run;
 };
 
 struct model
@@ -50,9 +116,12 @@ struct model
 	int *label;             /* label of each class */
 	double bias;
 	double rho;             /* one-class SVM only */
+	int converged;          /* 0 if a solver stopped early (see parameter) */
+	struct train_stats *stats; /* NULL unless trained with parameter::stats */
 };
 
 struct model* train(const struct problem *prob, const struct parameter *param);
+void train_path(const struct problem *prob, const struct parameter *param, int nr_C, const double *C, struct model **models);
 void cross_validation(const struct problem *prob, const struct parameter *param, int nr_fold, double *target);
 void find_parameters(const struct problem *prob, const struct parameter *param, int nr_fold, double start_C, double start_p, double *best_C, double *best_p, double *best_score);
 
@@ -78,7 +147,9 @@ const char *check_parameter(const struct problem *prob, const struct parameter *
 int check_probability_model(const struct model *model);
 int check_regression_model(const struct model *model);
 int check_oneclass_model(const struct model *model);
+int check_csr_solver(const struct parameter *param);
 void set_print_string_function(void (*print_func) (const char*));
+void set_parallel_run_function(void (*run_func) (int, void (*) (void *, int, int), void *));
 
 #ifdef __cplusplus
 }
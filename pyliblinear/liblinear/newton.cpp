@@ -57,6 +57,7 @@ double function::linesearch_and_update(double *w, double *s, double *f, double *
 			alpha *= 0.5;
 	}
 
+	nr_linesearch = min(num_linesearch+1, max_num_linesearch);
 	if (num_linesearch >= max_num_linesearch)
 	{
 		*f = fold;
@@ -86,13 +87,18 @@ NEWTON::NEWTON(const function *fun_obj, double eps, double eps_cg, int max_iter)
 	this->eps_cg=eps_cg;
 	this->max_iter=max_iter;
 	newton_print_string = default_print;
+	stop = NULL;
+	stop_arg = NULL;
+	report = NULL;
+	report_arg = NULL;
 }
 
 NEWTON::~NEWTON()
 {
 }
 
-void NEWTON::newton(double *w)
+// Return false if stopped before convergence (iteration limit or stop)
+bool NEWTON::newton(double *w)
 {
 	int n = fun_obj->get_nr_variable();
 	int i, cg_iter;
@@ -100,6 +106,7 @@ void NEWTON::newton(double *w)
 	double f, fold, actred;
 	double init_step_size = 1;
 	int search = 1, iter = 1, inc = 1;
+	bool stopped = false;
 	double *s = new double[n];
 	double *r = new double[n];
 	double *g = new double[n];
@@ -120,12 +127,24 @@ void NEWTON::newton(double *w)
 	fun_obj->grad(w, g);
 	double gnorm = dnrm2_(&n, g, &inc);
 	info("init f %5.3e |g| %5.3e\n", f, gnorm);
+	if (report != NULL)
+	{
+		newton_report r = {0, f, gnorm, 0, 0, 0};
+		report(report_arg, &r);
+	}
 
 	if (gnorm <= eps*gnorm0)
 		search = 0;
 
 	while (iter <= max_iter && search)
 	{
+		if (stop != NULL && stop(stop_arg))
+		{
+			info("WARNING: stopped\n");
+			stopped = true;
+			break;
+		}
+
 		fun_obj->get_diag_preconditioner(M);
 		for(i=0; i<n; i++)
 			M[i] = (1-alpha_pcg) + alpha_pcg*M[i];
@@ -144,6 +163,11 @@ void NEWTON::newton(double *w)
 		gnorm = dnrm2_(&n, g, &inc);
 
 		info("iter %2d f %5.3e |g| %5.3e CG %3d step_size %4.2e \n", iter, f, gnorm, cg_iter, step_size);
+		if (report != NULL)
+		{
+			newton_report r = {iter, f, gnorm, step_size, cg_iter, fun_obj->nr_linesearch};
+			report(report_arg, &r);
+		}
 		
 		if (gnorm <= eps*gnorm0)
 			break;
@@ -169,6 +193,8 @@ void NEWTON::newton(double *w)
 	delete[] r;
 	delete[] s;
 	delete[] M;
+
+	return !stopped && iter <= max_iter;
 }
 
 int NEWTON::pcg(double *g, double *M, double *s, double *r)
@@ -249,3 +275,19 @@ void NEWTON::set_print_string(void (*print_string) (const char *buf))
 {
 	newton_print_string = print_string;
 }
+
+// stop(arg) is checked before each iteration. newton() returns as soon as
+// it returns true.
+void NEWTON::set_stop(bool (*stop) (void *arg), void *arg)
+{
+	this->stop = stop;
+	stop_arg = arg;
+}
+
+// report(arg, r) is called with the starting point and after each
+// iteration
+void NEWTON::set_report(void (*report) (void *arg, const newton_report *r), void *arg)
+{
+	this->report = report;
+	report_arg = arg;
+}
@@ -4,6 +4,7 @@
 class function
 {
 public:
+	function(void) : nr_linesearch(0) {}
 	virtual double fun(double *w) = 0 ;
 	virtual void grad(double *w, double *g) = 0 ;
 	virtual void Hv(double *s, double *Hs) = 0 ;
@@ -13,6 +14,20 @@ public:
 
 	// base implementation in newton.cpp
 	virtual double linesearch_and_update(double *w, double *s, double *f, double *g, double alpha);
+
+	// function evaluations of the last linesearch_and_update
+	int nr_linesearch;
+};
+
+// Progress of NEWTON::newton after an iteration (see set_report)
+struct newton_report
+{
+	int iter;               // 0: starting point
+	double f;
+	double gnorm;
+	double step_size;
+	int cg_iter;
+	int nr_linesearch;
 };
 
 class NEWTON
@@ -21,8 +36,10 @@ public:
 	NEWTON(const function *fun_obj, double eps = 0.1, double eps_cg = 0.5, int max_iter = 1000);
 	~NEWTON();
 
-	void newton(double *w);
+	bool newton(double *w);
 	void set_print_string(void (*i_print) (const char *buf));
+	void set_stop(bool (*stop) (void *arg), void *arg);
+	void set_report(void (*report) (void *arg, const newton_report *r), void *arg);
 
 private:
 	int pcg(double *g, double *M, double *s, double *r);
@@ -33,5 +50,9 @@ private:
 	function *fun_obj;
 	void info(const char *fmt,...);
 	void (*newton_print_string)(const char *buf);
+	bool (*stop)(void *arg);
+	void *stop_arg;
+	void (*report)(void *arg, const newton_report *r);
+	void *report_arg;
 };
 #endif
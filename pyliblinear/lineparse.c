@@ -0,0 +1,334 @@
+/*
+ * Copyright 2015 - 2025
+ * Andr\xe9 Malo or his licensors, as applicable
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pyliblinear.h"
+
+
+/* Minimum number of bytes per thread */
+#define PL_LINEPARSE_CHUNK_MIN ((Py_ssize_t)1 << 16)
+
+#define PL_LINEPARSE_IS_SEP(c) ((c) == ' ' || (c) == '\t' || (c) == '\0')
+#define PL_LINEPARSE_IS_EOL(c) ((c) == '\n' || (c) == '\r')
+#define PL_LINEPARSE_IS_DIGIT(c) ((c) >= '0' && (c) <= '9')
+
+
+/*
+ * Chunk of lines, parsed by a single thread
+ *
+ * The chunk's memory is allocated using the plain C allocator, because the
+ * threads are running without the GIL.
+ */
+typedef struct {
+    const char *start;
+    const char *end;
+
+    struct feature_node *nodes;  /* The features of all rows */
+    size_t nodes_size;
+    size_t nodes_alloc;
+
+    size_t *rows;                /* Start offset of each row in nodes */
+    size_t rows_size;
+    size_t rows_alloc;
+
+    int *labels;                 /* Label of each row */
+    size_t labels_alloc;
+
+    int failed;
+} pl_lineparse_chunk_t;
+
+
+/*
+ * Grow an array if needed
+ *
+ * Return -1 on error
+ */
+static int
+pl_lineparse_grow(void **array_, size_t *alloc_, size_t size, size_t itemsize)
+{
+    void *array;
+    size_t alloc;
+
+    if (size < *alloc_)
+        return 0;
+
+    alloc = *alloc_ ? *alloc_ * 2 : (PL_BLOCK_LENGTH / itemsize);
+    if (alloc < *alloc_ || alloc > ((size_t)-1) / itemsize)
+        return -1;
+
+    if (!(array = realloc(*array_, alloc * itemsize)))
+        return -1;
+
+    *array_ = array;
+    *alloc_ = alloc;
+    return 0;
+}
+
+
+/*
+ * Parse a feature index including the colon
+ *
+ * Return -1 on error
+ */
+static int
+pl_lineparse_index(const char **start_, const char *end, int *result)
+{
+    const char *c = *start_;
+    long index = 0;
+
+    if (c < end && *c == '+')
+        ++c;
+    if (!(c < end && PL_LINEPARSE_IS_DIGIT(*c)))
+        return -1;
+
+    for (; c < end && PL_LINEPARSE_IS_DIGIT(*c); ++c) {
+        index = index * 10 + (*c - '0');
+        if (index > (long)INT_MAX)
+            return -1;
+    }
+    if (!(c < end && *c == ':') || index <= 0)
+        return -1;
+
+    *start_ = c + 1;
+    *result = (int)index;
+    return 0;
+}
+
+
+/*
+ * Find the end of the token starting at c
+ *
+ * Return NULL if the token contains a \0 byte
+ */
+static const char *
+pl_lineparse_tok(const char *c, const char *end)
+{
+    if ((c = pl_scan_delim(c, end)) < end && !*c)
+        return NULL;
+
+    return c;
+}
+
+
+/*
+ * Parse a chunk of lines
+ *
+ * Runs without the GIL. Any error (or any input out of the ordinary) marks
+ * the chunk as failed.
+ */
+static void
+pl_lineparse_chunk(pl_lineparse_chunk_t *chunk)
+{
+    struct feature_node *node;
+    const char *c = chunk->start, *end = chunk->end, *t;
+    double value;
+    int index;
+
+    while (1) {
+        while (c < end && PL_LINEPARSE_IS_SEP(*c))
+            ++c;
+        if (!(c < end))
+            break;
+        if (PL_LINEPARSE_IS_EOL(*c))
+            goto error;
+
+        /* Label */
+        if (!(t = pl_lineparse_tok(c, end)))
+            goto error;
+        if (pl_parse_double(c, t, &value) == -1)
+            goto error;
+        if (!(value > ((double)INT_MIN - 1.0)
+              && value < ((double)INT_MAX + 1.0)))
+            goto error;
+
+        if (-1 == pl_lineparse_grow((void **)&chunk->rows, &chunk->rows_alloc,
+                                    chunk->rows_size, sizeof *chunk->rows))
+            goto error;
+        if (-1 == pl_lineparse_grow((void **)&chunk->labels,
+                                    &chunk->labels_alloc, chunk->rows_size,
+                                    sizeof *chunk->labels))
+            goto error;
+        chunk->rows[chunk->rows_size] = chunk->nodes_size;
+        chunk->labels[chunk->rows_size++] = (int)value;
+        c = t;
+
+        /* Features */
+        while (1) {
+            while (c < end && PL_LINEPARSE_IS_SEP(*c))
+                ++c;
+            if (!(c < end))
+                break;
+            if (*c == '\n') {
+                ++c;
+                break;
+            }
+            if (*c == '\r') {
+                if (++c < end && *c == '\n')
+                    ++c;
+                break;
+            }
+
+            if (!(t = pl_lineparse_tok(c, end)))
+                goto error;
+            if (pl_lineparse_index(&c, t, &index) == -1)
+                goto error;
+            if (pl_parse_double(c, t, &value) == -1)
+                goto error;
+            c = t;
+
+            if (value == 0.0)
+                continue;
+
+            if (-1 == pl_lineparse_grow((void **)&chunk->nodes,
+                                        &chunk->nodes_alloc,
+                                        chunk->nodes_size,
+                                        sizeof *chunk->nodes))
+                goto error;
+            node = &chunk->nodes[chunk->nodes_size++];
+            node->index = index;
+            node->value = value;
+        }
+    }
+
+    if (chunk->rows_size) {
+        if (-1 == pl_lineparse_grow((void **)&chunk->rows, &chunk->rows_alloc,
+                                    chunk->rows_size, sizeof *chunk->rows))
+            goto error;
+        chunk->rows[chunk->rows_size] = chunk->nodes_size;
+    }
+    return;
+
+error:
+    chunk->failed = 1;
+}
+
+
+/*
+ * Parse chunk number j (see pl_parallel_run)
+ */
+static void
+pl_lineparse_worker(void *chunks, int j, int threads)
+{
+    pl_lineparse_chunk(&((pl_lineparse_chunk_t *)chunks)[j]);
+}
+
+
+/*
+ * Collect the parsed chunks in the arena
+ *
+ * Return -1 on error
+ * Return 0 on success
+ * Return 1 if the result needs to be created by the token reader
+ */
+static int
+pl_lineparse_vectors(pl_lineparse_chunk_t *chunks, int no_chunks,
+                     pl_arena_t *arena)
+{
+    size_t height = 0, nodes = 0, k;
+    int j;
+
+    for (j = 0; j < no_chunks; ++j) {
+        height += chunks[j].rows_size;
+        nodes += chunks[j].nodes_size;
+    }
+    if (!height || !(height < (size_t)(INT_MAX - 1)))
+        return 1;
+
+    /* plus one bias node plus one sentinel per row */
+    if (pl_arena_reserve(arena, height, nodes + 2 * height) == -1)
+        return -1;
+
+    for (j = 0; j < no_chunks; ++j) {
+        for (k = 0; k < chunks[j].rows_size; ++k) {
+            if (-1 == pl_arena_row_copy(arena, (double)chunks[j].labels[k],
+                                        chunks[j].nodes + chunks[j].rows[k],
+                                        chunks[j].rows[k + 1]
+                                        - chunks[j].rows[k]))
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/*
+ * Parse a libsvm formatted buffer using multiple threads
+ *
+ * The buffer is split into line aligned chunks, which are parsed in parallel
+ * with the GIL released. The vectors are created as if they were loaded by
+ * the token reader.
+ *
+ * Return -1 on error
+ * Return 0 on success
+ * Return 1 if the buffer needs to be parsed by the token reader (not worth
+ * threading, invalid or unusual input)
+ */
+int
+pl_lineparse(const char *data, Py_ssize_t size, int threads,
+             pl_arena_t *arena)
+{
+    pl_lineparse_chunk_t *chunks;
+    const char *c, *t, *end = data + size;
+    int j, res = 1;
+
+    if (threads > size / PL_LINEPARSE_CHUNK_MIN)
+        threads = (int)(size / PL_LINEPARSE_CHUNK_MIN);
+    if (threads < 2)
+        return 1;
+
+    if (!(chunks = PyMem_Malloc(((size_t)threads) * (sizeof *chunks)))) {
+        PyErr_SetNone(PyExc_MemoryError);
+        return -1;
+    }
+    (void)memset(chunks, 0, ((size_t)threads) * (sizeof *chunks));
+
+    for (c = data, j = 0; j < threads; ++j) {
+        chunks[j].start = c;
+        if (j == threads - 1) {
+            c = end;
+        }
+        else {
+            t = data + (size / threads) * (j + 1);
+            if (t < c)
+                t = c;
+            while (t < end && !PL_LINEPARSE_IS_EOL(*t))
+                ++t;
+            if (t < end && *t++ == '\r' && t < end && *t == '\n')
+                ++t;
+            c = t;
+        }
+        chunks[j].end = c;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    pl_parallel_run(threads, pl_lineparse_worker, chunks);
+    Py_END_ALLOW_THREADS
+
+    for (j = 0; j < threads && !chunks[j].failed; ++j)
+        ;
+    if (!(j < threads))
+        res = pl_lineparse_vectors(chunks, threads, arena);
+
+    for (j = 0; j < threads; ++j) {
+        free(chunks[j].nodes);
+        free(chunks[j].rows);
+        free(chunks[j].labels);
+    }
+    PyMem_Free(chunks);
+
+    return res;
+}
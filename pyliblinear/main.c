@@ -70,6 +70,8 @@ EXT_INIT_FUNC {
     PyObject *m, *solvers;
 
     set_print_string_function(pl_null_print);
+    set_parallel_run_function(pl_parallel_run);
+    pl_scan_init();
 
     /* Create the module and populate stuff */
     if (!(m = EXT_CREATE(&EXT_DEFINE_VAR)))
@@ -84,8 +86,6 @@ EXT_INIT_FUNC {
     EXT_INIT_TYPE(m, &PL_FeatureViewType);
     EXT_INIT_TYPE(m, &PL_LabelViewType);
     EXT_INIT_TYPE(m, &PL_ZipperType);
-    EXT_INIT_TYPE(m, &PL_VectorReaderType);
-    EXT_INIT_TYPE(m, &PL_MatrixReaderType);
     EXT_INIT_TYPE(m, &PL_FeatureMatrixType);
     EXT_ADD_TYPE(m, "FeatureMatrix", &PL_FeatureMatrixType);
 
@@ -96,6 +96,9 @@ EXT_INIT_FUNC {
     EXT_INIT_TYPE(m, &PL_ModelType);
     EXT_ADD_TYPE(m, "Model", &PL_ModelType);
 
+    EXT_INIT_TYPE(m, &PL_CancelType);
+    EXT_ADD_TYPE(m, "Cancel", &PL_CancelType);
+
 #if (PL_TEST == 1)
     EXT_INIT_TYPE(m, &PL_TokReaderType);
     EXT_ADD_TYPE(m, "TokReader", &PL_TokReaderType);
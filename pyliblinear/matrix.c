@@ -17,33 +17,7 @@
 
 #include "pyliblinear.h"
 
-#ifdef PL_CROSS_VALIDATE
-#undef PL_CROSS_VALIDATE
-#endif
-
-
-/*
- * Single feature vector
- */
-typedef struct pl_vector {
-    struct feature_node *array;
-    int array_size;
-
-    int label;
-} pl_vector_t;
-
-/* Number of vectors per block */
-#define PL_VECTOR_BLOCK_SIZE \
-    ((size_t)((PL_BLOCK_LENGTH) / sizeof(pl_vector_t)))
 
-typedef struct pl_vector_block {
-    struct pl_vector_block *prev;
-    size_t size;
-    pl_vector_t vector[PL_VECTOR_BLOCK_SIZE];
-} pl_vector_block_t;
-
-
-#ifdef PL_CROSS_VALIDATE
 /*
  * Evaluation result
  */
@@ -52,7 +26,25 @@ typedef struct {
     double mse;  /* Mean squared error */
     double scc;  /* Squared correlation coefficient */
 } pl_eval_t;
-#endif
+
+
+/*
+ * Transposition of the vectors, split by rows between the threads
+ *
+ * Pass 0 counts the features of each column in the thread's rows, pass 1
+ * writes them at the column positions prepared from the counts.
+ */
+typedef struct {
+    const struct feature_node *const *vectors;
+    struct feature_node *col_nodes;
+    size_t *offset;              /* <threads> * <width> counts/positions */
+    int width;
+    int height;
+    int pass;
+} pl_matrix_cols_t;
+
+/* Minimum number of rows per thread transposing the vectors */
+#define PL_MATRIX_COLS_ROWS_MIN (4096)
 
 
 /*
@@ -64,16 +56,58 @@ typedef struct {
 
     struct feature_node **vectors; /* <height> vectors */
     struct feature_node **biased_vectors; /* <height> biased vectors or NULL */
+    double bias;                   /* Bias stored in the bias nodes or -1 */
+    int bias_users;                /* Number of problems using the bias
+                                      nodes */
     double *labels;                /* <height> labels */
     int width;                     /* Max feature index */
     int height;                    /* Number of vectors/labels */
 
-    int row_alloc;                 /* was .vectors allocated per vector or
-                                      as a whole?. If true, it was allocated
-                                      per vector */
+    int *csr_index;                /* Structure-of-arrays copy of the */
+    double *csr_value;             /* vectors or NULL (see pl_matrix_csr) */
+    int64_t *csr_start;            /* <height> offsets of the bias slots */
+
+    struct feature_node **cols;    /* <width> + 1 transposed vectors (the
+                                      last one is the bias column) or NULL
+                                      (see pl_matrix_cols) */
+    struct feature_node *col_nodes; /* All nodes the columns point into */
+
+    struct feature_node *nodes;    /* All nodes the vectors point into or
+                                      NULL (see map) */
+    PyObject *map;                 /* Mapped file the vectors point into or
+                                      NULL */
 } pl_matrix_t;
 
 
+/*
+ * Header of the binary matrix format
+ *
+ * The header is followed by the labels (<height> doubles), the row offsets
+ * (<height> + 1 uint64s, counted in nodes) and the nodes (the feature_node
+ * arrays including the bias node and the sentinel per row). All sections
+ * are stored in native byte order and layout. The nodes section is aligned
+ * so it can be used in place when the file is mapped into memory.
+ */
+typedef struct {
+    char magic[8];               /* PL_MATRIX_BINARY_MAGIC */
+    PY_UINT32_T version;         /* PL_MATRIX_BINARY_VERSION */
+    PY_UINT32_T byteorder;       /* PL_MATRIX_BINARY_BYTEORDER */
+    PY_UINT32_T node_size;       /* sizeof(struct feature_node) */
+    PY_UINT32_T value_offset;    /* offsetof(struct feature_node, value) */
+    PY_INT32_T height;           /* Number of vectors/labels */
+    PY_INT32_T width;            /* Max feature index */
+    PY_UINT64_T no_nodes;        /* Number of nodes */
+    PY_UINT64_T labels_offset;   /* File offset of the labels */
+    PY_UINT64_T offsets_offset;  /* File offset of the row offsets */
+    PY_UINT64_T nodes_offset;    /* File offset of the nodes */
+} pl_matrix_binary_t;
+
+#define PL_MATRIX_BINARY_MAGIC "PLMATRIX"
+#define PL_MATRIX_BINARY_VERSION (1)
+#define PL_MATRIX_BINARY_BYTEORDER (0x01020304UL)
+#define PL_MATRIX_BINARY_ALIGN (64)
+
+
 /*
  * Object structure for FeatureView
  */
@@ -109,50 +143,259 @@ typedef struct {
 } pl_zipper_t;
 
 
+/* Forward declarations */
+static pl_matrix_t *
+pl_matrix_new(PyTypeObject *, struct feature_node **, struct feature_node *,
+              double *, int, int);
+
+
+/* ------------------------ BEGIN Helper Functions ----------------------- */
+
 /*
- * Matrix reader states
+ * Create private biased vectors for a problem
+ *
+ * Used if the bias nodes of the matrix are in use with a different bias
+ * already. The rows are copied with the bias node set.
+ *
+ * Return -1 on error
  */
-typedef enum {
-    PL_MATRIX_READER_STATE_ROW,
-    PL_MATRIX_READER_STATE_VECTOR
-} pl_matrix_reader_state;
+static int
+pl_matrix_problem_copy(pl_matrix_t *matrix, struct problem *prob)
+{
+    struct feature_node **vectors, *nodes, *node, *source;
+    size_t no_nodes = 0;
+    int j;
+
+    for (j = 0; j < matrix->height; ++j) {
+        for (source = matrix->vectors[j]; source->index != -1; ++source)
+            ;
+        /* plus the bias node plus the sentinel */
+        no_nodes += (size_t)(source - matrix->vectors[j]) + 2;
+    }
+
+    if (!(vectors = PyMem_Malloc(((size_t)matrix->height + 1)
+                                 * (sizeof *vectors))))
+        goto error;
+    if (!(nodes = PyMem_Malloc((no_nodes + 1) * (sizeof *nodes))))
+        goto error_vectors;
+
+    for (node = nodes, j = 0; j < matrix->height; ++j) {
+        vectors[j] = node;
+        node->index = prob->n;
+        node->value = prob->bias;
+        source = matrix->vectors[j];
+        do {
+            *++node = *source;
+        } while ((source++)->index != -1);
+        ++node;
+    }
+    vectors[matrix->height] = nodes; /* for pl_matrix_problem_clear */
+
+    prob->x = vectors;
+    return 0;
+
+error_vectors:
+    PyMem_Free(vectors);
+error:
+    PyErr_SetNone(PyExc_MemoryError);
+    return -1;
+}
 
 
 /*
- * Object structure for MatrixReader
+ * Create the structure-of-arrays copy of the vectors (once)
+ *
+ * Every row is stored as bias slot, features and sentinel, like the nodes.
+ * The bias slots carry the bias of the bias nodes. The indices are padded
+ * with 3 more sentinels for the vector kernels (see struct problem).
+ *
+ * Return -1 on error
  */
-typedef struct {
-    PyObject_HEAD
+static int
+pl_matrix_csr(pl_matrix_t *matrix)
+{
+    struct feature_node *node;
+    int *index;
+    double *value;
+    int64_t *start;
+    size_t no_nodes = 0, k;
+    int j;
 
-    pl_iter_t *tokread;
-    pl_matrix_reader_state state;
-} pl_matrix_reader_t;
+    if (matrix->csr_start)
+        return 0;
+
+    for (j = 0; j < matrix->height; ++j) {
+        for (node = matrix->vectors[j]; node->index != -1; ++node)
+            ;
+        /* plus the bias slot plus the sentinel */
+        no_nodes += (size_t)(node - matrix->vectors[j]) + 2;
+    }
+
+    if (!(start = PyMem_Malloc(((size_t)matrix->height + 1)
+                               * (sizeof *start))))
+        goto error;
+    if (!(index = PyMem_Malloc((no_nodes + 3) * (sizeof *index))))
+        goto error_start;
+    if (!(value = PyMem_Malloc((no_nodes + 1) * (sizeof *value))))
+        goto error_index;
+
+    for (k = 0, j = 0; j < matrix->height; ++j) {
+        start[j] = (int64_t)k;
+        index[k] = matrix->width + 1;
+        value[k++] = matrix->bias;
+        node = matrix->vectors[j];
+        do {
+            index[k] = node->index;
+            value[k++] = node->value;
+        } while ((node++)->index != -1);
+    }
+    index[k] = index[k + 1] = index[k + 2] = -1;
+
+    matrix->csr_index = index;
+    matrix->csr_value = value;
+    matrix->csr_start = start;
+    return 0;
+
+error_index:
+    PyMem_Free(index);
+error_start:
+    PyMem_Free(start);
+error:
+    PyErr_SetNone(PyExc_MemoryError);
+    return -1;
+}
 
 
 /*
- * Object structure for VectorReader
+ * Transpose the rows of thread j (see pl_parallel_run)
  */
-typedef struct {
-    PyObject_HEAD
+static void
+pl_matrix_cols_worker(void *arg, int j, int threads)
+{
+    pl_matrix_cols_t *cols = arg;
+    const struct feature_node *node;
+    struct feature_node *target;
+    size_t *offset = cols->offset + (size_t)j * (size_t)cols->width;
+    int k, end;
+
+    k = (int)((PY_LONG_LONG)cols->height * j / threads);
+    end = (int)((PY_LONG_LONG)cols->height * (j + 1) / threads);
+    for (; k < end; ++k) {
+        node = cols->vectors[k];
+        if (!cols->pass) {
+            for (; node->index != -1; ++node)
+                ++offset[node->index - 1];
+        }
+        else {
+            for (; node->index != -1; ++node) {
+                target = &cols->col_nodes[offset[node->index - 1]++];
+                target->index = k + 1;
+                target->value = node->value;
+            }
+        }
+    }
+}
 
-    pl_matrix_reader_t *matrix_reader;
-} pl_vector_reader_t;
 
+/*
+ * Create the transposed vectors (once)
+ *
+ * Column j holds the (row number, value) nodes of feature j + 1 in row
+ * order (see struct problem), followed by the bias column, which carries
+ * the bias of the bias nodes. The rows are split between up to threads
+ * threads, which count the column lengths first and then fill in the
+ * nodes. The GIL is kept, so the columns are created only once.
+ *
+ * Return -1 on error
+ */
+static int
+pl_matrix_cols(pl_matrix_t *matrix, int threads)
+{
+    pl_matrix_cols_t job;
+    struct feature_node **cols;
+    size_t no_nodes = 0, size, count, k, *offset;
+    int j, t;
 
-/* Forward declarations */
-static pl_matrix_t *
-pl_matrix_new(PyTypeObject *, struct feature_node **, double *, int, int, int);
+    if (matrix->cols)
+        return 0;
 
+    if (threads > matrix->height / PL_MATRIX_COLS_ROWS_MIN)
+        threads = matrix->height / PL_MATRIX_COLS_ROWS_MIN;
+    if (threads < 1)
+        threads = 1;
+    size = (size_t)threads * (size_t)matrix->width;
+
+    if (!(cols = PyMem_Malloc(((size_t)matrix->width + 1) * (sizeof *cols))))
+        goto error;
+    if (!(job.offset = PyMem_Malloc((size + 1) * (sizeof *job.offset))))
+        goto error_cols;
+    (void)memset(job.offset, 0, size * (sizeof *job.offset));
+
+    job.vectors = (const struct feature_node *const *)matrix->vectors;
+    job.col_nodes = NULL;
+    job.width = matrix->width;
+    job.height = matrix->height;
+    job.pass = 0;
+    pl_parallel_run(threads, pl_matrix_cols_worker, &job);
+
+    for (k = 0; k < size; ++k)
+        no_nodes += job.offset[k];
+
+    /* plus one sentinel per column plus the bias column */
+    no_nodes += (size_t)matrix->width + (size_t)matrix->height + 1;
+    if (!(job.col_nodes = PyMem_Malloc(no_nodes * (sizeof *job.col_nodes))))
+        goto error_offset;
+
+    /* Column j: the features of thread 0, 1, ... and the sentinel */
+    for (k = 0, j = 0; j < matrix->width; ++j) {
+        cols[j] = job.col_nodes + k;
+        for (t = 0; t < threads; ++t) {
+            offset = &job.offset[(size_t)t * (size_t)matrix->width
+                                 + (size_t)j];
+            count = *offset;
+            *offset = k;
+            k += count;
+        }
+        job.col_nodes[k++].index = -1;
+    }
+    cols[matrix->width] = job.col_nodes + k;
+    for (j = 0; j < matrix->height; ++j, ++k) {
+        job.col_nodes[k].index = j + 1;
+        job.col_nodes[k].value = matrix->bias;
+    }
+    job.col_nodes[k].index = -1;
+
+    job.pass = 1;
+    pl_parallel_run(threads, pl_matrix_cols_worker, &job);
+    PyMem_Free(job.offset);
+
+    matrix->cols = cols;
+    matrix->col_nodes = job.col_nodes;
+    return 0;
+
+error_offset:
+    PyMem_Free(job.offset);
+error_cols:
+    PyMem_Free(cols);
+error:
+    PyErr_SetNone(PyExc_MemoryError);
+    return -1;
+}
 
-/* ------------------------ BEGIN Helper Functions ----------------------- */
 
 /*
  * Transform pl_matrix_t into a (liblinear) struct problem
  *
+ * The problem shares the vectors with the matrix and can be used without
+ * the GIL, but needs to be released with pl_matrix_problem_clear(). If csr
+ * is true, the problem also gets the structure-of-arrays layout used by
+ * most solvers. It's created once and kept with the matrix.
+ *
  * Return -1 on error
  */
 int
-pl_matrix_as_problem(PyObject *self, double bias, struct problem *prob)
+pl_matrix_as_problem(PyObject *self, double bias, int csr,
+                     struct problem *prob)
 {
     pl_matrix_t *matrix;
     struct feature_node *node;
@@ -167,12 +410,25 @@ pl_matrix_as_problem(PyObject *self, double bias, struct problem *prob)
     }
     matrix = (pl_matrix_t *)self;
 
+    if (csr && pl_matrix_csr(matrix) == -1)
+        return -1;
+
     prob->l = matrix->height;
     prob->n = matrix->width;
     prob->y = matrix->labels;
     prob->bias = bias;
+    prob->csr_index = NULL;
+    prob->csr_value = NULL;
+    prob->csr_start = NULL;
+    prob->col_x = NULL;
     if (bias < 0) {
         prob->x = matrix->vectors;
+        if (csr) {
+            /* skip the bias slots */
+            prob->csr_index = matrix->csr_index + 1;
+            prob->csr_value = matrix->csr_value + 1;
+            prob->csr_start = matrix->csr_start;
+        }
     }
     else {
         if (!matrix->biased_vectors) {
@@ -188,12 +444,39 @@ pl_matrix_as_problem(PyObject *self, double bias, struct problem *prob)
             }
         }
         ++prob->n;
-        for (j = matrix->height; j > 0; ) {
-            node = matrix->biased_vectors[--j];
-            node->index = prob->n;
-            node->value = bias;
+
+        /*
+         * The bias nodes are shared. They may only be rewritten if nobody
+         * else (possibly training in another thread) is looking at them.
+         */
+        if (matrix->bias_users && matrix->bias != bias)
+            return pl_matrix_problem_copy(matrix, prob);
+
+        if (matrix->bias != bias) {
+            for (j = matrix->height; j > 0; ) {
+                node = matrix->biased_vectors[--j];
+                node->index = prob->n;
+                node->value = bias;
+            }
+            /* The slot indices are always width + 1 */
+            if (matrix->csr_start) {
+                for (j = matrix->height; j > 0; )
+                    matrix->csr_value[matrix->csr_start[--j]] = bias;
+            }
+            if (matrix->cols) {
+                for (node = matrix->cols[matrix->width]; node->index != -1;
+                     ++node)
+                    node->value = bias;
+            }
+            matrix->bias = bias;
         }
+        ++matrix->bias_users;
         prob->x = matrix->biased_vectors;
+        if (csr) {
+            prob->csr_index = matrix->csr_index;
+            prob->csr_value = matrix->csr_value;
+            prob->csr_start = matrix->csr_start;
+        }
     }
 
     return 0;
@@ -201,134 +484,122 @@ pl_matrix_as_problem(PyObject *self, double bias, struct problem *prob)
 
 
 /*
- * Clear all feature vector blocks
+ * Attach the transposed vectors to a problem created by
+ * pl_matrix_as_problem()
+ *
+ * The columns are created once (by up to threads threads) and kept with the
+ * matrix. A problem with private biased vectors (see
+ * pl_matrix_problem_copy) gets a private bias column as well.
+ *
+ * Return -1 on error
  */
-static void
-pl_vector_block_clear(pl_vector_block_t **vectors_)
+int
+pl_matrix_problem_cols(PyObject *self, int threads, struct problem *prob)
 {
-    pl_vector_block_t *block;
-    pl_vector_t *vector;
-    void *ptr;
+    pl_matrix_t *matrix = (pl_matrix_t *)self;
+    struct feature_node **cols, *node;
+    int j;
 
-    while ((block = *vectors_)) {
-        *vectors_ = block->prev;
-        while (block->size > 0) {
-            vector = &block->vector[--block->size];
-            if ((ptr = vector->array)) {
-                vector->array = NULL;
-                PyMem_Free(ptr);
-            }
-        }
-        PyMem_Free(block);
+    if (pl_matrix_cols(matrix, threads) == -1)
+        return -1;
+
+    if (prob->bias < 0 || prob->x == matrix->biased_vectors) {
+        prob->col_x = matrix->cols;
+        return 0;
+    }
+
+    /* The column pointers, followed by the bias column */
+    if (!(cols = PyMem_Malloc(((size_t)matrix->width + 1) * (sizeof *cols)
+                              + ((size_t)matrix->height + 1)
+                                * (sizeof *node)))) {
+        PyErr_SetNone(PyExc_MemoryError);
+        return -1;
+    }
+    (void)memcpy(cols, matrix->cols, (size_t)matrix->width * (sizeof *cols));
+    cols[matrix->width] = node = (struct feature_node *)(void *)(
+        cols + matrix->width + 1
+    );
+    for (j = 0; j < matrix->height; ++j, ++node) {
+        node->index = j + 1;
+        node->value = prob->bias;
     }
+    node->index = -1;
+
+    prob->col_x = cols;
+    return 0;
 }
 
 
 /*
- * Get next feature vector, allocate new block if needed
- *
- * Return NULL on error
+ * Release a problem created by pl_matrix_as_problem()
  */
-static pl_vector_t *
-pl_vector_new(pl_vector_block_t **vectors_)
+void
+pl_matrix_problem_clear(PyObject *self, struct problem *prob)
 {
-    pl_vector_block_t *block = *vectors_;
-    pl_vector_t *vector;
+    pl_matrix_t *matrix = (pl_matrix_t *)self;
 
-    if (!block || !(block->size < (PL_VECTOR_BLOCK_SIZE - 1))) {
-        if (!(block = PyMem_Malloc(sizeof *block))) {
-            PyErr_SetNone(PyExc_MemoryError);
-            return NULL;
-        }
-        block->prev = *vectors_;
-        block->size = 0;
-        *vectors_ = block;
-    }
+    if (prob->col_x && prob->col_x != matrix->cols)
+        PyMem_Free(prob->col_x);
+    prob->col_x = NULL;
+
+    if (!prob->x)
+        return;
 
-    vector = &block->vector[block->size++];
-    vector->array = NULL;
-    return vector;
+    if (prob->bias < 0) {
+        /* nothing to do */
+    }
+    else if (prob->x == matrix->biased_vectors) {
+        --matrix->bias_users;
+    }
+    else {
+        PyMem_Free(prob->x[prob->l]);
+        PyMem_Free(prob->x);
+    }
+    prob->x = NULL;
 }
 
 
 /*
- * Clear complete vector block list
+ * Release vectors and nodes
  */
 static void
-pl_matrix_clear_vectors(struct feature_node ***vectors_, int height,
-                        int row_alloc)
+pl_matrix_clear_vectors(struct feature_node ***vectors_,
+                        struct feature_node **nodes_)
 {
-    struct feature_node **vectors;
-    int j;
+    void *ptr;
 
-    if ((vectors = *vectors_)) {
+    if ((ptr = *vectors_)) {
         *vectors_ = NULL;
-
-        if (row_alloc) {
-            for (j = 0; j < height; ++j)
-                PyMem_Free(vectors[j] - 1); /* unskip [0] (bias node) */
-        }
-        PyMem_Free(vectors);
+        PyMem_Free(ptr);
+    }
+    if ((ptr = *nodes_)) {
+        *nodes_ = NULL;
+        PyMem_Free(ptr);
     }
 }
 
 
 /*
- * Transform vectors into an array, clearing the vectors in the process
+ * Create pl_matrix_t from the rows collected in an arena
  *
- * Return -1 on error
+ * The arena is empty afterwards.
+ *
+ * Return NULL on error
  */
-static int
-pl_vectors_as_array(pl_vector_block_t **vectors_,
-                    struct feature_node ***array_, double **labels_,
-                    int height)
+static pl_matrix_t *
+pl_matrix_from_arena(PyTypeObject *cls, pl_arena_t *arena)
 {
-    pl_vector_block_t *block;
-    pl_vector_t *vector;
-    struct feature_node **array = NULL;
-    double *labels = NULL;
-    size_t idx_vector;
-    int j;
-
-    for (j = 0, block = *vectors_; block; block = block->prev)
-        j += (int)block->size;
-
-    if (j != height) {
-        pl_vector_block_clear(vectors_);
-        PyErr_SetString(PyExc_AssertionError,
-                        "Calculated wrong height. Duh!");
-        return -1;
-    }
-
-    if (height > 0) {
-        if (!(array = PyMem_Malloc(((unsigned int)height)
-                                   * (sizeof *array)))) {
-            PyErr_SetNone(PyExc_MemoryError);
-            return -1;
-        }
-
-        if (!(labels = PyMem_Malloc(((unsigned int)height)
-                                    * (sizeof *labels)))) {
-            PyMem_Free(array);
-            PyErr_SetNone(PyExc_MemoryError);
-            return -1;
-        }
+    struct feature_node **vectors, *nodes;
+    double *labels;
+    int height, width;
 
-        for (j = height; (block = *vectors_); ) {
-            *vectors_ = block->prev;
-            for (idx_vector = block->size; idx_vector > 0; ) {
-                vector = &block->vector[--idx_vector];
-                labels[--j] = (double)vector->label;
-                array[j] = vector->array + 1; /* skip [0] (bias node) */
-                vector->array = NULL;
-            }
-            PyMem_Free(block);
-        }
+    if (-1 == pl_arena_finish(arena, &vectors, &nodes, &labels, &height,
+                              &width)) {
+        pl_arena_clear(arena);
+        return NULL;
     }
-    *array_ = array;
-    *labels_ = labels;
 
-    return 0;
+    return pl_matrix_new(cls, vectors, nodes, labels, height, width);
 }
 
 
@@ -342,11 +613,10 @@ pl_matrix_from_iterable(PyTypeObject *cls, PyObject *iterable,
                         PyObject *assign_labels_)
 {
     PyObject *iter, *item, *label_, *vector_;
-    pl_vector_block_t *vectors = NULL;
-    pl_vector_t *vector;
-    double *labels;
-    struct feature_node **array;
-    int height = 0, width = 0, assign_labels = 0, label;
+    pl_arena_t arena;
+    int assign_labels = 0, label;
+
+    pl_arena_init(&arena);
 
     if (assign_labels_ && assign_labels_ != Py_None) {
         Py_INCREF(assign_labels_);
@@ -359,13 +629,6 @@ pl_matrix_from_iterable(PyTypeObject *cls, PyObject *iterable,
         goto error;
 
     while ((item = PyIter_Next(iter))) {
-        if (!(height < (INT_MAX - 1))) {
-            PyErr_SetNone(PyExc_OverflowError);
-            Py_DECREF(item);
-            goto error_iter;
-        }
-        ++height;
-
         if (assign_labels) {
             vector_ = item;
         }
@@ -376,29 +639,674 @@ pl_matrix_from_iterable(PyTypeObject *cls, PyObject *iterable,
                 goto error_vector;
         }
 
-        if (!(vector = pl_vector_new(&vectors)))
-            goto error_vector;
-
-        vector->label = label;
-        if (-1 == pl_vector_load(vector_, &vector->array, &vector->array_size,
-                                 &width))
+        if (pl_vector_load(vector_, (double)label, &arena) == -1)
             goto error_iter;
     }
     if (PyErr_Occurred())
         goto error_iter;
     Py_DECREF(iter);
 
-    if (pl_vectors_as_array(&vectors, &array, &labels, height) == -1)
-        goto error;
-
-    return pl_matrix_new(cls, array, labels, height, width, 1);
+    return pl_matrix_from_arena(cls, &arena);
 
 error_vector:
     Py_DECREF(vector_);
 error_iter:
     Py_DECREF(iter);
 error:
-    pl_vector_block_clear(&vectors);
+    pl_arena_clear(&arena);
+    return NULL;
+}
+
+
+/*
+ * Get a contiguous buffer of native numbers
+ *
+ * ndim is the expected number of dimensions (1 or 2), shape receives the
+ * size of each dimension. type receives the struct format character of the
+ * items. If integral is true, only integer types are accepted.
+ *
+ * Return -1 on error
+ */
+static int
+pl_numbuf_get(PyObject *obj, const char *name, int integral, int ndim,
+              Py_buffer *view, char *type_, Py_ssize_t *shape_)
+{
+    const char *format;
+    size_t itemsize;
+    char type;
+
+    if (PyObject_GetBuffer(obj, view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT)
+        == -1)
+        return -1;
+
+    format = view->format ? view->format : "B";
+    if (*format == '@')
+        ++format;
+    type = format[0];
+    switch (format[1] ? '\0' : type) {
+    case 'b': itemsize = sizeof(signed char); break;
+    case 'B': itemsize = sizeof(unsigned char); break;
+    case 'h': itemsize = sizeof(short); break;
+    case 'H': itemsize = sizeof(unsigned short); break;
+    case 'i': itemsize = sizeof(int); break;
+    case 'I': itemsize = sizeof(unsigned int); break;
+    case 'l': itemsize = sizeof(long); break;
+    case 'L': itemsize = sizeof(unsigned long); break;
+    case 'q': itemsize = sizeof(PY_LONG_LONG); break;
+    case 'Q': itemsize = sizeof(unsigned PY_LONG_LONG); break;
+    case 'f': itemsize = integral ? 0 : sizeof(float); break;
+    case 'd': itemsize = integral ? 0 : sizeof(double); break;
+    default: itemsize = 0; break;
+    }
+
+    if (!itemsize || (size_t)view->itemsize != itemsize
+        || (ndim == 1 ? view->ndim > 1 : view->ndim != ndim)) {
+        PyErr_Format(PyExc_TypeError,
+                     "%s must be a %s buffer of %s", name,
+                     ndim == 1 ? "one-dimensional" : "two-dimensional",
+                     integral ? "integers" : "numbers");
+        PyBuffer_Release(view);
+        return -1;
+    }
+
+    *type_ = type;
+    if (ndim == 1) {
+        shape_[0] = view->len / view->itemsize;
+    }
+    else {
+        shape_[0] = view->shape[0];
+        shape_[1] = view->shape[1];
+    }
+    return 0;
+}
+
+
+/*
+ * Read an item of an integer buffer
+ */
+static PY_LONG_LONG
+pl_numbuf_int(const void *buf, char type, Py_ssize_t j)
+{
+    switch (type) {
+    case 'b': return ((const signed char *)buf)[j];
+    case 'B': return ((const unsigned char *)buf)[j];
+    case 'h': return ((const short *)buf)[j];
+    case 'H': return ((const unsigned short *)buf)[j];
+    case 'i': return ((const int *)buf)[j];
+    case 'I': return ((const unsigned int *)buf)[j];
+    case 'l': return ((const long *)buf)[j];
+    case 'L': return (PY_LONG_LONG)((const unsigned long *)buf)[j];
+    case 'q': return ((const PY_LONG_LONG *)buf)[j];
+    default: return (PY_LONG_LONG)((const unsigned PY_LONG_LONG *)buf)[j];
+    }
+}
+
+
+/*
+ * Read an item of a number buffer
+ */
+static double
+pl_numbuf_double(const void *buf, char type, Py_ssize_t j)
+{
+    PY_LONG_LONG value;
+
+    switch (type) {
+    case 'f': return ((const float *)buf)[j];
+    case 'd': return ((const double *)buf)[j];
+    }
+
+    value = pl_numbuf_int(buf, type, j);
+    return (double)value;
+}
+
+
+/*
+ * Convert a buffer of labels, truncating them to ints
+ *
+ * Return -1 on error
+ */
+static int
+pl_numbuf_labels(const void *buf, char type, int height, double *labels)
+{
+    double value;
+    int j;
+
+    for (j = 0; j < height; ++j) {
+        value = pl_numbuf_double(buf, type, j);
+        if (!(value > ((double)INT_MIN - 1.0)
+              && value < ((double)INT_MAX + 1.0))) {
+            PyErr_SetString(PyExc_ValueError, "Invalid label");
+            return -1;
+        }
+        labels[j] = (double)(int)value;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Allocate height vectors and no_nodes nodes in total
+ *
+ * Return -1 on error
+ */
+static int
+pl_vectors_alloc(int height, size_t no_nodes,
+                 struct feature_node ***vectors_, struct feature_node **nodes_)
+{
+    struct feature_node **vectors, *nodes;
+
+    if (no_nodes > ((size_t)-1) / (sizeof *nodes)
+        || !(nodes = PyMem_Malloc(no_nodes * (sizeof *nodes)))) {
+        PyErr_SetNone(PyExc_MemoryError);
+        return -1;
+    }
+    if (!(vectors = PyMem_Malloc(((size_t)height) * (sizeof *vectors)))) {
+        PyMem_Free(nodes);
+        PyErr_SetNone(PyExc_MemoryError);
+        return -1;
+    }
+
+    *vectors_ = vectors;
+    *nodes_ = nodes;
+    return 0;
+}
+
+
+/*
+ * Create pl_matrix_t from compressed sparse row arrays
+ *
+ * Return NULL on error
+ */
+static pl_matrix_t *
+pl_matrix_from_csr(PyTypeObject *cls, PyObject *indptr_, PyObject *indices_,
+                   PyObject *data_, PyObject *labels_)
+{
+    Py_buffer indptr, indices, data, labels_view;
+    struct feature_node **vectors = NULL, *nodes = NULL, *node;
+    double *labels = NULL, value;
+    PY_LONG_LONG start, stop, index, last;
+    size_t no_nodes;
+    Py_ssize_t size, nnz, k;
+    int j, height = 0, width = 0;
+    char indptr_type, indices_type, data_type, labels_type;
+
+    if (pl_numbuf_get(indptr_, "indptr", 1, 1, &indptr, &indptr_type,
+                      &size) == -1)
+        return NULL;
+    if (pl_numbuf_get(indices_, "indices", 1, 1, &indices, &indices_type,
+                      &nnz) == -1)
+        goto error_indptr;
+    if (pl_numbuf_get(data_, "data", 0, 1, &data, &data_type, &k) == -1)
+        goto error_indices;
+    if (pl_numbuf_get(labels_, "labels", 0, 1, &labels_view, &labels_type,
+                      &size) == -1)
+        goto error_data;
+
+    if (k != nnz) {
+        PyErr_SetString(PyExc_ValueError,
+                        "indices and data must have the same length");
+        goto error_labels;
+    }
+    if (indptr.len / indptr.itemsize != size + 1) {
+        PyErr_SetString(PyExc_ValueError,
+                        "indptr must be one item longer than labels");
+        goto error_labels;
+    }
+    if (!(size < (Py_ssize_t)(INT_MAX - 1))) {
+        PyErr_SetNone(PyExc_OverflowError);
+        goto error_labels;
+    }
+    height = (int)size;
+
+    /* Validate indptr and count the nodes (features + bias + sentinel) */
+    no_nodes = 0;
+    for (j = 0; j < height; ++j) {
+        start = pl_numbuf_int(indptr.buf, indptr_type, j);
+        stop = pl_numbuf_int(indptr.buf, indptr_type, j + 1);
+        if (start < 0 || stop < start || stop > (PY_LONG_LONG)nnz) {
+            PyErr_SetString(PyExc_ValueError, "Invalid indptr");
+            goto error_labels;
+        }
+        if (stop - start > (PY_LONG_LONG)(INT_MAX - 2)) {
+            PyErr_SetNone(PyExc_OverflowError);
+            goto error_labels;
+        }
+        no_nodes += (size_t)(stop - start) + 2;
+    }
+    /* indptr must cover all of indices and data, from the start */
+    if (pl_numbuf_int(indptr.buf, indptr_type, 0) != 0
+        || pl_numbuf_int(indptr.buf, indptr_type, height)
+           != (PY_LONG_LONG)nnz) {
+        PyErr_SetString(PyExc_ValueError, "Invalid indptr");
+        goto error_labels;
+    }
+
+    if (height > 0) {
+        if (pl_vectors_alloc(height, no_nodes, &vectors, &nodes) == -1)
+            goto error_labels;
+        node = nodes;
+        if (!(labels = PyMem_Malloc(((size_t)height) * (sizeof *labels)))) {
+            PyErr_SetNone(PyExc_MemoryError);
+            goto error_vectors;
+        }
+        if (pl_numbuf_labels(labels_view.buf, labels_type, height, labels)
+            == -1)
+            goto error_vectors;
+
+        for (j = 0; j < height; ++j) {
+            vectors[j] = ++node; /* skip [0] (bias node) */
+            start = pl_numbuf_int(indptr.buf, indptr_type, j);
+            stop = pl_numbuf_int(indptr.buf, indptr_type, j + 1);
+            last = -1;
+            for (k = (Py_ssize_t)start; k < (Py_ssize_t)stop; ++k) {
+                index = pl_numbuf_int(indices.buf, indices_type, k);
+                if (index < 0 || index > (PY_LONG_LONG)(INT_MAX - 2)) {
+                    PyErr_SetString(PyExc_ValueError, "Invalid index");
+                    goto error_vectors;
+                }
+                if (index <= last) {
+                    PyErr_SetString(PyExc_ValueError,
+                                    "indices must be strictly ascending "
+                                    "within each row");
+                    goto error_vectors;
+                }
+                last = index;
+                if ((value = pl_numbuf_double(data.buf, data_type, k)) == 0.0)
+                    continue;
+
+                node->index = (int)index + 1;
+                node->value = value;
+                if (node->index > width)
+                    width = node->index;
+                ++node;
+            }
+            node->index = -1;
+            node->value = 0.0;
+            ++node;
+        }
+    }
+
+    PyBuffer_Release(&labels_view);
+    PyBuffer_Release(&data);
+    PyBuffer_Release(&indices);
+    PyBuffer_Release(&indptr);
+
+    return pl_matrix_new(cls, vectors, nodes, labels, height, width);
+
+error_vectors:
+    if (labels)
+        PyMem_Free(labels);
+    pl_matrix_clear_vectors(&vectors, &nodes);
+error_labels:
+    PyBuffer_Release(&labels_view);
+error_data:
+    PyBuffer_Release(&data);
+error_indices:
+    PyBuffer_Release(&indices);
+error_indptr:
+    PyBuffer_Release(&indptr);
+    return NULL;
+}
+
+
+/*
+ * Collect the values of a dense row with an absolute value above threshold
+ *
+ * If node is NULL, the values are only counted. Otherwise they are stored
+ * at node (indexes starting with 1).
+ *
+ * Return the number of values found
+ */
+static Py_ssize_t
+pl_dense_row(const void *row, char type, Py_ssize_t size, double threshold,
+             float fthreshold, struct feature_node *node)
+{
+    const double *dc, *dend;
+    const float *fc, *fend;
+    double value;
+    Py_ssize_t j, found = 0;
+
+    switch (type) {
+    case 'd':
+        dend = (dc = row) + size;
+        for (; (dc = pl_scan_double(dc, dend, threshold)) < dend;
+             ++dc, ++found) {
+            if (node) {
+                node[found].index = (int)(dc - (const double *)row) + 1;
+                node[found].value = *dc;
+            }
+        }
+        break;
+
+    case 'f':
+        fend = (fc = row) + size;
+        for (; (fc = pl_scan_float(fc, fend, fthreshold)) < fend;
+             ++fc, ++found) {
+            if (node) {
+                node[found].index = (int)(fc - (const float *)row) + 1;
+                node[found].value = (double)*fc;
+            }
+        }
+        break;
+
+    default:
+        for (j = 0; j < size; ++j) {
+            value = pl_numbuf_double(row, type, j);
+            if (fabs(value) <= threshold)
+                continue;
+            if (node) {
+                node[found].index = (int)j + 1;
+                node[found].value = value;
+            }
+            ++found;
+        }
+        break;
+    }
+
+    return found;
+}
+
+
+/*
+ * Create pl_matrix_t from a dense two-dimensional buffer
+ *
+ * Return NULL on error
+ */
+static pl_matrix_t *
+pl_matrix_from_dense(PyTypeObject *cls, PyObject *buffer_, PyObject *labels_,
+                     double threshold)
+{
+    Py_buffer buffer, labels_view;
+    struct feature_node **vectors = NULL, *nodes = NULL, *node;
+    double *labels = NULL;
+    const char *row;
+    size_t no_nodes, rowsize;
+    Py_ssize_t shape[2], size, found;
+    int j, height = 0, width = 0;
+    float fthreshold;
+    char type, labels_type;
+
+    if (!(threshold >= 0.0)) {
+        PyErr_SetString(PyExc_ValueError, "threshold must be >= 0");
+        return NULL;
+    }
+
+    /* Largest float not above threshold */
+    fthreshold = (float)threshold;
+    if ((double)fthreshold > threshold)
+        fthreshold = nextafterf(fthreshold, 0.0f);
+
+    if (pl_numbuf_get(buffer_, "buffer", 0, 2, &buffer, &type, shape) == -1)
+        return NULL;
+    if (pl_numbuf_get(labels_, "labels", 0, 1, &labels_view, &labels_type,
+                      &size) == -1)
+        goto error_buffer;
+
+    if (size != shape[0]) {
+        PyErr_SetString(PyExc_ValueError,
+                        "labels must have one item per buffer row");
+        goto error_labels;
+    }
+    if (!(shape[0] < (Py_ssize_t)(INT_MAX - 1)
+          && shape[1] < (Py_ssize_t)(INT_MAX - 1))) {
+        PyErr_SetNone(PyExc_OverflowError);
+        goto error_labels;
+    }
+    height = (int)shape[0];
+    rowsize = ((size_t)shape[1]) * (size_t)buffer.itemsize;
+
+    /* Count the nodes (features + bias + sentinel) */
+    no_nodes = 0;
+    for (j = 0, row = buffer.buf; j < height; ++j, row += rowsize)
+        no_nodes += (size_t)pl_dense_row(row, type, shape[1], threshold,
+                                         fthreshold, NULL) + 2;
+
+    if (height > 0) {
+        if (pl_vectors_alloc(height, no_nodes, &vectors, &nodes) == -1)
+            goto error_labels;
+        node = nodes;
+        if (!(labels = PyMem_Malloc(((size_t)height) * (sizeof *labels)))) {
+            PyErr_SetNone(PyExc_MemoryError);
+            goto error_vectors;
+        }
+        if (pl_numbuf_labels(labels_view.buf, labels_type, height, labels)
+            == -1)
+            goto error_vectors;
+
+        for (j = 0, row = buffer.buf; j < height; ++j, row += rowsize) {
+            vectors[j] = ++node; /* skip [0] (bias node) */
+            found = pl_dense_row(row, type, shape[1], threshold, fthreshold,
+                                 node);
+            node += found;
+            if (found && node[-1].index > width)
+                width = node[-1].index;
+            node->index = -1;
+            node->value = 0.0;
+            ++node;
+        }
+    }
+
+    PyBuffer_Release(&labels_view);
+    PyBuffer_Release(&buffer);
+
+    return pl_matrix_new(cls, vectors, nodes, labels, height, width);
+
+error_vectors:
+    if (labels)
+        PyMem_Free(labels);
+    pl_matrix_clear_vectors(&vectors, &nodes);
+error_labels:
+    PyBuffer_Release(&labels_view);
+error_buffer:
+    PyBuffer_Release(&buffer);
+    return NULL;
+}
+
+
+/*
+ * Parse a label token
+ *
+ * The label is truncated to an int the same way as pl_as_int() does it.
+ *
+ * Return -1 on error
+ */
+static int
+pl_tok_as_label(pl_tok_t *tok, int *label_)
+{
+    char *end;
+    double label;
+
+    if (pl_parse_double(tok->start, tok->sentinel, &label) == -1) {
+        label = PyOS_string_to_double(tok->start, &end, PyExc_OverflowError);
+        if (label == -1.0 && PyErr_Occurred())
+            return -1;
+
+        if (end != tok->sentinel) {
+            PyErr_SetString(PyExc_ValueError, "Invalid format");
+            return -1;
+        }
+    }
+
+    /* Out of range, inf or nan: Let python raise the appropriate error */
+    if (!(label > ((double)INT_MIN - 1.0) && label < ((double)INT_MAX + 1.0)))
+        return pl_as_int(PyFloat_FromDouble(label), label_);
+
+    *label_ = (int)label;
+    return 0;
+}
+
+
+/*
+ * Parse an index:value token
+ *
+ * Return -1 on error
+ */
+static int
+pl_tok_as_feature(pl_tok_t *tok, int *index_, double *value_)
+{
+    const char *colon;
+    char *end;
+    double value;
+    long index;
+
+    if (pl_parse_int(tok->start, tok->sentinel, &colon, &index) == -1) {
+        errno = 0;
+        index = PyOS_strtol(tok->start, &end, 10);
+        if (errno) {
+            PyErr_SetString(PyExc_ValueError, "Invalid format");
+            return -1;
+        }
+        colon = end;
+    }
+    if (*colon != ':') {
+        PyErr_SetString(PyExc_ValueError, "Invalid format");
+        return -1;
+    }
+
+    if (pl_parse_double(colon + 1, tok->sentinel, &value) == -1) {
+        value = PyOS_string_to_double(colon + 1, &end, PyExc_OverflowError);
+        if (value == -1.0 && PyErr_Occurred())
+            return -1;
+
+        if (end != tok->sentinel) {
+            PyErr_SetString(PyExc_ValueError, "Invalid format");
+            return -1;
+        }
+    }
+
+    if (index > (long)INT_MAX || index < (long)INT_MIN) {
+        PyErr_SetNone(PyExc_OverflowError);
+        return -1;
+    }
+    if (index <= 0) {
+        PyErr_SetString(PyExc_ValueError, "Index must be > 0");
+        return -1;
+    }
+
+    *index_ = (int)index;
+    *value_ = value;
+    return 0;
+}
+
+
+/*
+ * Create pl_matrix_t from a token reader
+ *
+ * The tokens are transformed directly into feature nodes, without creating
+ * intermediate python objects.
+ *
+ * Return NULL on error
+ */
+static pl_matrix_t *
+pl_matrix_from_tokread(PyTypeObject *cls, pl_iter_t *tokread)
+{
+    pl_arena_t arena;
+    pl_tok_t *tok;
+    double value;
+    void *vh;
+    int label, index;
+
+    pl_arena_init(&arena);
+
+    while (1) {
+        if (pl_iter_next(tokread, &vh) == -1)
+            goto error;
+        if (!(tok = vh))
+            break;
+
+        if (PL_TOK_IS_EOL(tok)) {
+            PyErr_SetString(PyExc_ValueError, "Invalid format");
+            goto error;
+        }
+
+        if (pl_tok_as_label(tok, &label) == -1)
+            goto error;
+        if (pl_arena_row_open(&arena, (double)label) == -1)
+            goto error;
+
+        while (1) {
+            if (pl_iter_next(tokread, &vh) == -1)
+                goto error;
+            if (!(tok = vh) || PL_TOK_IS_EOL(tok))
+                break;
+
+            if (pl_tok_as_feature(tok, &index, &value) == -1)
+                goto error;
+            if (pl_arena_feature_add(&arena, index, value) == -1)
+                goto error;
+        }
+        if (pl_arena_row_close(&arena) == -1)
+            goto error;
+        if (!tok)
+            break;
+    }
+
+    return pl_matrix_from_arena(cls, &arena);
+
+error:
+    pl_arena_clear(&arena);
+    return NULL;
+}
+
+
+/*
+ * Create pl_matrix_t from a buffer object (e.g. an mmap)
+ *
+ * The buffer is parsed by multiple threads if requested and possible, by the
+ * token reader otherwise.
+ *
+ * map is stolen.
+ *
+ * Return NULL on error
+ */
+static pl_matrix_t *
+pl_matrix_from_map(PyTypeObject *cls, PyObject *map, int threads)
+{
+    pl_iter_t *tokread;
+    pl_matrix_t *self;
+    pl_arena_t arena;
+    int res;
+#ifdef EXT2
+    const void *data;
+    Py_ssize_t size;
+#else
+    Py_buffer view;
+#endif
+
+    if (threads > 1) {
+        pl_arena_init(&arena);
+#ifdef EXT2
+        if (-1 == PyObject_AsReadBuffer(map, &data, &size))
+            goto error;
+        res = pl_lineparse(data, size, threads, &arena);
+#else
+        if (-1 == PyObject_GetBuffer(map, &view, PyBUF_SIMPLE))
+            goto error;
+        res = pl_lineparse(view.buf, view.len, threads, &arena);
+        PyBuffer_Release(&view);
+#endif
+        if (res == -1) {
+            pl_arena_clear(&arena);
+            goto error;
+        }
+
+        if (res == 0) {
+            Py_DECREF(map);
+            return pl_matrix_from_arena(cls, &arena);
+        }
+        pl_arena_clear(&arena);
+    }
+
+    if (!(tokread = pl_tokread_iter_map_new(map)))
+        return NULL;
+
+    self = pl_matrix_from_tokread(cls, tokread);
+    pl_iter_clear(&tokread);
+    return self;
+
+error:
+    Py_DECREF(map);
     return NULL;
 }
 
@@ -417,7 +1325,7 @@ pl_matrix_to_stream(pl_matrix_t *self, PyObject *write)
     char intbuf[PL_INT_AS_CHAR_BUF_SIZE];
     int res, h;
 
-    if (!(buf = pl_bufwriter_new(write)))
+    if (!(buf = pl_bufwriter_new(write, 0)))
         return -1;
 
     for (h = 0; h < self->height; ++h) {
@@ -463,7 +1371,249 @@ error:
 }
 
 
-#ifdef PL_CROSS_VALIDATE
+/*
+ * Save matrix to stream in binary format
+ *
+ * Return -1 on error
+ */
+static int
+pl_matrix_to_binary(pl_matrix_t *self, PyObject *write)
+{
+    static const char zeros[PL_MATRIX_BINARY_ALIGN] = {0};
+    pl_matrix_binary_t header;
+    pl_bufwriter_t *buf;
+    struct feature_node bias, *node;
+    PY_UINT64_T *offsets, no_nodes = 0;
+    size_t end;
+    int j;
+
+    if (!(offsets = PyMem_Malloc(((size_t)self->height + 1)
+                                 * (sizeof *offsets)))) {
+        PyErr_SetNone(PyExc_MemoryError);
+        Py_DECREF(write);
+        return -1;
+    }
+    for (j = 0; j < self->height; ++j) {
+        offsets[j] = no_nodes;
+        for (node = self->vectors[j]; node->index != -1; ++node)
+            ;
+        no_nodes += (PY_UINT64_T)(node - self->vectors[j]) + 2;
+    }
+    offsets[self->height] = no_nodes;
+
+    (void)memset(&header, 0, sizeof header);
+    (void)memcpy(header.magic, PL_MATRIX_BINARY_MAGIC, sizeof header.magic);
+    header.version = PL_MATRIX_BINARY_VERSION;
+    header.byteorder = PL_MATRIX_BINARY_BYTEORDER;
+    header.node_size = (PY_UINT32_T)sizeof *node;
+    header.value_offset = (PY_UINT32_T)offsetof(struct feature_node, value);
+    header.height = self->height;
+    header.width = self->width;
+    header.no_nodes = no_nodes;
+    header.labels_offset = sizeof header;
+    header.offsets_offset = header.labels_offset
+        + ((PY_UINT64_T)self->height) * (sizeof *self->labels);
+    end = (size_t)(header.offsets_offset
+                   + ((PY_UINT64_T)self->height + 1) * (sizeof *offsets));
+    header.nodes_offset = (PY_UINT64_T)((end + PL_MATRIX_BINARY_ALIGN - 1)
+                          / PL_MATRIX_BINARY_ALIGN * PL_MATRIX_BINARY_ALIGN);
+
+    (void)memset(&bias, 0, sizeof bias);
+
+    if (!(buf = pl_bufwriter_new(write, 1)))
+        goto error_offsets;
+
+#define WRITE_BUF(data, size) do {                                       \
+    if (pl_bufwriter_write(buf, (const char *)(const void *)(data),      \
+                           (Py_ssize_t)(size)) == -1)                    \
+        goto error;                                                      \
+} while(0)
+
+    WRITE_BUF(&header, sizeof header);
+    if (self->height > 0)
+        WRITE_BUF(self->labels,
+                  ((size_t)self->height) * (sizeof *self->labels));
+    WRITE_BUF(offsets, ((size_t)self->height + 1) * (sizeof *offsets));
+    WRITE_BUF(zeros, (size_t)header.nodes_offset - end);
+
+    for (j = 0; j < self->height; ++j) {
+        WRITE_BUF(&bias, sizeof bias);
+        WRITE_BUF(self->vectors[j],
+                  (size_t)(offsets[j + 1] - offsets[j] - 1) * (sizeof bias));
+    }
+
+#undef WRITE_BUF
+
+    PyMem_Free(offsets);
+    return pl_bufwriter_close(&buf);
+
+error:
+    if (!PyErr_Occurred())
+        PyErr_SetNone(PyExc_MemoryError);
+    pl_bufwriter_clear(&buf);
+error_offsets:
+    PyMem_Free(offsets);
+    return -1;
+}
+
+
+/*
+ * Create pl_matrix_t from binary format
+ *
+ * data is stolen. If in_place is true, data is expected to be a writable
+ * (copy-on-write) file mapping, which the vectors point into afterwards.
+ * Otherwise the nodes are copied.
+ *
+ * Return NULL on error
+ */
+static pl_matrix_t *
+pl_matrix_from_binary(PyTypeObject *cls, PyObject *data, int in_place)
+{
+    pl_matrix_binary_t header;
+    pl_matrix_t *self;
+    struct feature_node **vectors = NULL, *nodes = NULL, *node;
+    double *labels = NULL;
+    const char *buf;
+    PY_UINT64_T start, stop = 0;
+    size_t size;
+    int j, height;
+#ifdef EXT2
+    const void *rbuf;
+    void *wbuf;
+    Py_ssize_t ssize;
+
+    if (in_place) {
+        if (-1 == PyObject_AsWriteBuffer(data, &wbuf, &ssize))
+            goto error_data;
+        buf = wbuf;
+    }
+    else {
+        if (-1 == PyObject_AsReadBuffer(data, &rbuf, &ssize))
+            goto error_data;
+        buf = rbuf;
+    }
+    size = (size_t)ssize;
+#else
+    Py_buffer view;
+
+    if (-1 == PyObject_GetBuffer(data, &view, in_place ? PyBUF_WRITABLE
+                                                       : PyBUF_SIMPLE))
+        goto error_data;
+    buf = view.buf;
+    size = (size_t)view.len;
+
+    /* data keeps the memory alive */
+    PyBuffer_Release(&view);
+#endif
+
+    if (size < sizeof header)
+        goto error_format;
+    (void)memcpy(&header, buf, sizeof header);
+
+    if (memcmp(header.magic, PL_MATRIX_BINARY_MAGIC, sizeof header.magic)
+        || header.version != PL_MATRIX_BINARY_VERSION)
+        goto error_format;
+
+    if (header.byteorder != PL_MATRIX_BINARY_BYTEORDER
+        || header.node_size != sizeof *node
+        || header.value_offset != offsetof(struct feature_node, value)) {
+        PyErr_SetString(PyExc_ValueError,
+                        "Incompatible binary format (written on a different "
+                        "platform)");
+        goto error_data;
+    }
+
+    if (header.height < 0 || header.height >= INT_MAX - 1
+        || header.width < 0 || header.width >= INT_MAX - 1
+        || header.labels_offset > size
+        || (size - header.labels_offset) / (sizeof *labels)
+           < (PY_UINT64_T)header.height
+        || header.offsets_offset > size
+        || (size - header.offsets_offset) / (sizeof start)
+           <= (PY_UINT64_T)header.height
+        || header.nodes_offset > size
+        || header.nodes_offset % (sizeof (double))
+        || (size - header.nodes_offset) / (sizeof *node) < header.no_nodes)
+        goto error_format;
+    height = (int)header.height;
+
+    if (height > 0) {
+        if (!(labels = PyMem_Malloc(((size_t)height) * (sizeof *labels)))) {
+            PyErr_SetNone(PyExc_MemoryError);
+            goto error_data;
+        }
+        (void)memcpy(labels, buf + header.labels_offset,
+                     ((size_t)height) * (sizeof *labels));
+
+        if (in_place) {
+            if (!(vectors = PyMem_Malloc(((size_t)height)
+                                         * (sizeof *vectors)))) {
+                PyErr_SetNone(PyExc_MemoryError);
+                goto error_labels;
+            }
+            nodes = (struct feature_node *)(void *)(buf + header.nodes_offset);
+        }
+        else {
+            if (-1 == pl_vectors_alloc(height, (size_t)header.no_nodes,
+                                       &vectors, &nodes))
+                goto error_labels;
+            (void)memcpy(nodes, buf + header.nodes_offset,
+                         (size_t)header.no_nodes * (sizeof *node));
+        }
+
+        /* Check the row structure */
+        for (j = 0; j < height; ++j) {
+            start = stop;
+            (void)memcpy(&stop, buf + header.offsets_offset
+                                + ((size_t)j + 1) * (sizeof stop),
+                         sizeof stop);
+            if (stop < start + 2 || stop > header.no_nodes
+                || nodes[stop - 1].index != -1)
+                goto error_format_vectors;
+            vectors[j] = nodes + start + 1; /* skip [0] (bias node) */
+
+            /*
+             * The solvers index their arrays by the feature indexes, so
+             * check them in both modes. In place it's a read-only scan of
+             * the mapping.
+             */
+            for (node = vectors[j]; node->index != -1; ++node) {
+                if (node->index <= 0 || node->index > header.width)
+                    goto error_format_vectors;
+            }
+        }
+    }
+    (void)memcpy(&start, buf + header.offsets_offset, sizeof start);
+    if (start != 0 || stop != (height > 0 ? header.no_nodes : 0))
+        goto error_format_vectors;
+
+    if (!(self = pl_matrix_new(cls, vectors, in_place ? NULL : nodes, labels,
+                               height, (int)header.width)))
+        goto error_data;
+
+    if (in_place)
+        self->map = data;
+    else
+        Py_DECREF(data);
+
+    return self;
+
+error_format_vectors:
+    if (in_place)
+        PyMem_Free(vectors);
+    else
+        pl_matrix_clear_vectors(&vectors, &nodes);
+error_format:
+    PyErr_SetString(PyExc_ValueError, "Invalid format");
+error_labels:
+    if (labels)
+        PyMem_Free(labels);
+error_data:
+    Py_DECREF(data);
+    return NULL;
+}
+
+
 /*
  * Evaluate prediction result
  *
@@ -492,7 +1642,7 @@ pl_eval(struct problem *prob, double *predicted, pl_eval_t *result)
         sumyy += y * y;
         sumvy += v * y;
     }
-    result->acc = corr / prob->l;
+    result->acc = (double)corr / prob->l;
     result->mse = err / prob->l;
     result->scc = ((prob->l * sumvy - sumv * sumy)
                       * (prob->l * sumvy - sumv * sumy))
@@ -501,7 +1651,7 @@ pl_eval(struct problem *prob, double *predicted, pl_eval_t *result)
                       * (prob->l * sumyy - sumy * sumy));
     return 0;
 }
-#endif
+
 
 /* ------------------------- END Helper Functions ------------------------ */
 
@@ -756,323 +1906,28 @@ static int
 PL_ZipperType_traverse(pl_zipper_t *self, visitproc visit, void *arg)
 {
     Py_VISIT(self->labels);
-    Py_VISIT(self->vectors);
-
-    return 0;
-}
-
-static int
-PL_ZipperType_clear(pl_zipper_t *self)
-{
-    Py_CLEAR(self->labels);
-    Py_CLEAR(self->vectors);
-
-    return 0;
-}
-
-DEFINE_GENERIC_DEALLOC(PL_ZipperType)
-
-PyTypeObject PL_ZipperType = {
-    PyVarObject_HEAD_INIT(NULL, 0)
-    EXT_MODULE_PATH ".FeatureMatrixZipper",             /* tp_name */
-    sizeof(pl_zipper_t),                                /* tp_basicsize */
-    0,                                                  /* tp_itemsize */
-    (destructor)PL_ZipperType_dealloc,                  /* tp_dealloc */
-    0,                                                  /* tp_print */
-    0,                                                  /* tp_getattr */
-    0,                                                  /* tp_setattr */
-    0,                                                  /* tp_compare */
-    0,                                                  /* tp_repr */
-    0,                                                  /* tp_as_number */
-    0,                                                  /* tp_as_sequence */
-    0,                                                  /* tp_as_mapping */
-    0,                                                  /* tp_hash */
-    0,                                                  /* tp_call */
-    0,                                                  /* tp_str */
-    0,                                                  /* tp_getattro */
-    0,                                                  /* tp_setattro */
-    0,                                                  /* tp_as_buffer */
-    Py_TPFLAGS_HAVE_CLASS                               /* tp_flags */
-    | Py_TPFLAGS_HAVE_ITER
-    | Py_TPFLAGS_HAVE_GC,
-    0,                                                  /* tp_doc */
-    (traverseproc)PL_ZipperType_traverse,               /* tp_traverse */
-    (inquiry)PL_ZipperType_clear,                       /* tp_clear */
-    0,                                                  /* tp_richcompare */
-    0,                                                  /* tp_weaklistoffset */
-    (getiterfunc)PL_ZipperType_iter,                    /* tp_iter */
-    (iternextfunc)PL_ZipperType_iternext                /* tp_iternext */
-};
-
-/*
- * Create new zipper object
- *
- * Return NULL on error
- */
-static PyObject *
-pl_zipper_new(PyObject *labels, PyObject *vectors)
-{
-    pl_zipper_t *self;
-
-    if (!(self = GENERIC_ALLOC(&PL_ZipperType)))
-        return NULL;
-
-    self->vectors = NULL;
-    if (!(self->labels = PyObject_GetIter(labels)))
-        goto error;
-    if (!(self->vectors = PyObject_GetIter(vectors)))
-        goto error;
-
-    return (PyObject *)self;
-
-error:
-    Py_DECREF((PyObject *)self);
-    return NULL;
-}
-
-/* ------------------------ END Zipper DEFINITION ------------------------ */
-
-/* -------------------- BEGIN VectorReader DEFINITION -------------------- */
-
-static PyObject *
-PL_VectorReaderType_iteritems(PyObject *self, PyObject *args)
-{
-    Py_INCREF(self);
-    return self;
-}
-
-static struct PyMethodDef PL_VectorReaderType_methods[] = {
-    {"iteritems",
-     EXT_CFUNC(PL_VectorReaderType_iteritems), METH_NOARGS,
-     NULL},
-
-    {NULL, NULL}  /* Sentinel */
-};
-
-#define PL_VectorReaderType_iter PyObject_SelfIter
-
-#ifdef EXT3
-#define PyInt_FromLong PyLong_FromLong
-#endif
-static PyObject *
-PL_VectorReaderType_iternext(pl_vector_reader_t *self)
-{
-    char *end;
-    pl_tok_t *tok;
-    PyObject *index_, *value_, *tuple_;
-    void *vh;
-    double value;
-    long index;
-
-    if (self->matrix_reader && self->matrix_reader->tokread
-        && pl_iter_next(self->matrix_reader->tokread, &vh) == 0) {
-        tok = vh;
-
-        if (!tok || PL_TOK_IS_EOL(tok)) {
-            self->matrix_reader->state = PL_MATRIX_READER_STATE_ROW;
-            return NULL;
-        }
-
-        index = PyOS_strtol(tok->start, &end, 10);
-        if (errno || *end != ':') {
-            PyErr_SetString(PyExc_ValueError, "Invalid format");
-            goto error;
-        }
-
-        value = PyOS_string_to_double(end + 1, &end,
-                                      PyExc_OverflowError);
-        if (value == -1.0 && PyErr_Occurred())
-            goto error;
-
-        if (end != tok->sentinel) {
-            PyErr_SetString(PyExc_ValueError, "Invalid format");
-            goto error;
-        }
-
-        if (!(index_ = PyInt_FromLong(index)))
-            goto error;
-
-        if (!(value_ = PyFloat_FromDouble(value)))
-            goto error_index;
-
-        if (!(tuple_ = PyTuple_New(2)))
-            goto error_value;
-
-        PyTuple_SET_ITEM(tuple_, 0, index_);
-        PyTuple_SET_ITEM(tuple_, 1, value_);
-        return tuple_;
-    }
-
-    return NULL;
-
-error_value:
-    Py_DECREF(value_);
-error_index:
-    Py_DECREF(index_);
-error:
-    return NULL;
-}
-#ifdef EXT3
-#undef PyInt_FromLong
-#endif
-
-static int
-PL_VectorReaderType_traverse(pl_vector_reader_t *self, visitproc visit,
-                             void *arg)
-{
-    Py_VISIT(self->matrix_reader);
-
-    return 0;
-}
-
-static int
-PL_VectorReaderType_clear(pl_vector_reader_t *self)
-{
-    Py_CLEAR(self->matrix_reader);
-
-    return 0;
-}
-
-DEFINE_GENERIC_DEALLOC(PL_VectorReaderType)
-
-PyTypeObject PL_VectorReaderType = {
-    PyVarObject_HEAD_INIT(NULL, 0)
-    EXT_MODULE_PATH ".FeatureVectorReader",             /* tp_name */
-    sizeof(pl_vector_reader_t),                         /* tp_basicsize */
-    0,                                                  /* tp_itemsize */
-    (destructor)PL_VectorReaderType_dealloc,            /* tp_dealloc */
-    0,                                                  /* tp_print */
-    0,                                                  /* tp_getattr */
-    0,                                                  /* tp_setattr */
-    0,                                                  /* tp_compare */
-    0,                                                  /* tp_repr */
-    0,                                                  /* tp_as_number */
-    0,                                                  /* tp_as_sequence */
-    0,                                                  /* tp_as_mapping */
-    0,                                                  /* tp_hash */
-    0,                                                  /* tp_call */
-    0,                                                  /* tp_str */
-    0,                                                  /* tp_getattro */
-    0,                                                  /* tp_setattro */
-    0,                                                  /* tp_as_buffer */
-    Py_TPFLAGS_HAVE_CLASS                               /* tp_flags */
-    | Py_TPFLAGS_HAVE_ITER
-    | Py_TPFLAGS_HAVE_GC,
-    0,                                                  /* tp_doc */
-    (traverseproc)PL_VectorReaderType_traverse,         /* tp_traverse */
-    (inquiry)PL_VectorReaderType_clear,                 /* tp_clear */
-    0,                                                  /* tp_richcompare */
-    0,                                                  /* tp_weaklistoffset */
-    (getiterfunc)PL_VectorReaderType_iter,              /* tp_iter */
-    (iternextfunc)PL_VectorReaderType_iternext,         /* tp_iternext */
-    PL_VectorReaderType_methods                         /* tp_methods */
-};
-
-/*
- * Create new reader object
- *
- * read is stolen and cleared on error
- *
- * Return NULL on error
- */
-static PyObject *
-pl_vector_reader_new(pl_matrix_reader_t *matrix_reader)
-{
-    pl_vector_reader_t *self;
-
-    if (!(self = GENERIC_ALLOC(&PL_VectorReaderType)))
-        return NULL;
-
-    Py_INCREF(matrix_reader);
-    self->matrix_reader = matrix_reader;
-
-    return (PyObject *)self;
-}
-
-/* --------------------- END VectorReader DEFINITION --------------------- */
-
-/* -------------------- BEGIN MatrixReader DEFINITION -------------------- */
-
-#define PL_MatrixReaderType_iter PyObject_SelfIter
-
-static PyObject *
-PL_MatrixReaderType_iternext(pl_matrix_reader_t *self)
-{
-    char *end;
-    pl_tok_t *tok;
-    PyObject *label_, *vector_, *tuple_;
-    void *vh;
-    double label;
-
-    if (self->tokread) {
-        switch (self->state) {
-        case PL_MATRIX_READER_STATE_VECTOR:
-            PyErr_SetString(PyExc_RuntimeError,
-                            "Need to iterate the vector first");
-            break;
-
-        case PL_MATRIX_READER_STATE_ROW:
-            if (pl_iter_next(self->tokread, &vh) == 0 && ((tok = vh))) {
-                if (PL_TOK_IS_EOL(tok)) {
-                    PyErr_SetString(PyExc_ValueError, "Invalid format");
-                    break;
-                }
-
-                self->state = PL_MATRIX_READER_STATE_VECTOR;
-                label = PyOS_string_to_double(tok->start, &end,
-                                              PyExc_OverflowError);
-                if (label == -1.0 && PyErr_Occurred())
-                    break;
-                if (end != tok->sentinel) {
-                    PyErr_SetString(PyExc_ValueError, "Invalid format");
-                    break;
-                }
-                if (!(label_ = PyFloat_FromDouble(label)))
-                    break;
-                if (!(vector_ = pl_vector_reader_new(self))) {
-                    Py_DECREF(label_);
-                    break;
-                }
-                if (!(tuple_ = PyTuple_New(2))) {
-                    Py_DECREF(vector_);
-                    Py_DECREF(label_);
-                    break;
-                }
-                PyTuple_SET_ITEM(tuple_, 0, label_);
-                PyTuple_SET_ITEM(tuple_, 1, vector_);
-                return tuple_;
-            }
-        }
-    }
-
-    return NULL;
-}
-
-static int
-PL_MatrixReaderType_traverse(pl_matrix_reader_t *self, visitproc visit,
-                             void *arg)
-{
-    PL_ITER_VISIT(self->tokread);
+    Py_VISIT(self->vectors);
 
     return 0;
 }
 
 static int
-PL_MatrixReaderType_clear(pl_matrix_reader_t *self)
+PL_ZipperType_clear(pl_zipper_t *self)
 {
-    pl_iter_clear(&self->tokread);
+    Py_CLEAR(self->labels);
+    Py_CLEAR(self->vectors);
 
     return 0;
 }
 
-DEFINE_GENERIC_DEALLOC(PL_MatrixReaderType)
+DEFINE_GENERIC_DEALLOC(PL_ZipperType)
 
-PyTypeObject PL_MatrixReaderType = {
+PyTypeObject PL_ZipperType = {
     PyVarObject_HEAD_INIT(NULL, 0)
-    EXT_MODULE_PATH ".FeatureMatrixReader",             /* tp_name */
-    sizeof(pl_matrix_reader_t),                         /* tp_basicsize */
+    EXT_MODULE_PATH ".FeatureMatrixZipper",             /* tp_name */
+    sizeof(pl_zipper_t),                                /* tp_basicsize */
     0,                                                  /* tp_itemsize */
-    (destructor)PL_MatrixReaderType_dealloc,            /* tp_dealloc */
+    (destructor)PL_ZipperType_dealloc,                  /* tp_dealloc */
     0,                                                  /* tp_print */
     0,                                                  /* tp_getattr */
     0,                                                  /* tp_setattr */
@@ -1091,42 +1946,41 @@ PyTypeObject PL_MatrixReaderType = {
     | Py_TPFLAGS_HAVE_ITER
     | Py_TPFLAGS_HAVE_GC,
     0,                                                  /* tp_doc */
-    (traverseproc)PL_MatrixReaderType_traverse,         /* tp_traverse */
-    (inquiry)PL_MatrixReaderType_clear,                 /* tp_clear */
+    (traverseproc)PL_ZipperType_traverse,               /* tp_traverse */
+    (inquiry)PL_ZipperType_clear,                       /* tp_clear */
     0,                                                  /* tp_richcompare */
     0,                                                  /* tp_weaklistoffset */
-    (getiterfunc)PL_MatrixReaderType_iter,              /* tp_iter */
-    (iternextfunc)PL_MatrixReaderType_iternext          /* tp_iternext */
+    (getiterfunc)PL_ZipperType_iter,                    /* tp_iter */
+    (iternextfunc)PL_ZipperType_iternext                /* tp_iternext */
 };
 
 /*
- * Create new reader object
- *
- * read is stolen and cleared on error
+ * Create new zipper object
  *
  * Return NULL on error
  */
 static PyObject *
-pl_matrix_reader_new(PyObject *read)
+pl_zipper_new(PyObject *labels, PyObject *vectors)
 {
-    pl_matrix_reader_t *self;
-
-    if (!(self = GENERIC_ALLOC(&PL_MatrixReaderType))) {
-        Py_DECREF(read);
-        return NULL;
-    }
+    pl_zipper_t *self;
 
-    if (!(self->tokread = pl_tokread_iter_new(read))) {
-        Py_DECREF(self);
+    if (!(self = GENERIC_ALLOC(&PL_ZipperType)))
         return NULL;
-    }
 
-    self->state = PL_MATRIX_READER_STATE_ROW;
+    self->vectors = NULL;
+    if (!(self->labels = PyObject_GetIter(labels)))
+        goto error;
+    if (!(self->vectors = PyObject_GetIter(vectors)))
+        goto error;
 
     return (PyObject *)self;
+
+error:
+    Py_DECREF((PyObject *)self);
+    return NULL;
 }
 
-/* --------------------- END MatrixReader DEFINITION --------------------- */
+/* ------------------------ END Zipper DEFINITION ------------------------ */
 
 /* -------------------- BEGIN FeatureMatrix DEFINITION ------------------- */
 
@@ -1197,12 +2051,120 @@ PL_FeatureMatrixType_from_iterables(PyTypeObject *cls, PyObject *args,
     return (PyObject *)self;
 }
 
-#ifdef PL_CROSS_VALIDATE
+PyDoc_STRVAR(PL_FeatureMatrixType_from_csr__doc__,
+"from_csr(cls, indptr, indices, data, labels)\n\
+\n\
+Create `FeatureMatrix` instance from compressed sparse row (CSR) arrays.\n\
+\n\
+The arrays are read through the buffer protocol (e.g. numpy arrays,\n\
+``array.array``, or the ``indptr``, ``indices`` and ``data`` attributes of\n\
+a ``scipy.sparse.csr_matrix``). They need to be one-dimensional and\n\
+contiguous. The features of row ``j`` are\n\
+``indices[indptr[j]:indptr[j + 1]]`` and ``data[indptr[j]:indptr[j + 1]]``.\n\
+``indptr`` starts with ``0`` and ends with ``len(indices)``.\n\
+\n\
+Column indices are zero based. Column ``i`` becomes feature index ``i + 1``.\n\
+The indices of each row must be strictly ascending (as in a\n\
+``scipy.sparse.csr_matrix`` after ``sort_indices()`` and\n\
+``sum_duplicates()``). They are not sorted here. Zero values are skipped.\n\
+\n\
+Parameters:\n\
+  indptr (buffer):\n\
+    Row offsets into `indices` and `data` (integers, ``len(labels) + 1``\n\
+    items)\n\
+\n\
+  indices (buffer):\n\
+    Column indices (integers)\n\
+\n\
+  data (buffer):\n\
+    Feature values (numbers, same length as `indices`)\n\
+\n\
+  labels (buffer):\n\
+    Labels per row (numbers, truncated to integers)\n\
+\n\
+Returns:\n\
+  FeatureMatrix: New feature matrix instance\n\
+\n\
+Raises:\n\
+  TypeError: One of the arguments is not a buffer of numbers\n\
+  ValueError: The arrays are inconsistent or the indices of a row are not\n\
+    strictly ascending");
+
+static PyObject *
+PL_FeatureMatrixType_from_csr(PyTypeObject *cls, PyObject *args,
+                              PyObject *kwds)
+{
+    static char *kwlist[] = {"indptr", "indices", "data", "labels", NULL};
+    PyObject *indptr_, *indices_, *data_, *labels_;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OOOO", kwlist,
+                                     &indptr_, &indices_, &data_, &labels_))
+        return NULL;
+
+    return (PyObject *)pl_matrix_from_csr(cls, indptr_, indices_, data_,
+                                          labels_);
+}
+
+PyDoc_STRVAR(PL_FeatureMatrixType_from_dense__doc__,
+"from_dense(cls, buffer, labels, threshold=None)\n\
+\n\
+Create `FeatureMatrix` instance from a dense two-dimensional buffer.\n\
+\n\
+The buffer is read through the buffer protocol (e.g. a numpy array) and\n\
+needs to be C-contiguous. Each row is a feature vector, column ``i``\n\
+becomes feature index ``i + 1``. Values whose absolute value is not above\n\
+`threshold` are skipped.\n\
+\n\
+Parameters:\n\
+  buffer (buffer):\n\
+    Two-dimensional buffer of numbers (float32 and float64 buffers are\n\
+    scanned fastest)\n\
+\n\
+  labels (buffer):\n\
+    Labels per row (numbers, truncated to integers)\n\
+\n\
+  threshold (float):\n\
+    Values with an absolute value less or equal to the threshold are\n\
+    dropped. If omitted or ``None``, only zeros are dropped.\n\
+\n\
+Returns:\n\
+  FeatureMatrix: New feature matrix instance\n\
+\n\
+Raises:\n\
+  TypeError: One of the arguments is not a buffer of numbers\n\
+  ValueError: The number of labels doesn't match or the threshold is\n\
+    negative");
+
+static PyObject *
+PL_FeatureMatrixType_from_dense(PyTypeObject *cls, PyObject *args,
+                                PyObject *kwds)
+{
+    static char *kwlist[] = {"buffer", "labels", "threshold", NULL};
+    PyObject *buffer_, *labels_, *threshold_ = NULL;
+    double threshold = 0.0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|O", kwlist,
+                                     &buffer_, &labels_, &threshold_))
+        return NULL;
+
+    if (threshold_ && threshold_ != Py_None) {
+        Py_INCREF(threshold_);
+        if (pl_as_double(threshold_, &threshold) == -1)
+            return NULL;
+    }
+
+    return (PyObject *)pl_matrix_from_dense(cls, buffer_, labels_,
+                                            threshold);
+}
+
 PyDoc_STRVAR(PL_FeatureMatrixType_xval__doc__,
-"cross_validate(self, nr_fold, solver=None, bias=None)\n\
+"cross_validate(self, nr_fold, solver=None, bias=None, seed=None)\n\
 \n\
 Run cross-validation of a solver using the matrix instance.\n\
 \n\
+The folds are trained in parallel, using the solver's threads. The GIL is\n\
+released meanwhile.\n\
+\n\
 Parameters:\n\
 \n\
   nr_fold (int):\n\
@@ -1214,6 +2176,12 @@ Parameters:\n\
   bias (float):\n\
     Bias to the hyperplane. Of omitted or ``None``, no bias is applied.\n\
     ``bias >= 0``.\n\
+\n\
+  seed (int):\n\
+    Seed for the random assignment of the rows to the folds and for the\n\
+    solvers' random numbers. The same seed results in the same folds. If\n\
+    omitted or ``None``, the solver's seed is used, so the folds are the\n\
+    same as the ones of `Solver.find_parameters`.\n\
 \n\
 Returns:\n\
   tuple: A tuple of accuracy, mean squared error and squared correlation\n\
@@ -1224,17 +2192,18 @@ Returns:\n\
 static PyObject *
 PL_FeatureMatrixType_xval(pl_matrix_t *self, PyObject *args, PyObject *kwds)
 {
-    static char *kwlist[] = {"nr_fold", "solver", "bias", NULL};
+    static char *kwlist[] = {"nr_fold", "solver", "bias", "seed", NULL};
     struct problem prob;
     struct parameter param;
     pl_eval_t result;
-    PyObject *nr_fold_, *solver_ = NULL, *bias_ = NULL;
+    PyObject *nr_fold_, *solver_ = NULL, *bias_ = NULL, *seed_ = NULL;
     double *target;
     double bias = -1.0;
+    PY_UINT64_T seed = 0;
     int res, nr_fold;
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|OO", kwlist,
-                                     &nr_fold_, &solver_, &bias_))
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|OOO", kwlist,
+                                     &nr_fold_, &solver_, &bias_, &seed_))
         return NULL;
 
     if (bias_ && bias_ != Py_None) {
@@ -1255,15 +2224,20 @@ PL_FeatureMatrixType_xval(pl_matrix_t *self, PyObject *args, PyObject *kwds)
         return NULL;
     }
 
-    if (pl_matrix_as_problem((PyObject *)self, bias, &prob) == -1)
-        return NULL;
+    if (seed_ && seed_ != Py_None) {
+        Py_INCREF(seed_);
+        if (pl_as_seed(seed_, &seed) == -1)
+            return NULL;
+    }
 
-    if (prob.l > 0) {
+    if (self->height > 0) {
         if (pl_solver_as_parameter(solver_, &param) == -1)
             return NULL;
+        if (seed_ && seed_ != Py_None)
+            param.seed = seed;
 
-        if (nr_fold > prob.l) {
-            nr_fold = prob.l;
+        if (nr_fold > self->height) {
+            nr_fold = self->height;
             if (-1 == PyErr_WarnEx(PyExc_UserWarning,
                                    "WARNING: # folds > # data. Will use # "
                                    "folds = # data instead (i.e., "
@@ -1271,13 +2245,24 @@ PL_FeatureMatrixType_xval(pl_matrix_t *self, PyObject *args, PyObject *kwds)
                 return NULL;
         }
 
-        if (!(target = PyMem_Malloc(prob.l * (sizeof *target)))) {
+        if (!(target = PyMem_Malloc(((size_t)self->height)
+                                    * (sizeof *target)))) {
             PyErr_SetNone(PyExc_MemoryError);
             return NULL;
         }
 
+        if (pl_matrix_as_problem((PyObject *)self, bias,
+                                 check_csr_solver(&param), &prob) == -1) {
+            PyMem_Free(target);
+            return NULL;
+        }
+
+        Py_BEGIN_ALLOW_THREADS
         cross_validation(&prob, &param, nr_fold, target);
+        Py_END_ALLOW_THREADS
+
         res = pl_eval(&prob, target, &result);
+        pl_matrix_problem_clear((PyObject *)self, &prob);
         PyMem_Free(target);
         if (res == -1)
             return NULL;
@@ -1288,7 +2273,6 @@ PL_FeatureMatrixType_xval(pl_matrix_t *self, PyObject *args, PyObject *kwds)
     PyErr_SetString(PyExc_ValueError, "Matrix is empty");
     return NULL;
 }
-#endif
 
 PyDoc_STRVAR(PL_FeatureMatrixType_save__doc__,
 "save(self, file)\n\
@@ -1376,7 +2360,7 @@ error_stream:
 
 
 PyDoc_STRVAR(PL_FeatureMatrixType_load__doc__,
-"load(cls, file)\n\
+"load(cls, file, threads=None)\n\
 \n\
 Create `FeatureMatrix` instance from a file.\n\
 \n\
@@ -1397,8 +2381,15 @@ Parameters:\n\
     ``read`` attribute/method, it's treated as readable file stream, as a\n\
     filename otherwise. If it's a stream, the stream is read from the current\n\
     position and remains open after hitting EOF. In case of a filename, the\n\
-    accompanying file is opened in text mode, read from the beginning and\n\
-    closed afterwards.\n\
+    accompanying file is mapped into memory and scanned in place (if it's a\n\
+    regular file) or opened in text mode, read from the beginning and\n\
+    closed afterwards (otherwise).\n\
+\n\
+  threads (int):\n\
+    Number of threads used for parsing. If > 1, the input is split into\n\
+    chunks of lines, which are parsed in parallel. Streams are read\n\
+    completely into memory first in this case. If omitted or ``None``, the\n\
+    input is parsed by a single thread.\n\
 \n\
 Returns:\n\
   FeatureMatrix: New feature matrix instance\n\
@@ -1410,20 +2401,241 @@ Raises:\n\
 static PyObject *
 PL_FeatureMatrixType_load(PyTypeObject *cls, PyObject *args, PyObject *kwds)
 {
-    static char *kwlist[] = {"file", NULL};
-    PyObject *file_, *read_, *reader, *stream_ = NULL, *close_ = NULL;
+    static char *kwlist[] = {"file", "threads", NULL};
+    PyObject *file_, *read_, *map_, *threads_ = NULL, *stream_ = NULL,
+             *close_ = NULL;
+    pl_iter_t *tokread;
     pl_matrix_t *self = NULL;
+    int threads = 1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|O", kwlist,
+                                     &file_, &threads_))
+        return NULL;
+
+    if (threads_ && threads_ != Py_None) {
+        Py_INCREF(threads_);
+        if (pl_as_int(threads_, &threads) == -1)
+            return NULL;
+        if (threads < 1) {
+            PyErr_SetString(PyExc_ValueError, "threads must be > 0");
+            return NULL;
+        }
+    }
+
+    if (pl_attr(file_, "read", &read_) == -1)
+        return NULL;
+
+    if (!read_) {
+        if (pl_file_map(file_, 0, &map_) == -1)
+            return NULL;
+        if (map_)
+            return (PyObject *)pl_matrix_from_map(cls, map_, threads);
+
+        Py_INCREF(file_);
+        stream_ = pl_file_open(file_, "r");
+        Py_DECREF(file_);
+        if (!stream_)
+            return NULL;
+
+        if (pl_attr(stream_, "close", &close_) == -1)
+            goto error_stream;
+
+        if (pl_attr(stream_, "read", &read_) == -1)
+            goto error_close;
+        if (!read_) {
+            PyErr_SetString(PyExc_AssertionError, "File has no read method");
+            goto error_close;
+        }
+    }
+
+    if (threads > 1) {
+        /* Read it all at once and parse the result in place */
+        map_ = PyObject_CallFunction(read_, "()");
+        Py_DECREF(read_);
+        if (!map_)
+            goto error_close;
+        if (PyUnicode_Check(map_)) {
+            read_ = PyUnicode_AsUTF8String(map_);
+            Py_DECREF(map_);
+            if (!(map_ = read_))
+                goto error_close;
+        }
+        self = pl_matrix_from_map(cls, map_, threads);
+    }
+    else {
+        if (!(tokread = pl_tokread_iter_new(read_)))
+            goto error_close;
+
+        self = pl_matrix_from_tokread(cls, tokread);
+        pl_iter_clear(&tokread);
+    }
+
+    /* fall through */
+
+error_close:
+    if (close_) {
+        PyObject *ptype, *pvalue, *ptraceback, *tmp;
+
+        PyErr_Fetch(&ptype, &pvalue, &ptraceback);
+        if ((tmp = PyObject_CallFunction(close_, "()")))
+            Py_DECREF(tmp);
+        else
+            Py_CLEAR(self);
+        if (ptype)
+            PyErr_Restore(ptype, pvalue, ptraceback);
+        Py_DECREF(close_);
+    }
+error_stream:
+    Py_XDECREF(stream_);
+
+    return (PyObject *)self;
+}
+
+PyDoc_STRVAR(PL_FeatureMatrixType_save_binary__doc__,
+"save_binary(self, file)\n\
+\n\
+Save `FeatureMatrix` instance to a file in binary format.\n\
+\n\
+The binary format stores the labels, the row offsets and the feature\n\
+vectors in liblinear's in-memory layout, which allows loading them back\n\
+without parsing (see `load_binary`). The format depends on the platform\n\
+(byte order, type sizes). The files are not meant to be exchanged between\n\
+different platforms.\n\
+\n\
+Note that the exact I/O exceptions depend on the stream passed in.\n\
+\n\
+Parameters:\n\
+  file (file or str):\n\
+    Either a writeable binary stream or a filename. If the passed object\n\
+    provides a ``write`` attribute/method, it's treated as writeable stream,\n\
+    as a filename otherwise. If it's a stream, the stream is written to the\n\
+    current position and remains open when done. In case of a filename, the\n\
+    accompanying file is opened in binary mode, truncated, written from the\n\
+    beginning and closed afterwards.\n\
+\n\
+Raises:\n\
+  IOError: Error writing the file");
+
+static PyObject *
+PL_FeatureMatrixType_save_binary(pl_matrix_t *self, PyObject *args,
+                                 PyObject *kwds)
+{
+    static char *kwlist[] = {"file", NULL};
+    PyObject *file_, *write_, *stream_ = NULL, *close_ = NULL;
+    int res = -1;
 
     if (!PyArg_ParseTupleAndKeywords(args, kwds, "O", kwlist,
                                      &file_))
         return NULL;
 
+    if (pl_attr(file_, "write", &write_) == -1)
+        return NULL;
+
+    if (!write_) {
+        Py_INCREF(file_);
+        stream_ = pl_file_open(file_, "wb");
+        Py_DECREF(file_);
+        if (!stream_)
+            return NULL;
+
+        if (pl_attr(stream_, "close", &close_) == -1)
+            goto error_stream;
+
+        if (pl_attr(stream_, "write", &write_) == -1)
+            goto error_close;
+        if (!write_) {
+            PyErr_SetString(PyExc_AssertionError, "File has no write method");
+            goto error_close;
+        }
+    }
+
+    res = pl_matrix_to_binary(self, write_);
+    /* fall through */
+
+error_close:
+    if (close_) {
+        PyObject *ptype, *pvalue, *ptraceback, *tmp;
+
+        PyErr_Fetch(&ptype, &pvalue, &ptraceback);
+        if ((tmp = PyObject_CallFunction(close_, "()")))
+            Py_DECREF(tmp);
+        else
+            res = -1;
+        if (ptype)
+            PyErr_Restore(ptype, pvalue, ptraceback);
+        Py_DECREF(close_);
+    }
+error_stream:
+    Py_XDECREF(stream_);
+
+    if (res == -1)
+        return NULL;
+
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(PL_FeatureMatrixType_load_binary__doc__,
+"load_binary(cls, file, mmap=True)\n\
+\n\
+Create `FeatureMatrix` instance from a file written by `save_binary`.\n\
+\n\
+Note that the exact I/O exceptions depend on the stream passed in.\n\
+\n\
+Parameters:\n\
+  file (file or str):\n\
+    Either a readable binary stream or a filename. If the passed object\n\
+    provides a ``read`` attribute/method, it's treated as readable file\n\
+    stream, as a filename otherwise. If it's a stream, the stream is read\n\
+    from the current position and remains open after hitting EOF. In case\n\
+    of a filename, the accompanying file is opened in binary mode, read from\n\
+    the beginning and closed afterwards (unless it's mapped, see `mmap`).\n\
+\n\
+  mmap (bool):\n\
+    Map the file into memory and use the feature vectors in place (only\n\
+    applies to regular files passed by name). Only the labels and the row\n\
+    pointers are set up then, the vectors are used from the mapping. The\n\
+    mapping is copy-on-write, the file is never modified (but it must not\n\
+    be changed by others while it's mapped). The feature indexes are\n\
+    validated in both modes, which reads all vectors once.\n\
+    Default: true\n\
+\n\
+Returns:\n\
+  FeatureMatrix: New feature matrix instance\n\
+\n\
+Raises:\n\
+  IOError: Error reading the file\n\
+  ValueError: Error parsing the file");
+
+static PyObject *
+PL_FeatureMatrixType_load_binary(PyTypeObject *cls, PyObject *args,
+                                 PyObject *kwds)
+{
+    static char *kwlist[] = {"file", "mmap", NULL};
+    PyObject *file_, *read_, *data_, *mmap_ = NULL, *stream_ = NULL,
+             *close_ = NULL;
+    pl_matrix_t *self = NULL;
+    int want_mmap = 1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|O", kwlist,
+                                     &file_, &mmap_))
+        return NULL;
+
+    if (mmap_ && (want_mmap = PyObject_IsTrue(mmap_)) == -1)
+        return NULL;
+
     if (pl_attr(file_, "read", &read_) == -1)
         return NULL;
 
     if (!read_) {
+        if (want_mmap) {
+            if (pl_file_map(file_, 1, &data_) == -1)
+                return NULL;
+            if (data_)
+                return (PyObject *)pl_matrix_from_binary(cls, data_, 1);
+        }
+
         Py_INCREF(file_);
-        stream_ = pl_file_open(file_, "r");
+        stream_ = pl_file_open(file_, "rb");
         Py_DECREF(file_);
         if (!stream_)
             return NULL;
@@ -1439,11 +2651,11 @@ PL_FeatureMatrixType_load(PyTypeObject *cls, PyObject *args, PyObject *kwds)
         }
     }
 
-    if (!(reader = pl_matrix_reader_new(read_)))
+    data_ = PyObject_CallFunction(read_, "()");
+    Py_DECREF(read_);
+    if (!data_)
         goto error_close;
-
-    self = pl_matrix_from_iterable(cls, reader, NULL);
-    Py_DECREF(reader);
+    self = pl_matrix_from_binary(cls, data_, 0);
 
     /* fall through */
 
@@ -1494,11 +2706,9 @@ PL_FeatureMatrixType_new(PyTypeObject *cls, PyObject *args, PyObject *kwds);
 #endif
 
 static struct PyMethodDef PL_FeatureMatrixType_methods[] = {
-#ifdef PL_CROSS_VALIDATE
     {"cross_validate",
      EXT_CFUNC(PL_FeatureMatrixType_xval),     METH_KEYWORDS | METH_VARARGS,
      PL_FeatureMatrixType_xval__doc__},
-#endif
 
     {"features",
      EXT_CFUNC(PL_FeatureMatrixType_features), METH_NOARGS,
@@ -1518,6 +2728,18 @@ static struct PyMethodDef PL_FeatureMatrixType_methods[] = {
                                                METH_VARARGS,
      PL_FeatureMatrixType_load__doc__},
 
+    {"save_binary",
+     EXT_CFUNC(PL_FeatureMatrixType_save_binary),
+                                               METH_KEYWORDS | METH_VARARGS,
+     PL_FeatureMatrixType_save_binary__doc__},
+
+    {"load_binary",
+     EXT_CFUNC(PL_FeatureMatrixType_load_binary),
+                                               METH_CLASS    |
+                                               METH_KEYWORDS |
+                                               METH_VARARGS,
+     PL_FeatureMatrixType_load_binary__doc__},
+
     {"from_iterables",
      EXT_CFUNC(PL_FeatureMatrixType_from_iterables),
                                                METH_CLASS    |
@@ -1525,6 +2747,19 @@ static struct PyMethodDef PL_FeatureMatrixType_methods[] = {
                                                METH_VARARGS,
      PL_FeatureMatrixType_from_iterables__doc__},
 
+    {"from_csr",
+     EXT_CFUNC(PL_FeatureMatrixType_from_csr), METH_CLASS    |
+                                               METH_KEYWORDS |
+                                               METH_VARARGS,
+     PL_FeatureMatrixType_from_csr__doc__},
+
+    {"from_dense",
+     EXT_CFUNC(PL_FeatureMatrixType_from_dense),
+                                               METH_CLASS    |
+                                               METH_KEYWORDS |
+                                               METH_VARARGS,
+     PL_FeatureMatrixType_from_dense__doc__},
+
 #ifdef METH_COEXIST
     {"__new__",
      EXT_CFUNC(PL_FeatureMatrixType_new),      METH_COEXIST  |
@@ -1589,15 +2824,29 @@ PL_FeatureMatrixType_clear(pl_matrix_t *self)
     if (self->weakreflist)
         PyObject_ClearWeakRefs((PyObject *)self);
 
-    pl_matrix_clear_vectors(&self->vectors, self->height, self->row_alloc);
+    pl_matrix_clear_vectors(&self->vectors, &self->nodes);
     if ((ptr = self->biased_vectors)) {
         self->biased_vectors = NULL;
+        self->bias = -1.0;
+        self->bias_users = 0;
         PyMem_Free(ptr);
     }
     if ((ptr = self->labels)) {
         self->labels = NULL;
         PyMem_Free(ptr);
     }
+    if ((ptr = self->csr_start)) {
+        self->csr_start = NULL;
+        PyMem_Free(self->csr_value);
+        PyMem_Free(self->csr_index);
+        PyMem_Free(ptr);
+    }
+    if ((ptr = self->cols)) {
+        self->cols = NULL;
+        PyMem_Free(self->col_nodes);
+        PyMem_Free(ptr);
+    }
+    Py_CLEAR(self->map);
 
     return 0;
 }
@@ -1670,18 +2919,20 @@ PyTypeObject PL_FeatureMatrixType = {
 /*
  * Create new PL_FeatureMatrixType
  *
- * vectors and labels are stolen (and free'd on error)
+ * vectors, nodes and labels are stolen (and free'd on error). nodes may be
+ * NULL if the vectors point into memory owned by someone else.
  *
  * Return NULL on error
  */
 static pl_matrix_t *
-pl_matrix_new(PyTypeObject *cls, struct feature_node **vectors, double *labels,
-              int height, int width, int row_alloc)
+pl_matrix_new(PyTypeObject *cls, struct feature_node **vectors,
+              struct feature_node *nodes, double *labels, int height,
+              int width)
 {
     pl_matrix_t *self;
 
     if (!(self = GENERIC_ALLOC(cls))) {
-        pl_matrix_clear_vectors(&vectors, height, row_alloc);
+        pl_matrix_clear_vectors(&vectors, &nodes);
         if (labels)
             PyMem_Free(labels);
         return NULL;
@@ -1689,10 +2940,18 @@ pl_matrix_new(PyTypeObject *cls, struct feature_node **vectors, double *labels,
 
     self->height = height;
     self->width = width;
-    self->row_alloc = row_alloc;
     self->vectors = vectors;
+    self->nodes = nodes;
     self->biased_vectors = NULL;
+    self->bias = -1.0;
+    self->bias_users = 0;
     self->labels = labels;
+    self->csr_index = NULL;
+    self->csr_value = NULL;
+    self->csr_start = NULL;
+    self->cols = NULL;
+    self->col_nodes = NULL;
+    self->map = NULL;
 
     return self;
 }
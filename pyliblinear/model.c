@@ -23,7 +23,7 @@
  */
 typedef struct {
     PyObject *iter;
-    struct feature_node *array;
+    pl_arena_t arena;  /* Holds the current vector only */
     double bias;
     int bias_index;
 } pl_iterable_iter_ctx_t;
@@ -81,26 +81,24 @@ static int
 pl_iter_iterable_next(void *ctx_, void **array_)
 {
     pl_iterable_iter_ctx_t *ctx = ctx_;
+    struct feature_node *array;
     PyObject *vector;
-    int size, max = 0;
 
     if (ctx) {
-        if (ctx->array) {
-            PyMem_Free(ctx->array);
-            ctx->array = NULL;
-        }
+        pl_arena_reset(&ctx->arena);
         if (ctx->iter) {
             if ((vector = PyIter_Next(ctx->iter))) {
-                if (pl_vector_load(vector, &ctx->array, &size, &max) == -1)
+                if (pl_vector_load(vector, 0.0, &ctx->arena) == -1)
                     return -1;
 
+                array = ctx->arena.nodes;
                 if (ctx->bias < 0) {
-                    *array_ = ctx->array + 1;
+                    *array_ = array + 1;
                 }
                 else {
-                    *array_ = ctx->array;
-                    ctx->array[0].value = ctx->bias;
-                    ctx->array[0].index = ctx->bias_index;
+                    *array_ = array;
+                    array[0].value = ctx->bias;
+                    array[0].index = ctx->bias_index;
                 }
                 return 0;
             }
@@ -124,10 +122,7 @@ pl_iter_iterable_clear(void *ctx_)
 
     if (ctx) {
         Py_CLEAR(ctx->iter);
-        if (ctx->array) {
-            PyMem_Free(ctx->array);
-            ctx->array = NULL;
-        }
+        pl_arena_clear(&ctx->arena);
         PyMem_Free(ctx);
     }
 }
@@ -174,7 +169,7 @@ pl_iter_iterable_new(PyObject *iterable, double bias, int max_feature)
     ctx->bias_index = max_feature + 1;
     ctx->bias = bias;
     ctx->iter = iter;
-    ctx->array = NULL;
+    pl_arena_init(&ctx->arena);
 
     if (!(result = pl_iter_new(ctx, pl_iter_iterable_next,
                                pl_iter_iterable_clear,
@@ -219,6 +214,8 @@ pl_iter_matrix_clear(void *ctx_)
     pl_matrix_iter_ctx_t *ctx = ctx_;
 
     if (ctx) {
+        if (ctx->matrix)
+            pl_matrix_problem_clear(ctx->matrix, &ctx->prob);
         Py_CLEAR(ctx->matrix);
         PyMem_Free(ctx);
     }
@@ -258,7 +255,7 @@ pl_iter_matrix_new(PyObject *matrix, double bias)
         goto error_matrix;
     }
 
-    if (pl_matrix_as_problem(matrix, bias, &ctx->prob) == -1)
+    if (pl_matrix_as_problem(matrix, bias, 0, &ctx->prob) == -1)
         goto error_ctx;
 
     ctx->matrix = matrix;
@@ -266,9 +263,11 @@ pl_iter_matrix_new(PyObject *matrix, double bias)
 
     if (!(result = pl_iter_new(ctx, pl_iter_matrix_next, pl_iter_matrix_clear,
                                pl_iter_matrix_visit)))
-        goto error_ctx;
+        goto error_prob;
     return result;
 
+error_prob:
+    pl_matrix_problem_clear(matrix, &ctx->prob);
 error_ctx:
     PyMem_Free(ctx);
 
@@ -333,7 +332,7 @@ pl_model_to_stream(pl_model_t *self, PyObject *write)
     char intbuf[PL_INT_AS_CHAR_BUF_SIZE];
     int h, w, res, cols, rows;
 
-    if (!(buf = pl_bufwriter_new(write)))
+    if (!(buf = pl_bufwriter_new(write, 0)))
         return -1;
 
 #define WRITE_STR(str) do {                     \
@@ -535,18 +534,17 @@ error_mmap:
 #endif
 
 /*
- * Create model from stream
+ * Create model from token reader
  *
- * Reference to read is stolen.
+ * tokread is cleared.
  *
  * Return NULL on error
  */
 static pl_model_t *
-pl_model_from_stream(PyTypeObject *cls, PyObject *read, int want_mmap)
+pl_model_from_tokread(PyTypeObject *cls, pl_iter_t *tokread, int want_mmap)
 {
     PyObject *tmp, *mmap_ = NULL;
     pl_tok_t *tok;
-    pl_iter_t *tokread;
     struct model *model;
     char *end;
     void *vh;
@@ -554,9 +552,6 @@ pl_model_from_stream(PyTypeObject *cls, PyObject *read, int want_mmap)
     long longint;
     int res, h, w, cols, rows, seen = 0;
 
-    if (!(tokread = pl_tokread_iter_new(read)))
-        return NULL;
-
     if (!(model = malloc(sizeof *model))) {
         PyErr_SetNone(PyExc_MemoryError);
         goto error_tokread;
@@ -564,6 +559,8 @@ pl_model_from_stream(PyTypeObject *cls, PyObject *read, int want_mmap)
     model->label = NULL;
     model->w = NULL;
     model->rho = 0;
+    model->converged = 1;
+    model->stats = NULL;
 
     /* Not used, but be on the safe side here: */
     model->param.C = -1.0;
@@ -572,6 +569,8 @@ pl_model_from_stream(PyTypeObject *cls, PyObject *read, int want_mmap)
     model->param.nr_weight = 0;
     model->param.weight = NULL;
     model->param.weight_label = NULL;
+    model->param.cancel = NULL;
+    model->param.stats = 0;
 
 #define EXPECT_TOK do {                                       \
     if (pl_iter_next(tokread, &vh) == -1) goto error_model;   \
@@ -585,17 +584,20 @@ pl_model_from_stream(PyTypeObject *cls, PyObject *read, int want_mmap)
 
 #define TOK(str) !strncmp(tok->start, (str), (size_t)(tok->sentinel - tok->start))
 
-#define LOAD_DOUBLE(target) do {                                 \
-    EXPECT_TOK;                                                  \
-    longfloat = PyOS_string_to_double(tok->start, &end,          \
-                                      PyExc_OverflowError);      \
-    if (longfloat == -1.0 && PyErr_Occurred()) goto error_model; \
-    if (end != tok->sentinel) goto error_format;                 \
-    target = longfloat;                                          \
+#define LOAD_DOUBLE(target) do {                                        \
+    EXPECT_TOK;                                                         \
+    if (pl_parse_double(tok->start, tok->sentinel, &longfloat) == -1) { \
+        longfloat = PyOS_string_to_double(tok->start, &end,             \
+                                          PyExc_OverflowError);         \
+        if (longfloat == -1.0 && PyErr_Occurred()) goto error_model;    \
+        if (end != tok->sentinel) goto error_format;                    \
+    }                                                                   \
+    target = longfloat;                                                 \
 } while(0)
 
 #define LOAD_INT(min, target) do {                             \
     EXPECT_TOK;                                                \
+    errno = 0;                                                 \
     longint = PyOS_strtol(tok->start, &end, 10);               \
     if (errno || end != tok->sentinel || longint < (long)(min) \
         || longint > (long)INT_MAX)                            \
@@ -765,6 +767,237 @@ error_tokread:
 #undef SEEN_SOLVER_TYPE
 
 
+/*
+ * Transform the matrix into a problem for training with param
+ *
+ * The structure-of-arrays layout is only created for the solvers reading
+ * it. The L1R solvers get the transposed vectors instead, which are kept
+ * with the matrix (see pl_matrix_problem_cols).
+ *
+ * Return -1 on error
+ */
+static int
+pl_model_problem(PyObject *matrix, double bias, const struct parameter *param,
+                 struct problem *prob)
+{
+    if (pl_matrix_as_problem(matrix, bias, check_csr_solver(param), prob)
+        == -1)
+        return -1;
+
+    if (param->solver_type == L1R_L2LOSS_SVC
+        || param->solver_type == L1R_LR) {
+        if (pl_matrix_problem_cols(matrix, param->nr_thread, prob) == -1) {
+            pl_matrix_problem_clear(matrix, prob);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/*
+ * Create the initial solution for training prob from a model (warm start)
+ *
+ * The model's classes are mapped by label to the class order train() is
+ * going to use for prob (order of appearance, +1 first for -1/+1 problems).
+ * Features (and the bias) unknown to the model start at zero.
+ *
+ * init_sol is allocated with PyMem_Malloc.
+ *
+ * Return -1 on error
+ */
+static int
+pl_model_init_sol(PyObject *init_, const struct problem *prob,
+                  const struct parameter *param, double **init_sol_)
+{
+    struct model *model;
+    double *init_sol;
+    double sign;
+    int *cols, *labels;
+    int nr_class, nr_w, model_nr_w, width, model_n, label, col, idx, j, k;
+
+    if (!PL_ModelType_CheckExact(init_) && !PL_ModelType_Check(init_)) {
+        PyErr_SetString(PyExc_TypeError,
+                        "init must be a " EXT_MODULE_PATH ".Model instance.");
+        return -1;
+    }
+    model = ((pl_model_t *)init_)->model;
+
+    switch (param->solver_type) {
+    case L2R_LR: case L2R_L2LOSS_SVC: case L2R_L2LOSS_SVR:
+        break;
+    default:
+        PyErr_SetString(PyExc_ValueError,
+                        "init is supported only for L2R_LR, L2R_L2LOSS_SVC "
+                        "and L2R_L2LOSS_SVR");
+        return -1;
+    }
+
+    if (check_oneclass_model(model)
+        || !check_regression_model(model)
+            != (param->solver_type != L2R_L2LOSS_SVR)) {
+        PyErr_SetString(PyExc_ValueError,
+                        "init model doesn't match the solver type");
+        return -1;
+    }
+
+    width = prob->bias >= 0 ? prob->n - 1 : prob->n;
+    if (model->nr_feature > width) {
+        PyErr_SetString(PyExc_ValueError,
+                        "init model has more features than the matrix");
+        return -1;
+    }
+    model_n = model->bias >= 0 ? model->nr_feature + 1 : model->nr_feature;
+    model_nr_w = (model->nr_class == 2
+                  && model->param.solver_type != MCSVM_CS)
+                 ? 1 : model->nr_class;
+
+    /* Model column of each class, in train()'s order */
+    if (!(cols = PyMem_Malloc(((size_t)model->nr_class + 1)
+                              * (sizeof *cols)))) {
+        PyErr_SetNone(PyExc_MemoryError);
+        return -1;
+    }
+    if (!(labels = PyMem_Malloc(((size_t)model->nr_class + 1)
+                                * (sizeof *labels)))) {
+        PyErr_SetNone(PyExc_MemoryError);
+        goto error_cols;
+    }
+
+    if (check_regression_model(model)) {
+        nr_class = 1;
+        cols[0] = 0;
+    }
+    else {
+        nr_class = 0;
+        for (j = 0; j < prob->l; ++j) {
+            label = (int)prob->y[j];
+            for (k = nr_class; k > 0 && labels[k - 1] != label; --k)
+                ;
+            if (k)
+                continue;
+
+            for (k = 0; k < model->nr_class && model->label[k] != label; ++k)
+                ;
+            if (!(k < model->nr_class)) {
+                PyErr_Format(PyExc_ValueError,
+                             "init model doesn't know label %d", label);
+                goto error_labels;
+            }
+            labels[nr_class] = label;
+            cols[nr_class++] = k;
+        }
+        if (nr_class == 2 && labels[0] == -1 && labels[1] == 1) {
+            k = cols[0];
+            cols[0] = cols[1];
+            cols[1] = k;
+        }
+    }
+    nr_w = nr_class == 2 ? 1 : nr_class;
+
+    if (!(init_sol = PyMem_Malloc(((size_t)prob->n) * ((size_t)nr_w)
+                                  * (sizeof *init_sol)))) {
+        PyErr_SetNone(PyExc_MemoryError);
+        goto error_labels;
+    }
+
+    for (col = 0; col < nr_w; ++col) {
+        /* Binary models only know the first class' column */
+        k = cols[col];
+        sign = 1.0;
+        if (model_nr_w == 1 && k == 1) {
+            k = 0;
+            sign = -1.0;
+        }
+
+        for (j = 0; j < prob->n; ++j) {
+            if (j < width)
+                idx = j < model->nr_feature ? j : -1;
+            else
+                idx = model->bias >= 0 ? model_n - 1 : -1;
+
+            init_sol[j * nr_w + col] = idx < 0 ? 0.0
+                : sign * model->w[idx * model_nr_w + k];
+        }
+    }
+
+    PyMem_Free(labels);
+    PyMem_Free(cols);
+    *init_sol_ = init_sol;
+    return 0;
+
+error_labels:
+    PyMem_Free(labels);
+error_cols:
+    PyMem_Free(cols);
+    return -1;
+}
+
+
+/*
+ * Compare two doubles (for qsort)
+ */
+static int
+pl_double_cmp(const void *a_, const void *b_)
+{
+    double a = *(const double *)a_, b = *(const double *)b_;
+
+    return (a > b) - (a < b);
+}
+
+
+/*
+ * Load the C values for Model.train_path, sorted ascending
+ *
+ * C is allocated with PyMem_Malloc.
+ *
+ * Return -1 on error
+ */
+static int
+pl_model_load_Cs(PyObject *Cs_, double **C_, int *nr_C_)
+{
+    PyObject *seq, *item;
+    double *C;
+    Py_ssize_t size, j;
+
+    if (!(seq = PySequence_Fast(Cs_, "Cs must be iterable")))
+        return -1;
+
+    if ((size = PySequence_Fast_GET_SIZE(seq)) > (Py_ssize_t)INT_MAX) {
+        PyErr_SetString(PyExc_OverflowError, "Too many C values");
+        goto error_seq;
+    }
+    if (!(C = PyMem_Malloc(((size_t)size + 1) * (sizeof *C)))) {
+        PyErr_SetNone(PyExc_MemoryError);
+        goto error_seq;
+    }
+
+    for (j = 0; j < size; ++j) {
+        item = PySequence_Fast_GET_ITEM(seq, j);
+        Py_INCREF(item);
+        if (pl_as_double(item, &C[j]) == -1)
+            goto error_C;
+        if (!(C[j] > 0)) {
+            PyErr_SetString(PyExc_ValueError, "C must be > 0");
+            goto error_C;
+        }
+    }
+    Py_DECREF(seq);
+
+    qsort(C, (size_t)size, sizeof *C, pl_double_cmp);
+    *C_ = C;
+    *nr_C_ = (int)size;
+    return 0;
+
+error_C:
+    PyMem_Free(C);
+error_seq:
+    Py_DECREF(seq);
+    return -1;
+}
+
+
 /* ------------------------- END Helper Functions ------------------------ */
 
 /* ------------------- BEGIN PredictIterator DEFINITION ------------------ */
@@ -963,8 +1196,63 @@ pl_model_new(PyTypeObject *cls, struct model *model, PyObject *mmap_)
 }
 
 
+/*
+ * Training run of Model.train, executed by pl_parallel_run_interruptible
+ */
+typedef struct {
+    struct problem *prob;
+    struct parameter *param;
+    struct model *model;
+} pl_model_train_t;
+
+static void
+pl_model_train_worker(void *job_, int j, int threads)
+{
+    pl_model_train_t *job = job_;
+
+    job->model = train(job->prob, job->param);
+}
+
+
+/*
+ * Training runs of Model.train_path
+ */
+typedef struct {
+    struct problem *prob;
+    struct parameter *param;
+    double *C;
+    struct model **models;
+    int nr_C;
+} pl_model_train_path_t;
+
+static void
+pl_model_train_path_worker(void *job_, int j, int threads)
+{
+    pl_model_train_path_t *job = job_;
+
+    train_path(job->prob, job->param, job->nr_C, job->C, job->models);
+}
+
+
+/*
+ * Find the cancel flag to train with
+ *
+ * Return NULL on error
+ */
+static volatile int *
+pl_model_cancel(PyObject *cancel_, volatile int *local)
+{
+    if (cancel_ && cancel_ != Py_None)
+        return pl_cancel_flag(cancel_);
+
+    *local = 0;
+    return local;
+}
+
+
 PyDoc_STRVAR(PL_ModelType_train__doc__,
-"train(cls, matrix, solver=None, bias=None)\n\
+"train(cls, matrix, solver=None, bias=None, init=None, cancel=None,\n\
+      stats=False)\n\
 \n\
 Create model instance from a training run\n\
 \n\
@@ -978,21 +1266,55 @@ Parameters:\n\
   bias (float):\n\
     Bias to the hyperplane. Of omitted or ``None``, no bias is applied.\n\
     ``bias >= 0``.\n\
+\n\
+  init (pyliblinear.Model):\n\
+    Model to start the training from (warm start), for example a model\n\
+    trained on slightly different data before. Only supported by the\n\
+    ``L2R_LR``, ``L2R_L2LOSS_SVC`` and ``L2R_L2LOSS_SVR`` solvers. The\n\
+    classes are matched by label, so the model has to know all labels of\n\
+    the matrix. It may have fewer features than the matrix, but not more.\n\
+    If omitted or ``None``, the training starts from zero.\n\
+\n\
+  cancel (pyliblinear.Cancel):\n\
+    Handle to stop the training early (from another thread). The solver\n\
+    returns the model as trained so far, which is marked as not\n\
+    converged (`Model.converged`). A ``KeyboardInterrupt`` during the\n\
+    training stops it, too, and is raised after the solver has returned.\n\
+    If omitted or ``None``, only the ``KeyboardInterrupt`` can stop it.\n\
+\n\
+  stats (bool):\n\
+    Record the progress of the solvers (`Model.stats`)? Default: false\n\
 \n\
 Returns:\n\
-  Model: New model instance");
+  Model: New model instance\n\
+\n\
+Raises:\n\
+  ValueError: Some invalid parameter or an incompatible init model");
 
 static PyObject *
 PL_ModelType_train(PyTypeObject *cls, PyObject *args, PyObject *kwds)
 {
-    static char *kwlist[] = {"matrix", "solver", "bias", NULL};
+    static char *kwlist[] = {"matrix", "solver", "bias", "init", "cancel",
+                             "stats", NULL};
     struct problem prob;
     struct parameter param;
-    PyObject *matrix_, *solver_ = NULL, *bias_ = NULL;
+    pl_model_train_t job;
+    PyObject *matrix_, *solver_ = NULL, *bias_ = NULL, *init_ = NULL,
+             *cancel_ = NULL, *stats_ = NULL;
+    volatile int *cancel, local_cancel;
+    double *init_sol = NULL;
     double bias = -1.0;
+    int res, stats = 0;
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|OO", kwlist,
-                                     &matrix_, &solver_, &bias_))
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|OOOOO", kwlist,
+                                     &matrix_, &solver_, &bias_, &init_,
+                                     &cancel_, &stats_))
+        return NULL;
+
+    if (stats_ && (stats = PyObject_IsTrue(stats_)) == -1)
+        return NULL;
+
+    if (!(cancel = pl_model_cancel(cancel_, &local_cancel)))
         return NULL;
 
     if (bias_ && bias_ != Py_None) {
@@ -1005,13 +1327,195 @@ PL_ModelType_train(PyTypeObject *cls, PyObject *args, PyObject *kwds)
         }
     }
 
-    if (pl_matrix_as_problem(matrix_, bias, &prob) == -1)
+    if (pl_solver_as_parameter(solver_, &param) == -1)
+        return NULL;
+    param.cancel = cancel;
+    param.stats = stats;
+
+    if (pl_model_problem(matrix_, bias, &param, &prob) == -1)
         return NULL;
 
+    if (init_ && init_ != Py_None) {
+        if (pl_model_init_sol(init_, &prob, &param, &init_sol) == -1) {
+            pl_matrix_problem_clear(matrix_, &prob);
+            return NULL;
+        }
+        param.init_sol = init_sol;
+    }
+
+    /*
+     * The matrix, the solver and the cancel handle are immutable (apart
+     * from the flag) and kept alive by args, so other threads may run (and
+     * train on the same matrix) meanwhile.
+     */
+    job.prob = &prob;
+    job.param = &param;
+    res = pl_parallel_run_interruptible(pl_model_train_worker, &job, cancel);
+
+    /* train() copied the parameters */
+    job.model->param.init_sol = NULL;
+    job.model->param.cancel = NULL;
+    PyMem_Free(init_sol);
+    pl_matrix_problem_clear(matrix_, &prob);
+
+    if (res == -1) {
+        free_and_destroy_model(&job.model);
+        return NULL;
+    }
+
+    return (PyObject *)pl_model_new(cls, job.model, NULL);
+}
+
+PyDoc_STRVAR(PL_ModelType_train_path__doc__,
+"train_path(cls, matrix, solver, Cs, bias=None, init=None, cancel=None,\n\
+           stats=False)\n\
+\n\
+Create model instances for a sequence of C values (regularization path)\n\
+\n\
+The models are trained by ascending C. The matrix is prepared for the\n\
+solver only once for all of them. The ``L2R_LR``, ``L2R_L2LOSS_SVC`` and\n\
+``L2R_L2LOSS_SVR`` solvers start from the previous model's solution (warm\n\
+start). The GIL is released during the training.\n\
+\n\
+Parameters:\n\
+  matrix (pyliblinear.FeatureMatrix):\n\
+    Feature matrix to use for training\n\
+\n\
+  solver (pyliblinear.Solver):\n\
+    Solver instance. If ``None``, a default solver is picked. The solver's\n\
+    C is ignored.\n\
+\n\
+  Cs (iterable):\n\
+    The C values (floats). ``C > 0``.\n\
+\n\
+  bias (float):\n\
+    Bias to the hyperplane. Of omitted or ``None``, no bias is applied.\n\
+    ``bias >= 0``.\n\
+\n\
+  init (pyliblinear.Model):\n\
+    Model to start the training of the smallest C from. See\n\
+    `Model.train` for details. If omitted or ``None``, the training starts\n\
+    from zero.\n\
+\n\
+  cancel (pyliblinear.Cancel):\n\
+    Handle to stop the training early. The current model is returned as\n\
+    trained so far, the remaining ones are not trained beyond their\n\
+    starting point. All of them are marked as not converged. See\n\
+    `Model.train` for details.\n\
+\n\
+  stats (bool):\n\
+    Record the progress of the solvers (`Model.stats`)? The rows are\n\
+    prepared only once, the time is reported by the first model.\n\
+    Default: false\n\
+\n\
+Returns:\n\
+  list: List of ``(C, Model)`` tuples, sorted by C\n\
+\n\
+Raises:\n\
+  ValueError: Some invalid parameter or an incompatible init model");
+
+static PyObject *
+PL_ModelType_train_path(PyTypeObject *cls, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"matrix", "solver", "Cs", "bias", "init",
+                             "cancel", "stats", NULL};
+    struct problem prob;
+    struct parameter param;
+    pl_model_train_path_t job;
+    PyObject *matrix_, *solver_, *Cs_, *bias_ = NULL, *init_ = NULL,
+             *cancel_ = NULL, *stats_ = NULL;
+    PyObject *result, *item;
+    struct model **models;
+    volatile int *cancel, local_cancel;
+    double *C, *init_sol = NULL;
+    double bias = -1.0;
+    int j, nr_C, res, stats = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OOO|OOOO", kwlist,
+                                     &matrix_, &solver_, &Cs_, &bias_,
+                                     &init_, &cancel_, &stats_))
+        return NULL;
+
+    if (stats_ && (stats = PyObject_IsTrue(stats_)) == -1)
+        return NULL;
+
+    if (!(cancel = pl_model_cancel(cancel_, &local_cancel)))
+        return NULL;
+
+    if (bias_ && bias_ != Py_None) {
+        Py_INCREF(bias_);
+        if (pl_as_double(bias_, &bias) == -1)
+            return NULL;
+        if (bias < 0) {
+            PyErr_SetString(PyExc_ValueError, "bias must be >= 0");
+            return NULL;
+        }
+    }
+
     if (pl_solver_as_parameter(solver_, &param) == -1)
         return NULL;
+    param.cancel = cancel;
+    param.stats = stats;
+
+    if (pl_model_load_Cs(Cs_, &C, &nr_C) == -1)
+        return NULL;
+
+    if (!(models = PyMem_Malloc(((size_t)nr_C + 1) * (sizeof *models)))) {
+        PyErr_SetNone(PyExc_MemoryError);
+        goto error_C;
+    }
+
+    if (pl_model_problem(matrix_, bias, &param, &prob) == -1)
+        goto error_models;
+
+    if (init_ && init_ != Py_None) {
+        if (pl_model_init_sol(init_, &prob, &param, &init_sol) == -1) {
+            pl_matrix_problem_clear(matrix_, &prob);
+            goto error_models;
+        }
+        param.init_sol = init_sol;
+    }
+
+    job.prob = &prob;
+    job.param = &param;
+    job.C = C;
+    job.models = models;
+    job.nr_C = nr_C;
+    res = pl_parallel_run_interruptible(pl_model_train_path_worker, &job,
+                                        cancel);
+
+    for (j = 0; j < nr_C; ++j)
+        models[j]->param.cancel = NULL;
+    PyMem_Free(init_sol);
+    pl_matrix_problem_clear(matrix_, &prob);
+
+    j = 0;
+    if (res == -1 || !(result = PyList_New(nr_C)))
+        goto error_trained;
+
+    for (j = 0; j < nr_C; ++j) {
+        item = (PyObject *)pl_model_new(cls, models[j], NULL);
+        if (!item || !(item = Py_BuildValue("(dN)", C[j], item))) {
+            ++j;
+            goto error_result;
+        }
+        PyList_SET_ITEM(result, j, item);
+    }
 
-    return (PyObject *)pl_model_new(cls, train(&prob, &param), NULL);
+    PyMem_Free(models);
+    PyMem_Free(C);
+    return result;
+
+error_result:
+    Py_DECREF(result);
+error_trained:
+    for (; j < nr_C; ++j)
+        free_and_destroy_model(&models[j]);
+error_models:
+    PyMem_Free(models);
+error_C:
+    PyMem_Free(C);
+    return NULL;
 }
 
 PyDoc_STRVAR(PL_ModelType_load__doc__,
@@ -1028,8 +1532,9 @@ Parameters:\n\
     ``read`` attribute/method, it's treated as readable file stream, as a\n\
     filename otherwise. If it's a stream, the stream is read from the current\n\
     position and remains open after hitting EOF. In case of a filename, the\n\
-    accompanying file is opened in text mode, read from the beginning and\n\
-    closed afterwards.\n\
+    accompanying file is mapped into memory and scanned in place (if it's a\n\
+    regular file) or opened in text mode, read from the beginning and\n\
+    closed afterwards (otherwise).\n\
 \n\
   mmap (bool):\n\
     Load the model into a file-backed memory area? Default: false\n\
@@ -1045,7 +1550,9 @@ static PyObject *
 PL_ModelType_load(PyTypeObject *cls, PyObject *args, PyObject *kwds)
 {
     static char *kwlist[] = {"file", "mmap", NULL};
-    PyObject *file_, *read_, *stream_ = NULL, *close_ = NULL, *mmap_ = NULL;
+    PyObject *file_, *read_, *map_, *stream_ = NULL, *close_ = NULL;
+    PyObject *mmap_ = NULL;
+    pl_iter_t *tokread;
     pl_model_t *self = NULL;
     int want_mmap = 0;
 
@@ -1060,6 +1567,15 @@ PL_ModelType_load(PyTypeObject *cls, PyObject *args, PyObject *kwds)
         return NULL;
 
     if (!read_) {
+        if (pl_file_map(file_, 0, &map_) == -1)
+            return NULL;
+        if (map_) {
+            if (!(tokread = pl_tokread_iter_map_new(map_)))
+                return NULL;
+
+            return (PyObject *)pl_model_from_tokread(cls, tokread, want_mmap);
+        }
+
         Py_INCREF(file_);
         stream_ = pl_file_open(file_, "r");
         Py_DECREF(file_);
@@ -1077,7 +1593,10 @@ PL_ModelType_load(PyTypeObject *cls, PyObject *args, PyObject *kwds)
         }
     }
 
-    self = pl_model_from_stream(cls, read_, want_mmap);
+    if (!(tokread = pl_tokread_iter_new(read_)))
+        goto error_close;
+
+    self = pl_model_from_tokread(cls, tokread, want_mmap);
 
     /* fall through */
 
@@ -1242,6 +1761,12 @@ static struct PyMethodDef PL_ModelType_methods[] = {
                                               METH_VARARGS,
      PL_ModelType_train__doc__},
 
+    {"train_path",
+     EXT_CFUNC(PL_ModelType_train_path),      METH_CLASS    |
+                                              METH_KEYWORDS |
+                                              METH_VARARGS,
+     PL_ModelType_train_path__doc__},
+
     {"load",
      EXT_CFUNC(PL_ModelType_load),            METH_CLASS    |
                                               METH_KEYWORDS |
@@ -1259,6 +1784,24 @@ static struct PyMethodDef PL_ModelType_methods[] = {
     {NULL, NULL}  /* Sentinel */
 };
 
+PyDoc_STRVAR(PL_ModelType_converged_doc,
+"Did the solver converge?\n\
+\n\
+False if the training was stopped early by the solver's ``max_iter`` or\n\
+``time_limit`` or by a `Cancel` handle. Loaded models are always\n\
+considered converged.\n\
+\n\
+:Type: ``bool``");
+
+static PyObject *
+PL_ModelType_converged_get(pl_model_t *self, void *closure)
+{
+    if (self->model->converged)
+        Py_RETURN_TRUE;
+
+    Py_RETURN_FALSE;
+}
+
 PyDoc_STRVAR(PL_ModelType_is_oneclass_doc,
 "Is model a oneclass SVM model?\n\
 \n\
@@ -1359,7 +1902,240 @@ PL_ModelType_rho_get(pl_model_t *self, void *closure)
     return PyFloat_FromDouble(self->model->rho);
 }
 
+/*
+ * Set dict[key] = value and drop the value
+ *
+ * Return -1 on error (also if value is NULL)
+ */
+static int
+pl_model_stats_set(PyObject *dict, const char *key, PyObject *value)
+{
+    int res;
+
+    if (!value)
+        return -1;
+
+    res = PyDict_SetItemString(dict, key, value);
+    Py_DECREF(value);
+    return res;
+}
+
+
+/*
+ * Convert a statistics value, None if unknown (NaN or -1)
+ *
+ * Return NULL on error
+ */
+static PyObject *
+pl_model_stats_double(double value)
+{
+    if (Py_IS_NAN(value))
+        Py_RETURN_NONE;
+
+    return PyFloat_FromDouble(value);
+}
+
+#ifdef EXT3
+#define PyInt_FromLong PyLong_FromLong
+#endif
+static PyObject *
+pl_model_stats_int(int value)
+{
+    if (value == -1)
+        Py_RETURN_NONE;
+
+    return PyInt_FromLong(value);
+}
+#ifdef EXT3
+#undef PyInt_FromLong
+#endif
+
+
+/*
+ * Convert the iterations of a solver run into a list of dicts
+ *
+ * Return NULL on error
+ */
+static PyObject *
+pl_model_stats_iterations(const struct train_run_stats *run)
+{
+    const struct train_iter_stats *it;
+    PyObject *result, *item;
+    int j;
+
+    if (!(result = PyList_New(run->nr_iter)))
+        return NULL;
+
+    for (j = 0; j < run->nr_iter; ++j) {
+        it = &run->iter[j];
+        if (!(item = PyDict_New()))
+            goto error;
+        PyList_SET_ITEM(result, j, item);
+
+        if (-1 == pl_model_stats_set(item, "iter",
+                                     pl_model_stats_int(it->iter))
+            || -1 == pl_model_stats_set(item, "time",
+                                        pl_model_stats_double(it->time))
+            || -1 == pl_model_stats_set(item, "f",
+                                        pl_model_stats_double(it->f))
+            || -1 == pl_model_stats_set(item, "violation",
+                                        pl_model_stats_double(
+                                            it->violation))
+            || -1 == pl_model_stats_set(item, "step_size",
+                                        pl_model_stats_double(
+                                            it->step_size))
+            || -1 == pl_model_stats_set(item, "inner_iter",
+                                        pl_model_stats_int(it->inner_iter))
+            || -1 == pl_model_stats_set(item, "line_search",
+                                        pl_model_stats_int(
+                                            it->line_search))
+            || -1 == pl_model_stats_set(item, "active_size",
+                                        pl_model_stats_int(
+                                            it->active_size)))
+            goto error;
+    }
+
+    return result;
+
+error:
+    Py_DECREF(result);
+    return NULL;
+}
+
+
+/*
+ * Convert a solver run into a dict
+ *
+ * Return NULL on error
+ */
+#ifdef EXT3
+#define PyString_FromString PyUnicode_FromString
+#endif
+static PyObject *
+pl_model_stats_run(const struct model *model,
+                   const struct train_run_stats *run)
+{
+    PyObject *result, *label;
+    const char *name;
+
+    if (!(name = pl_solver_name(run->solver_type))) {
+        PyErr_SetString(PyExc_AssertionError,
+                        "Solver type unknown. This should not happen (TM).");
+        return NULL;
+    }
+
+    if (!(result = PyDict_New()))
+        return NULL;
+
+    if (run->cls >= 0) {
+        label = PyFloat_FromDouble((double)model->label[run->cls]);
+    }
+    else {
+        Py_INCREF(Py_None);
+        label = Py_None;
+    }
+
+    if (-1 == pl_model_stats_set(result, "label", label)
+        || -1 == pl_model_stats_set(result, "solver_type",
+                                    PyString_FromString(name))
+        || -1 == pl_model_stats_set(result, "time",
+                                    PyFloat_FromDouble(run->time))
+        || -1 == pl_model_stats_set(result, "objective",
+                                    pl_model_stats_double(run->objective))
+        || -1 == pl_model_stats_set(result, "Xv_time",
+                                    PyFloat_FromDouble(run->Xv_time))
+        || -1 == pl_model_stats_set(result, "XTv_time",
+                                    PyFloat_FromDouble(run->XTv_time))
+        || -1 == pl_model_stats_set(result, "Hv_time",
+                                    PyFloat_FromDouble(run->Hv_time))
+        || -1 == pl_model_stats_set(result, "Xv_calls",
+                                    pl_model_stats_int(run->nr_Xv))
+        || -1 == pl_model_stats_set(result, "XTv_calls",
+                                    pl_model_stats_int(run->nr_XTv))
+        || -1 == pl_model_stats_set(result, "Hv_calls",
+                                    pl_model_stats_int(run->nr_Hv))
+        || -1 == pl_model_stats_set(result, "iterations",
+                                    pl_model_stats_iterations(run))) {
+        Py_DECREF(result);
+        return NULL;
+    }
+
+    return result;
+}
+#ifdef EXT3
+#undef PyString_FromString
+#endif
+
+PyDoc_STRVAR(PL_ModelType_stats_doc,
+"Progress of the training (if trained with ``stats=True``)\n\
+\n\
+A dict with the wall clock seconds spent preparing the rows\n\
+(``prepare_time``) and in the solvers (``solve_time``) and the solver\n\
+runs (``runs``), in order of the classes. There's one run per\n\
+one-vs-rest class, and a second one if a dual solver falls back to the\n\
+primal one. Each run is a dict with:\n\
+\n\
+- ``solver_type``, ``label`` (of the one-vs-rest class or ``None``),\n\
+  ``time`` and the final ``objective`` value\n\
+- ``Xv_time``, ``XTv_time`` and ``Hv_time``: seconds spent in the\n\
+  ``X v``, ``X^T v`` and Hessian-vector products of the primal newton\n\
+  solvers, and the number of them (``Xv_calls`` etc.)\n\
+- ``iterations``: a dict per outer iteration with ``iter``, ``time``\n\
+  (since the start of the run), ``f`` (objective value, newton solvers),\n\
+  ``violation`` (gradient norm for newton, the stopping measure of the\n\
+  coordinate descent solvers otherwise), ``step_size`` and\n\
+  ``line_search`` (function evaluations of the line search),\n\
+  ``inner_iter`` (CG steps or inner iterations) and ``active_size``\n\
+  (variables left after shrinking). Values a solver doesn't know are\n\
+  ``None``.\n\
+\n\
+``None`` if the model was trained without ``stats`` or loaded.\n\
+\n\
+:Type: ``dict``");
+
+static PyObject *
+PL_ModelType_stats_get(pl_model_t *self, void *closure)
+{
+    const struct train_stats *stats = self->model->stats;
+    PyObject *result, *runs, *run;
+    int j;
+
+    if (!stats)
+        Py_RETURN_NONE;
+
+    if (!(runs = PyList_New(stats->nr_run)))
+        return NULL;
+    for (j = 0; j < stats->nr_run; ++j) {
+        if (!(run = pl_model_stats_run(self->model, &stats->run[j]))) {
+            Py_DECREF(runs);
+            return NULL;
+        }
+        PyList_SET_ITEM(runs, j, run);
+    }
+
+    if (!(result = PyDict_New())) {
+        Py_DECREF(runs);
+        return NULL;
+    }
+    if (-1 == pl_model_stats_set(result, "runs", runs)
+        || -1 == pl_model_stats_set(result, "prepare_time",
+                                    PyFloat_FromDouble(stats->prepare_time))
+        || -1 == pl_model_stats_set(result, "solve_time",
+                                    PyFloat_FromDouble(stats->solve_time))) {
+        Py_DECREF(result);
+        return NULL;
+    }
+
+    return result;
+}
+
 static PyGetSetDef PL_ModelType_getset[] = {
+    {"converged",
+     (getter)PL_ModelType_converged_get,
+     NULL,
+     PL_ModelType_converged_doc,
+     NULL},
+
     {"is_oneclass",
      (getter)PL_ModelType_is_oneclass_get,
      NULL,
@@ -1390,6 +2166,12 @@ static PyGetSetDef PL_ModelType_getset[] = {
      PL_ModelType_bias_doc,
      NULL},
 
+    {"stats",
+     (getter)PL_ModelType_stats_get,
+     NULL,
+     PL_ModelType_stats_doc,
+     NULL},
+
     {"rho",
      (getter)PL_ModelType_rho_get,
      NULL,
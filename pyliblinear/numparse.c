@@ -0,0 +1,295 @@
+/*
+ * Copyright 2015 - 2025
+ * Andr\xe9 Malo or his licensors, as applicable
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pyliblinear.h"
+
+#include <float.h>
+
+typedef unsigned long long pl_uint64_t;
+
+#include "pow5.h"
+
+
+/* Max number of significant decimal digits fitting into pl_uint64_t */
+#define PL_NUMPARSE_DIGITS (19)
+
+/* Max number of digits parsed by pl_parse_int */
+#define PL_NUMPARSE_INT_DIGITS (9)
+
+/* Exponents beyond that are clamped. Anything that large is inf or zero */
+#define PL_NUMPARSE_EXP_MAX (100000L)
+
+#define PL_NUMPARSE_IS_DIGIT(c) ((c) >= '0' && (c) <= '9')
+
+/* IEEE 754 binary64 */
+#define PL_DOUBLE_MANTISSA_BITS (52)
+#define PL_DOUBLE_EXP_MIN (-1023)
+#define PL_DOUBLE_EXP_INF (0x7FF)
+
+
+/*
+ * Exact powers of ten for the fast path
+ */
+static const double pl_pow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+
+/*
+ * Full 64 x 64 -> 128 bit multiplication
+ */
+static void
+pl_mul128(pl_uint64_t a, pl_uint64_t b, pl_uint64_t *high, pl_uint64_t *low)
+{
+#ifdef __SIZEOF_INT128__
+    __extension__ typedef unsigned __int128 pl_uint128_t;
+    pl_uint128_t r = (pl_uint128_t)a * b;
+
+    *high = (pl_uint64_t)(r >> 64);
+    *low = (pl_uint64_t)r;
+#else
+    pl_uint64_t a_lo = a & 0xFFFFFFFFULL, a_hi = a >> 32,
+                b_lo = b & 0xFFFFFFFFULL, b_hi = b >> 32,
+                lolo = a_lo * b_lo, lohi = a_lo * b_hi,
+                hilo = a_hi * b_lo, hihi = a_hi * b_hi,
+                cross = (lolo >> 32) + (hilo & 0xFFFFFFFFULL) + lohi;
+
+    *high = hihi + (hilo >> 32) + (cross >> 32);
+    *low = (cross << 32) | (lolo & 0xFFFFFFFFULL);
+#endif
+}
+
+
+/*
+ * Count leading zero bits (w must not be 0)
+ */
+static int
+pl_clz64(pl_uint64_t w)
+{
+#ifdef __GNUC__
+    return __builtin_clzll(w);
+#else
+    int result = 0;
+
+    while (!(w & (1ULL << 63))) {
+        w <<= 1;
+        ++result;
+    }
+    return result;
+#endif
+}
+
+
+/*
+ * Compute w * 10^q, correctly rounded (Eisel-Lemire)
+ *
+ * See Daniel Lemire, "Number Parsing at a Gigabyte per Second" and Noble
+ * Mushtak, Daniel Lemire, "Fast Number Parsing Without Fallback".
+ *
+ * w must not be 0 and q must be within [PL_POW5_MIN, PL_POW5_MAX].
+ *
+ * Return -1 if the result is subnormal or infinite (not handled here)
+ */
+static int
+pl_eisel_lemire(pl_uint64_t w, long q, pl_uint64_t *bits)
+{
+    const pl_uint64_t *pow5 = pl_pow5[q - PL_POW5_MIN];
+    pl_uint64_t high, low, high2, low2, mantissa;
+    long power2;
+    int lz, upperbit, shift;
+
+    lz = pl_clz64(w);
+    w <<= lz;
+
+    pl_mul128(w, pow5[0], &high, &low);
+    if ((high & 0x1FF) == 0x1FF) {
+        pl_mul128(w, pow5[1], &high2, &low2);
+        low += high2;
+        if (high2 > low)
+            ++high;
+    }
+
+    upperbit = (int)(high >> 63);
+    shift = upperbit + 64 - PL_DOUBLE_MANTISSA_BITS - 3;
+    mantissa = high >> shift;
+
+    /* floor(log2(10^q)) + 63 */
+    power2 = (((152170L + 65536L) * q) >> 16) + 63
+             + upperbit - lz - PL_DOUBLE_EXP_MIN;
+    if (power2 <= 0)
+        return -1;
+
+    /* Exactly halfway between two doubles: round to even */
+    if (low <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1
+        && (mantissa << shift) == high)
+        mantissa &= ~1ULL;
+
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >= (2ULL << PL_DOUBLE_MANTISSA_BITS)) {
+        mantissa = 1ULL << PL_DOUBLE_MANTISSA_BITS;
+        ++power2;
+    }
+    mantissa &= ~(1ULL << PL_DOUBLE_MANTISSA_BITS);
+    if (power2 >= PL_DOUBLE_EXP_INF)
+        return -1;
+
+    *bits = mantissa | ((pl_uint64_t)power2 << PL_DOUBLE_MANTISSA_BITS);
+    return 0;
+}
+
+
+/*
+ * Parse a decimal floating point number
+ *
+ * The whole string between start and end must be of the form
+ * [+-]?(digits[.digits]|.digits)([eE][+-]?digits)? and the result is
+ * correctly rounded (bit-identical to PyOS_string_to_double). This function
+ * is independent of the locale and doesn't need the GIL.
+ *
+ * Return -1 if the string cannot be handled here (invalid, inf, nan,
+ * overflows, subnormals, too many digits to decide). The caller is expected
+ * to fall back to PyOS_string_to_double then.
+ */
+int
+pl_parse_double(const char *start, const char *end, double *result)
+{
+    const char *c = start;
+    pl_uint64_t w = 0, bits, bits2;
+    double value;
+    long q = 0, e = 0;
+    int neg = 0, eneg = 0, ndigits = 0, any = 0, truncated = 0;
+
+    if (c < end && (*c == '+' || *c == '-'))
+        neg = (*c++ == '-');
+
+    for (; c < end && PL_NUMPARSE_IS_DIGIT(*c); ++c) {
+        any = 1;
+        if (ndigits < PL_NUMPARSE_DIGITS) {
+            if (w || *c != '0') {
+                w = w * 10 + (pl_uint64_t)(*c - '0');
+                ++ndigits;
+            }
+        }
+        else {
+            ++q;
+            truncated |= (*c != '0');
+        }
+    }
+    if (c < end && *c == '.') {
+        for (++c; c < end && PL_NUMPARSE_IS_DIGIT(*c); ++c) {
+            any = 1;
+            if (ndigits < PL_NUMPARSE_DIGITS) {
+                if (w || *c != '0') {
+                    w = w * 10 + (pl_uint64_t)(*c - '0');
+                    ++ndigits;
+                }
+                --q;
+            }
+            else {
+                truncated |= (*c != '0');
+            }
+        }
+    }
+    if (!any)
+        return -1;
+
+    if (c < end && (*c == 'e' || *c == 'E')) {
+        if (++c < end && (*c == '+' || *c == '-'))
+            eneg = (*c++ == '-');
+        if (!(c < end && PL_NUMPARSE_IS_DIGIT(*c)))
+            return -1;
+        for (; c < end && PL_NUMPARSE_IS_DIGIT(*c); ++c) {
+            if (e < PL_NUMPARSE_EXP_MAX)
+                e = e * 10 + (*c - '0');
+        }
+        q += eneg ? -e : e;
+    }
+    if (c != end)
+        return -1;
+
+    if (!w) {
+        *result = neg ? -0.0 : 0.0;
+        return 0;
+    }
+
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+    /* Exact operands, single rounding (Clinger) */
+    if (!truncated && q >= -22 && q <= 22
+        && w <= (1ULL << (PL_DOUBLE_MANTISSA_BITS + 1))) {
+        value = (double)w;
+        value = q < 0 ? value / pl_pow10[-q] : value * pl_pow10[q];
+        *result = neg ? -value : value;
+        return 0;
+    }
+#endif
+
+    if (q < PL_POW5_MIN) {
+        *result = neg ? -0.0 : 0.0;
+        return 0;
+    }
+    if (q > PL_POW5_MAX)
+        return -1;
+
+    if (pl_eisel_lemire(w, q, &bits) == -1)
+        return -1;
+
+    /* The dropped digits may only matter if w + 1 rounds differently */
+    if (truncated
+        && (pl_eisel_lemire(w + 1, q, &bits2) == -1 || bits != bits2))
+        return -1;
+
+    (void)memcpy(&value, &bits, sizeof value);
+    *result = neg ? -value : value;
+    return 0;
+}
+
+
+/*
+ * Parse a short decimal integer
+ *
+ * Accepts [+-]?[0-9]{1,9} at start. stop is set to the first character
+ * after the number. This function is independent of the locale and doesn't
+ * need the GIL.
+ *
+ * Return -1 if the string cannot be handled here (no digits or too many of
+ * them). The caller is expected to fall back to PyOS_strtol then.
+ */
+int
+pl_parse_int(const char *start, const char *end, const char **stop,
+             long *result)
+{
+    const char *c = start, *dend;
+    long value = 0;
+    int neg = 0;
+
+    if (c < end && (*c == '+' || *c == '-'))
+        neg = (*c++ == '-');
+
+    dend = end - c > PL_NUMPARSE_INT_DIGITS + 1
+           ? c + PL_NUMPARSE_INT_DIGITS + 1 : end;
+    for (start = c; c < dend && PL_NUMPARSE_IS_DIGIT(*c); ++c)
+        value = value * 10 + (*c - '0');
+
+    if (c == start || c - start > PL_NUMPARSE_INT_DIGITS)
+        return -1;
+
+    *stop = c;
+    *result = neg ? -value : value;
+    return 0;
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright 2015 - 2025
+ * Andr\xe9 Malo or his licensors, as applicable
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pyliblinear.h"
+
+#include "pythread.h"
+
+
+/*
+ * A single slice of the work, run by one thread
+ *
+ * The jobs are allocated using the plain C allocator, because they may be
+ * created without the GIL.
+ */
+typedef struct {
+    pl_parallel_fn *fn;
+    void *arg;
+    int thread;
+    int threads;
+
+    PyThread_type_lock done;
+} pl_parallel_job_t;
+
+
+/*
+ * Thread entry point
+ */
+static void
+pl_parallel_worker(void *job_)
+{
+    pl_parallel_job_t *job = job_;
+
+    job->fn(job->arg, job->thread, job->threads);
+    PyThread_release_lock(job->done);
+}
+
+
+/*
+ * Run fn(arg, thread, threads) for thread = 0 ... threads - 1 in parallel
+ *
+ * Slice 0 is run by the calling thread. Slices which cannot get their own
+ * thread are run by the calling thread as well. Returns after all slices
+ * have finished. Doesn't need the GIL.
+ */
+void
+pl_parallel_run(int threads, pl_parallel_fn *fn, void *arg)
+{
+    pl_parallel_job_t *jobs;
+    int j;
+
+    if (threads < 2
+        || !(jobs = malloc(((size_t)threads) * (sizeof *jobs)))) {
+        for (j = 0; j < threads; ++j)
+            fn(arg, j, threads);
+        return;
+    }
+
+    for (j = 0; j < threads; ++j) {
+        jobs[j].fn = fn;
+        jobs[j].arg = arg;
+        jobs[j].thread = j;
+        jobs[j].threads = threads;
+        jobs[j].done = NULL;
+        if (j == 0 || !(jobs[j].done = PyThread_allocate_lock()))
+            continue;
+
+        (void)PyThread_acquire_lock(jobs[j].done, WAIT_LOCK);
+        if ((long)PyThread_start_new_thread(pl_parallel_worker, &jobs[j])
+            == -1L) {
+            PyThread_release_lock(jobs[j].done);
+            PyThread_free_lock(jobs[j].done);
+            jobs[j].done = NULL;
+        }
+    }
+
+    for (j = 0; j < threads; ++j) {
+        if (!jobs[j].done)
+            fn(arg, j, threads);
+    }
+    for (j = 1; j < threads; ++j) {
+        if (jobs[j].done) {
+            (void)PyThread_acquire_lock(jobs[j].done, WAIT_LOCK);
+            PyThread_release_lock(jobs[j].done);
+            PyThread_free_lock(jobs[j].done);
+        }
+    }
+
+    free(jobs);
+}
+
+
+/* Microseconds between the signal checks of pl_parallel_run_interruptible */
+#define PL_PARALLEL_SIGNAL_POLL (50000)
+
+/*
+ * Run fn(arg, 0, 1) in a thread of its own and wait for it
+ *
+ * The calling thread checks for signals meanwhile. If a signal handler
+ * raises an exception (e.g. KeyboardInterrupt), *cancel is set, so fn can
+ * stop early. The exception is kept until fn has returned. If no thread
+ * can be started, fn is run by the calling thread (without the GIL).
+ *
+ * Return -1 if a signal handler raised an exception
+ */
+int
+pl_parallel_run_interruptible(pl_parallel_fn *fn, void *arg,
+                              volatile int *cancel)
+{
+#ifdef EXT3
+    pl_parallel_job_t job;
+    PyLockStatus status;
+    int res = 0;
+
+    job.fn = fn;
+    job.arg = arg;
+    job.thread = 0;
+    job.threads = 1;
+    if ((job.done = PyThread_allocate_lock())) {
+        (void)PyThread_acquire_lock(job.done, WAIT_LOCK);
+        if ((long)PyThread_start_new_thread(pl_parallel_worker, &job)
+            == -1L) {
+            PyThread_release_lock(job.done);
+            PyThread_free_lock(job.done);
+            job.done = NULL;
+        }
+    }
+
+    if (job.done) {
+        while (1) {
+            Py_BEGIN_ALLOW_THREADS
+            status = PyThread_acquire_lock_timed(job.done,
+                                                 PL_PARALLEL_SIGNAL_POLL, 0);
+            Py_END_ALLOW_THREADS
+            if (status == PY_LOCK_ACQUIRED)
+                break;
+            if (!res && PyErr_CheckSignals() == -1) {
+                *cancel = 1;
+                res = -1;
+            }
+        }
+        PyThread_release_lock(job.done);
+        PyThread_free_lock(job.done);
+        return res;
+    }
+#endif
+
+    Py_BEGIN_ALLOW_THREADS
+    fn(arg, 0, 1);
+    Py_END_ALLOW_THREADS
+
+    return 0;
+}
@@ -52,8 +52,6 @@ extern PyTypeObject PL_SolverType;
 extern PyTypeObject PL_FeatureViewType;
 extern PyTypeObject PL_LabelViewType;
 extern PyTypeObject PL_ZipperType;
-extern PyTypeObject PL_VectorReaderType;
-extern PyTypeObject PL_MatrixReaderType;
 extern PyTypeObject PL_FeatureMatrixType;
 #define PL_FeatureMatrixType_Check(op) \
     PyObject_TypeCheck(op, &PL_FeatureMatrixType)
@@ -63,10 +61,19 @@ extern PyTypeObject PL_FeatureMatrixType;
 
 extern PyTypeObject PL_PredictIteratorType;
 extern PyTypeObject PL_ModelType;
+#define PL_ModelType_Check(op) \
+    PyObject_TypeCheck(op, &PL_ModelType)
 #define PL_ModelType_CheckExact(op) \
     ((op)->ob_type == &PL_ModelType)
 
 
+extern PyTypeObject PL_CancelType;
+#define PL_CancelType_Check(op) \
+    PyObject_TypeCheck(op, &PL_CancelType)
+#define PL_CancelType_CheckExact(op) \
+    ((op)->ob_type == &PL_CancelType)
+
+
 #if (PL_TEST == 1)
 extern PyTypeObject PL_TokReaderType;
 #endif
@@ -146,6 +153,17 @@ int
 pl_attr(PyObject *, const char *, PyObject **);
 
 
+/*
+ * Convert object to a random seed (the lower 64 bits of an integer)
+ *
+ * Reference to obj is stolen
+ *
+ * Return -1 on error
+ */
+int
+pl_as_seed(PyObject *, PY_UINT64_T *);
+
+
 /*
  * ************************************************************************
  * Solver utilities
@@ -172,7 +190,8 @@ pl_solver_types(void);
 /*
  * Transform pl_solver_t to (liblinear) struct parameter
  *
- * NULL for self is accepted and results in the default solver's parameters.
+ * NULL or None for self is accepted and results in the default solver's
+ * parameters.
  *
  * Return -1 on error
  */
@@ -189,6 +208,15 @@ const char *
 pl_solver_name(int solver_type);
 
 
+/*
+ * Find the flag of a cancel handle (see struct parameter)
+ *
+ * Return NULL on error
+ */
+volatile int *
+pl_cancel_flag(PyObject *);
+
+
 /*
  * ************************************************************************
  * Matrix utilities
@@ -198,10 +226,35 @@ pl_solver_name(int solver_type);
 /*
  * Transform pl_matrix_t into a (liblinear) struct problem
  *
+ * The problem can be used without the GIL (as long as the matrix is kept
+ * alive) and must be released with pl_matrix_problem_clear(). If the third
+ * argument is true, the problem gets the structure-of-arrays layout for
+ * training as well (see struct problem).
+ *
  * Return -1 on error
  */
 int
-pl_matrix_as_problem(PyObject *, double, struct problem *);
+pl_matrix_as_problem(PyObject *, double, int, struct problem *);
+
+
+/*
+ * Attach the transposed vectors to a problem created by
+ * pl_matrix_as_problem() (see struct problem)
+ *
+ * The columns are created once, by up to the given number of threads, and
+ * kept with the matrix.
+ *
+ * Return -1 on error
+ */
+int
+pl_matrix_problem_cols(PyObject *, int, struct problem *);
+
+
+/*
+ * Release a problem created by pl_matrix_as_problem()
+ */
+void
+pl_matrix_problem_clear(PyObject *, struct problem *);
 
 
 /*
@@ -211,14 +264,118 @@ pl_matrix_as_problem(PyObject *, double, struct problem *);
  */
 
 /*
- * Load a pythonic feature vector into our own structures
+ * Growing storage for feature vectors
+ *
+ * The rows are stored back to back in a single node array, each one with a
+ * bias node at [0] and a sentinel at the end.
+ */
+typedef struct {
+    struct feature_node *nodes;
+    size_t nodes_size;
+    size_t nodes_alloc;
+
+    size_t *rows;          /* Offset of each row in nodes */
+    double *labels;        /* Label of each row */
+    size_t rows_size;
+    size_t rows_alloc;
+
+    int width;             /* Max feature index */
+} pl_arena_t;
+
+
+/*
+ * Initialize an empty arena
+ */
+void
+pl_arena_init(pl_arena_t *);
+
+
+/*
+ * Release the arena memory (the arena is empty afterwards)
+ */
+void
+pl_arena_clear(pl_arena_t *);
+
+
+/*
+ * Empty the arena, but keep the memory for reuse
+ */
+void
+pl_arena_reset(pl_arena_t *);
+
+
+/*
+ * Make room for at least rows more rows and nodes more nodes
+ *
+ * Return -1 on error
+ */
+int
+pl_arena_reserve(pl_arena_t *, size_t, size_t);
+
+
+/*
+ * Start a new row (adds the bias node)
+ *
+ * Return -1 on error
+ */
+int
+pl_arena_row_open(pl_arena_t *, double);
+
+
+/*
+ * Add a feature to the current row
+ *
+ * Zero values are skipped. The arena width is updated.
+ *
+ * Return -1 on error
+ */
+int
+pl_arena_feature_add(pl_arena_t *, int, double);
+
+
+/*
+ * Finish the current row (adds the sentinel)
+ *
+ * Return -1 on error
+ */
+int
+pl_arena_row_close(pl_arena_t *);
+
+
+/*
+ * Add a complete row from an array of features (label, features, size)
+ *
+ * The features are expected to be non-zero already. The arena width is
+ * updated.
+ *
+ * Return -1 on error
+ */
+int
+pl_arena_row_copy(pl_arena_t *, double, const struct feature_node *, size_t);
+
+
+/*
+ * Hand over the collected rows (vectors, nodes, labels, height, width)
+ *
+ * The vectors point into the nodes, behind the bias nodes. All result arrays
+ * are NULL if there are no rows. The arena is empty afterwards.
+ *
+ * Return -1 on error
+ */
+int
+pl_arena_finish(pl_arena_t *, struct feature_node ***, struct feature_node **,
+                double **, int *, int *);
+
+
+/*
+ * Load a pythonic feature vector into the arena as a new row
  *
  * Reference to vector is stolen
  *
  * Return -1 on failure
  */
 int
-pl_vector_load(PyObject *, struct feature_node **, int *, int *);
+pl_vector_load(PyObject *, double, pl_arena_t *);
 
 
 /*
@@ -298,6 +455,135 @@ pl_iter_t *
 pl_tokread_iter_new(PyObject *);
 
 
+/*
+ * Create new tok reader scanning a buffer object (e.g. an mmap) in place
+ *
+ * map is stolen and cleared on error.
+ *
+ * Return NULL on error
+ */
+pl_iter_t *
+pl_tokread_iter_map_new(PyObject *);
+
+
+/*
+ * ************************************************************************
+ * Scanners
+ * ************************************************************************
+ */
+
+/*
+ * Find the next delimiter (space, tab, CR, LF or \0)
+ *
+ * Return end if there's none
+ */
+const char *
+pl_scan_delim(const char *, const char *);
+
+
+/*
+ * Find the next value whose absolute value is above threshold (or NaN)
+ *
+ * Return end if there's none
+ */
+const double *
+pl_scan_double(const double *, const double *, double);
+
+
+/*
+ * Find the next value whose absolute value is above threshold (or NaN)
+ *
+ * Return end if there's none
+ */
+const float *
+pl_scan_float(const float *, const float *, float);
+
+
+/*
+ * Select the scanner implementation for the running CPU
+ */
+void
+pl_scan_init(void);
+
+
+/*
+ * ************************************************************************
+ * Number parser
+ * ************************************************************************
+ */
+
+/*
+ * Parse a decimal floating point number (start to end)
+ *
+ * Return -1 if the caller needs to fall back to PyOS_string_to_double
+ */
+int
+pl_parse_double(const char *, const char *, double *);
+
+
+/*
+ * Parse a short decimal integer (at start, stops before end)
+ *
+ * Return -1 if the caller needs to fall back to PyOS_strtol
+ */
+int
+pl_parse_int(const char *, const char *, const char **, long *);
+
+
+/*
+ * ************************************************************************
+ * Parallel execution
+ * ************************************************************************
+ */
+
+/*
+ * Slice of parallel work (arg, thread, threads)
+ */
+typedef void (pl_parallel_fn)(void *, int, int);
+
+
+/*
+ * Run fn(arg, thread, threads) for all threads in parallel and wait for them
+ *
+ * Doesn't need the GIL.
+ */
+void
+pl_parallel_run(int, pl_parallel_fn *, void *);
+
+
+/*
+ * Run fn(arg, 0, 1) in a thread of its own and wait for it
+ *
+ * Needs the GIL, which is released while waiting. If a signal handler
+ * raises an exception meanwhile (e.g. KeyboardInterrupt), the int is set
+ * to 1, so fn can stop early.
+ *
+ * Return -1 if a signal handler raised an exception (after fn returned)
+ */
+int
+pl_parallel_run_interruptible(pl_parallel_fn *, void *, volatile int *);
+
+
+/*
+ * ************************************************************************
+ * Line parser
+ * ************************************************************************
+ */
+
+/*
+ * Parse a libsvm formatted buffer using multiple threads
+ *
+ * The rows are added to the arena.
+ *
+ * Return -1 on error
+ * Return 0 on success
+ * Return 1 if the buffer needs to be parsed by the token reader (not worth
+ * threading, invalid or unusual input)
+ */
+int
+pl_lineparse(const char *, Py_ssize_t, int, pl_arena_t *);
+
+
 /*
  * ************************************************************************
  * Buffer writer
@@ -309,12 +595,13 @@ typedef struct pl_bufwriter_t pl_bufwriter_t;
 /*
  * Create new bufwriter
  *
- * write is stolen and cleared on error
+ * write is stolen and cleared on error. If binary is true, bytes are passed
+ * to write, otherwise strings.
  *
  * Return NULL on error
  */
 pl_bufwriter_t *
-pl_bufwriter_new(PyObject *);
+pl_bufwriter_new(PyObject *, int);
 
 
 /*
@@ -378,4 +665,20 @@ pl_file_open(PyObject *, const char *);
 #endif
 
 
+/*
+ * Map a file into memory
+ *
+ * The mapping is read-only and advised for sequential access. If private is
+ * true, it's writable copy-on-write instead (changes are never written
+ * back).
+ *
+ * map is set to NULL if the file cannot be mapped (empty files or anything
+ * but regular files). The caller is expected to read it as a stream then.
+ *
+ * Return -1 on error
+ */
+int
+pl_file_map(PyObject *, int, PyObject **);
+
+
 #endif
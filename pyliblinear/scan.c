@@ -0,0 +1,341 @@
+/*
+ * Copyright 2015 - 2025
+ * Andr\xe9 Malo or his licensors, as applicable
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pyliblinear.h"
+
+/*
+ * SSE2 is part of the x86-64 baseline. AVX2 is selected at runtime, which
+ * needs the gcc/clang target attribute.
+ */
+#if defined(__GNUC__) && defined(__SSE2__) \
+    && (defined(__x86_64__) || defined(__i386__))
+#define PL_SCAN_SSE2
+#define PL_SCAN_AVX2
+#define PL_SCAN_CTZ(mask) __builtin_ctz(mask)
+#include <immintrin.h>
+
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_AMD64))
+#define PL_SCAN_SSE2
+#define PL_SCAN_CTZ(mask) pl_scan_ctz(mask)
+#include <intrin.h>
+#include <emmintrin.h>
+
+static int
+pl_scan_ctz(unsigned int mask)
+{
+    unsigned long result;
+
+    _BitScanForward(&result, mask);
+    return (int)result;
+}
+#endif
+
+
+typedef const char *(pl_scan_delim_fn)(const char *, const char *);
+typedef const double *(pl_scan_double_fn)(const double *, const double *,
+                                          double);
+typedef const float *(pl_scan_float_fn)(const float *, const float *, float);
+
+
+/*
+ * Find the next delimiter, byte by byte
+ */
+static const char *
+pl_scan_delim_bytes(const char *c, const char *end)
+{
+    for (; c < end; ++c) {
+        switch (*c) {
+        case ' ': case '\t': case '\n': case '\r': case '\0':
+            return c;
+        }
+    }
+
+    return end;
+}
+
+
+/*
+ * Find the next value with an absolute value above threshold, one by one
+ *
+ * NaNs count as above.
+ */
+static const double *
+pl_scan_double_plain(const double *c, const double *end, double threshold)
+{
+    for (; c < end; ++c) {
+        if (!(fabs(*c) <= threshold))
+            return c;
+    }
+
+    return end;
+}
+
+
+static const float *
+pl_scan_float_plain(const float *c, const float *end, float threshold)
+{
+    for (; c < end; ++c) {
+        if (!(fabsf(*c) <= threshold))
+            return c;
+    }
+
+    return end;
+}
+
+
+/*
+ * Number of bytes checked one by one before switching to vector scanning.
+ *
+ * Most tokens (index:value pairs) are very short, and for them the plain
+ * loop is faster than setting up the vector comparisons.
+ */
+#define PL_SCAN_PREFIX (8)
+
+#define PL_SCAN_PREFIX_LOOP(c, end) do {                     \
+    const char *pend_ = (end) - (c) > PL_SCAN_PREFIX          \
+                        ? (c) + PL_SCAN_PREFIX : (end);       \
+    for (; (c) < pend_; ++(c)) {                             \
+        switch (*(c)) {                                      \
+        case ' ': case '\t': case '\n': case '\r': case '\0': \
+            return (c);                                      \
+        }                                                    \
+    }                                                        \
+} while (0)
+
+
+#ifdef PL_SCAN_SSE2
+/*
+ * Find the next delimiter, 16 bytes at a time
+ */
+static const char *
+pl_scan_delim_sse2(const char *c, const char *end)
+{
+    const __m128i sp = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t'),
+                  lf = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r'),
+                  nul = _mm_setzero_si128();
+    __m128i v;
+    int mask;
+
+    PL_SCAN_PREFIX_LOOP(c, end);
+    for (; end - c >= 16; c += 16) {
+        v = _mm_loadu_si128((const __m128i *)(const void *)c);
+        mask = _mm_movemask_epi8(
+            _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, tab)),
+                _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(v, lf),
+                                 _mm_cmpeq_epi8(v, cr)),
+                    _mm_cmpeq_epi8(v, nul)
+                )
+            )
+        );
+        if (mask)
+            return c + PL_SCAN_CTZ((unsigned int)mask);
+    }
+
+    return pl_scan_delim_bytes(c, end);
+}
+
+
+/*
+ * Find the next value above threshold, 2 doubles at a time
+ */
+static const double *
+pl_scan_double_sse2(const double *c, const double *end, double threshold)
+{
+    const __m128d sign = _mm_set1_pd(-0.0), thr = _mm_set1_pd(threshold);
+    int mask;
+
+    for (; end - c >= 2; c += 2) {
+        mask = _mm_movemask_pd(_mm_cmpnle_pd(
+            _mm_andnot_pd(sign, _mm_loadu_pd(c)), thr
+        ));
+        if (mask)
+            return c + PL_SCAN_CTZ((unsigned int)mask);
+    }
+
+    return pl_scan_double_plain(c, end, threshold);
+}
+
+
+/*
+ * Find the next value above threshold, 4 floats at a time
+ */
+static const float *
+pl_scan_float_sse2(const float *c, const float *end, float threshold)
+{
+    const __m128 sign = _mm_set1_ps(-0.0f), thr = _mm_set1_ps(threshold);
+    int mask;
+
+    for (; end - c >= 4; c += 4) {
+        mask = _mm_movemask_ps(_mm_cmpnle_ps(
+            _mm_andnot_ps(sign, _mm_loadu_ps(c)), thr
+        ));
+        if (mask)
+            return c + PL_SCAN_CTZ((unsigned int)mask);
+    }
+
+    return pl_scan_float_plain(c, end, threshold);
+}
+#endif
+
+
+#ifdef PL_SCAN_AVX2
+/*
+ * Find the next delimiter, 32 bytes at a time
+ */
+__attribute__((target("avx2")))
+static const char *
+pl_scan_delim_avx2(const char *c, const char *end)
+{
+    const __m256i sp = _mm256_set1_epi8(' '), tab = _mm256_set1_epi8('\t'),
+                  lf = _mm256_set1_epi8('\n'), cr = _mm256_set1_epi8('\r'),
+                  nul = _mm256_setzero_si256();
+    __m256i v;
+    int mask;
+
+    PL_SCAN_PREFIX_LOOP(c, end);
+    for (; end - c >= 32; c += 32) {
+        v = _mm256_loadu_si256((const __m256i *)(const void *)c);
+        mask = _mm256_movemask_epi8(
+            _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, sp),
+                                _mm256_cmpeq_epi8(v, tab)),
+                _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, lf),
+                                    _mm256_cmpeq_epi8(v, cr)),
+                    _mm256_cmpeq_epi8(v, nul)
+                )
+            )
+        );
+        if (mask)
+            return c + PL_SCAN_CTZ((unsigned int)mask);
+    }
+
+    return pl_scan_delim_sse2(c, end);
+}
+
+
+/*
+ * Find the next value above threshold, 4 doubles at a time
+ */
+__attribute__((target("avx2")))
+static const double *
+pl_scan_double_avx2(const double *c, const double *end, double threshold)
+{
+    const __m256d sign = _mm256_set1_pd(-0.0),
+                  thr = _mm256_set1_pd(threshold);
+    int mask;
+
+    for (; end - c >= 4; c += 4) {
+        mask = _mm256_movemask_pd(_mm256_cmp_pd(
+            _mm256_andnot_pd(sign, _mm256_loadu_pd(c)), thr, _CMP_NLE_UQ
+        ));
+        if (mask)
+            return c + PL_SCAN_CTZ((unsigned int)mask);
+    }
+
+    return pl_scan_double_sse2(c, end, threshold);
+}
+
+
+/*
+ * Find the next value above threshold, 8 floats at a time
+ */
+__attribute__((target("avx2")))
+static const float *
+pl_scan_float_avx2(const float *c, const float *end, float threshold)
+{
+    const __m256 sign = _mm256_set1_ps(-0.0f),
+                 thr = _mm256_set1_ps(threshold);
+    int mask;
+
+    for (; end - c >= 8; c += 8) {
+        mask = _mm256_movemask_ps(_mm256_cmp_ps(
+            _mm256_andnot_ps(sign, _mm256_loadu_ps(c)), thr, _CMP_NLE_UQ
+        ));
+        if (mask)
+            return c + PL_SCAN_CTZ((unsigned int)mask);
+    }
+
+    return pl_scan_float_sse2(c, end, threshold);
+}
+#endif
+
+
+#if defined(PL_SCAN_SSE2)
+static pl_scan_delim_fn *pl_scan_delim_impl = pl_scan_delim_sse2;
+static pl_scan_double_fn *pl_scan_double_impl = pl_scan_double_sse2;
+static pl_scan_float_fn *pl_scan_float_impl = pl_scan_float_sse2;
+#else
+static pl_scan_delim_fn *pl_scan_delim_impl = pl_scan_delim_bytes;
+static pl_scan_double_fn *pl_scan_double_impl = pl_scan_double_plain;
+static pl_scan_float_fn *pl_scan_float_impl = pl_scan_float_plain;
+#endif
+
+
+/*
+ * Find the next delimiter (space, tab, CR, LF or \0)
+ *
+ * Return end if there's none
+ */
+const char *
+pl_scan_delim(const char *c, const char *end)
+{
+    return pl_scan_delim_impl(c, end);
+}
+
+
+/*
+ * Find the next value whose absolute value is above threshold (or NaN)
+ *
+ * Return end if there's none
+ */
+const double *
+pl_scan_double(const double *c, const double *end, double threshold)
+{
+    return pl_scan_double_impl(c, end, threshold);
+}
+
+
+/*
+ * Find the next value whose absolute value is above threshold (or NaN)
+ *
+ * Return end if there's none
+ */
+const float *
+pl_scan_float(const float *c, const float *end, float threshold)
+{
+    return pl_scan_float_impl(c, end, threshold);
+}
+
+
+/*
+ * Select the scanner implementation for the running CPU
+ */
+void
+pl_scan_init(void)
+{
+#ifdef PL_SCAN_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        pl_scan_delim_impl = pl_scan_delim_avx2;
+        pl_scan_double_impl = pl_scan_double_avx2;
+        pl_scan_float_impl = pl_scan_float_avx2;
+    }
+#endif
+}
@@ -82,9 +82,15 @@ typedef struct {
     double C;
     double p;
     double nu;
+    double time_limit;
+
+    PY_UINT64_T seed;
 
     int nr_weight;
     int solver_type;
+    int threads;
+    int hogwild;
+    int max_iter;
 } pl_solver_t;
 
 /* ------------------------ BEGIN Helper Functions ----------------------- */
@@ -92,7 +98,8 @@ typedef struct {
 /*
  * Transform pl_solver_t to (liblinear) struct parameter
  *
- * NULL for self is accepted and results in the default solver's parameters.
+ * NULL or None for self is accepted and results in the default solver's
+ * parameters.
  *
  * Return -1 on error
  */
@@ -101,7 +108,7 @@ pl_solver_as_parameter(PyObject *self, struct parameter *param)
 {
     pl_solver_t *solver;
 
-    if (self) {
+    if (self && self != Py_None) {
         if (!PL_SolverType_CheckExact(self)
             && !PL_SolverType_Check(self)) {
             PyErr_SetString(PyExc_TypeError,
@@ -126,6 +133,14 @@ pl_solver_as_parameter(PyObject *self, struct parameter *param)
     param->p = solver->p;
     param->nu = solver->nu;
     param->init_sol = solver->init_sol;
+    param->regularize_bias = 1;
+    param->nr_thread = solver->threads;
+    param->seed = solver->seed;
+    param->hogwild = solver->hogwild;
+    param->max_iter = solver->max_iter;
+    param->time_limit = solver->time_limit;
+    param->cancel = NULL;
+    param->stats = 0;
 
     Py_DECREF(self);
     return 0;
@@ -573,9 +588,156 @@ error_result:
 #undef PyInt_FromLong
 #endif
 
+PyDoc_STRVAR(PL_SolverType_find_parameters__doc__,
+"find_parameters(self, matrix, nr_fold, start_C=None, start_p=None,\n\
+                bias=None)\n\
+\n\
+Search the best C (and p for ``L2R_L2LOSS_SVR``) using cross-validation.\n\
+\n\
+C is doubled in every step, up to ``1024`` (``2**20`` for SVR), starting\n\
+the solver of each fold from its previous solution. The search stops when\n\
+the solutions don't change anymore. For SVR, the C search is repeated for\n\
+20 values of p, descending. The folds are trained in parallel, using the\n\
+solver's threads. The GIL is released meanwhile.\n\
+\n\
+Only the ``L2R_LR``, ``L2R_L2LOSS_SVC`` and ``L2R_L2LOSS_SVR`` solver types\n\
+are supported.\n\
+\n\
+Parameters:\n\
+  matrix (FeatureMatrix):\n\
+    Feature matrix to use for the cross-validation\n\
+\n\
+  nr_fold (int):\n\
+    Number of folds. ``nr_folds > 1``\n\
+\n\
+  start_C (float):\n\
+    The first C to try. If omitted or ``None``, a small enough C is\n\
+    computed from the data. ``start_C > 0``.\n\
+\n\
+  start_p (float):\n\
+    The largest p to try (only for ``L2R_L2LOSS_SVR``). If omitted or\n\
+    ``None``, it's computed from the labels. ``start_p > 0``.\n\
+\n\
+  bias (float):\n\
+    Bias to the hyperplane. Of omitted or ``None``, no bias is applied.\n\
+    ``bias >= 0``.\n\
+\n\
+Returns:\n\
+  tuple: A tuple of the best C, the best p (``None`` if the solver is not\n\
+         ``L2R_L2LOSS_SVR``) and the best score. The score is the accuracy\n\
+         or the mean squared error for SVR.\n\
+\n\
+Raises:\n\
+  ValueError: Some invalid parameter or the solver type is not supported");
+
+static PyObject *
+PL_SolverType_find_parameters(pl_solver_t *self, PyObject *args,
+                              PyObject *kwds)
+{
+    static char *kwlist[] = {"matrix", "nr_fold", "start_C", "start_p",
+                             "bias", NULL};
+    struct problem prob;
+    struct parameter param;
+    PyObject *matrix_, *nr_fold_, *start_C_ = NULL, *start_p_ = NULL,
+             *bias_ = NULL;
+    double start_C = -1.0, start_p = -1.0, bias = -1.0;
+    double best_C, best_p, best_score;
+    int nr_fold;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|OOO", kwlist,
+                                     &matrix_, &nr_fold_, &start_C_,
+                                     &start_p_, &bias_))
+        return NULL;
+
+    switch (self->solver_type) {
+    case L2R_LR: case L2R_L2LOSS_SVC: case L2R_L2LOSS_SVR:
+        break;
+    default:
+        PyErr_SetString(PyExc_ValueError,
+                        "find_parameters supports only L2R_LR, "
+                        "L2R_L2LOSS_SVC and L2R_L2LOSS_SVR");
+        return NULL;
+    }
+
+    Py_INCREF(nr_fold_);
+    if (pl_as_int(nr_fold_, &nr_fold) == -1)
+        return NULL;
+    if (!(nr_fold > 1)) {
+        PyErr_SetString(PyExc_ValueError, "nr_fold must be more than one.");
+        return NULL;
+    }
+
+    if (start_C_ && start_C_ != Py_None) {
+        Py_INCREF(start_C_);
+        if (pl_as_double(start_C_, &start_C) == -1)
+            return NULL;
+        if (!(start_C > 0)) {
+            PyErr_SetString(PyExc_ValueError, "start_C must be > 0");
+            return NULL;
+        }
+    }
+
+    if (start_p_ && start_p_ != Py_None) {
+        Py_INCREF(start_p_);
+        if (pl_as_double(start_p_, &start_p) == -1)
+            return NULL;
+        if (!(start_p > 0)) {
+            PyErr_SetString(PyExc_ValueError, "start_p must be > 0");
+            return NULL;
+        }
+    }
+
+    if (bias_ && bias_ != Py_None) {
+        Py_INCREF(bias_);
+        if (pl_as_double(bias_, &bias) == -1)
+            return NULL;
+        if (bias < 0) {
+            PyErr_SetString(PyExc_ValueError, "bias must be >= 0");
+            return NULL;
+        }
+    }
+
+    if (pl_solver_as_parameter((PyObject *)self, &param) == -1)
+        return NULL;
+
+    if (pl_matrix_as_problem(matrix_, bias, check_csr_solver(&param), &prob)
+        == -1)
+        return NULL;
+
+    if (!(prob.l > 0)) {
+        pl_matrix_problem_clear(matrix_, &prob);
+        PyErr_SetString(PyExc_ValueError, "Matrix is empty");
+        return NULL;
+    }
+
+    if (nr_fold > prob.l) {
+        nr_fold = prob.l;
+        if (-1 == PyErr_WarnEx(PyExc_UserWarning,
+                               "WARNING: # folds > # data. Will use # "
+                               "folds = # data instead (i.e., "
+                               "leave-one-out cross validation)", 1)) {
+            pl_matrix_problem_clear(matrix_, &prob);
+            return NULL;
+        }
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    find_parameters(&prob, &param, nr_fold, start_C, start_p, &best_C,
+                    &best_p, &best_score);
+    Py_END_ALLOW_THREADS
+
+    pl_matrix_problem_clear(matrix_, &prob);
+
+    if (self->solver_type == L2R_L2LOSS_SVR)
+        return Py_BuildValue("(ddd)", best_C, best_p, best_score);
+    return Py_BuildValue("(dOd)", best_C, Py_None, best_score);
+}
+
 #ifdef METH_COEXIST
 PyDoc_STRVAR(PL_SolverType_new__doc__,
-"__new__(cls, type=None, C=None, eps=None, p=None, nu=None, weights=None)\n\
+"__new__(cls, type=None, C=None, eps=None, p=None, nu=None, weights=None,\n\
+        threads=None, seed=None, hogwild=None, max_iter=None,\n\
+        time_limit=None)\n\
 \n\
 Construct new solver instance.\n\
 \n\
@@ -604,6 +766,43 @@ Parameters:\n\
     Iterator over label weights. This is either a ``dict``, mapping labels to\n\
     weights (``{int: float, ...}``) or an iterable of 2-tuples doing the same\n\
     (``[(int, float), ...]``). If omitted or ``None``, no weight is applied.\n\
+\n\
+  threads (int):\n\
+    Number of threads used by the primal Newton solvers (``L2R_LR``,\n\
+    ``L2R_L2LOSS_SVC`` and ``L2R_L2LOSS_SVR``). Multi-class problems train\n\
+    their one-vs-rest classes in parallel (except for the ``L1R_*``\n\
+    solvers). Small problems use fewer threads. With `hogwild`, the\n\
+    ``L1R_*`` solvers keep a copy of their per-row state for each thread\n\
+    (8 bytes per row and thread) and use at most as many threads as there\n\
+    are features per row on average. If omitted or ``None``, it defaults to\n\
+    ``1``. ``threads > 0``.\n\
+\n\
+  seed (int):\n\
+    Seed for the random numbers drawn by the solvers (e.g. for shuffling\n\
+    the coordinates). The same seed results in the same models, also if\n\
+    trained in parallel. If omitted or ``None``, it defaults to ``0``.\n\
+\n\
+  hogwild (bool):\n\
+    Run the coordinate descent solvers with `threads` threads, too. The\n\
+    dual solvers (``L2R_L2LOSS_SVC_DUAL``, ``L2R_L1LOSS_SVC_DUAL``,\n\
+    ``L2R_LR_DUAL``, ``L2R_L2LOSS_SVR_DUAL`` and ``L2R_L1LOSS_SVR_DUAL``)\n\
+    update the coordinates of each thread's part of the rows, without\n\
+    locking the shared model. The ``L1R_*`` solvers update each thread's\n\
+    part of the features and combine the changes after each pass. The\n\
+    results are similar, but not reproducible. Small problems use fewer\n\
+    threads. If omitted or ``None``, it defaults to ``False``.\n\
+\n\
+  max_iter (int):\n\
+    Maximum number of outer iterations (passes or Newton steps) of each\n\
+    solver run. A model stopped by it is not converged\n\
+    (`Model.converged`). If omitted or ``None``, every solver applies its\n\
+    own limit. ``max_iter > 0``.\n\
+\n\
+  time_limit (float):\n\
+    Maximum training time per model in seconds. The solvers check it\n\
+    after every outer iteration and return the model as trained so far\n\
+    (not converged). If omitted or ``None``, there's no limit.\n\
+    ``time_limit > 0``.\n\
 \n\
 Returns:\n\
   Solver: New Solver instance\n\
@@ -620,6 +819,11 @@ static struct PyMethodDef PL_SolverType_methods[] = {
      EXT_CFUNC(PL_SolverType_weights),      METH_NOARGS,
      PL_SolverType_weights__doc__},
 
+    {"find_parameters",
+     EXT_CFUNC(PL_SolverType_find_parameters), METH_KEYWORDS |
+                                               METH_VARARGS,
+     PL_SolverType_find_parameters__doc__},
+
 #ifdef METH_COEXIST
     {"__new__",
      EXT_CFUNC(PL_SolverType_new),          METH_COEXIST  |
@@ -632,6 +836,79 @@ static struct PyMethodDef PL_SolverType_methods[] = {
     {NULL, NULL}  /* Sentinel */
 };
 
+PyDoc_STRVAR(PL_SolverType_threads_doc,
+"The configured number of threads.\n\
+\n\
+:Type: ``int``");
+
+#ifdef EXT3
+#define PyInt_FromLong PyLong_FromLong
+#endif
+static PyObject *
+PL_SolverType_threads_get(pl_solver_t *self, void *closure)
+{
+    return PyInt_FromLong(self->threads);
+}
+#ifdef EXT3
+#undef PyInt_FromLong
+#endif
+
+PyDoc_STRVAR(PL_SolverType_seed_doc,
+"The configured seed.\n\
+\n\
+:Type: ``int``");
+
+static PyObject *
+PL_SolverType_seed_get(pl_solver_t *self, void *closure)
+{
+    return PyLong_FromUnsignedLongLong((unsigned PY_LONG_LONG)self->seed);
+}
+
+PyDoc_STRVAR(PL_SolverType_hogwild_doc,
+"Run the coordinate descent solvers in parallel?\n\
+\n\
+:Type: ``bool``");
+
+static PyObject *
+PL_SolverType_hogwild_get(pl_solver_t *self, void *closure)
+{
+    return PyBool_FromLong(self->hogwild);
+}
+
+PyDoc_STRVAR(PL_SolverType_max_iter_doc,
+"The configured iteration limit or ``None``.\n\
+\n\
+:Type: ``int``");
+
+#ifdef EXT3
+#define PyInt_FromLong PyLong_FromLong
+#endif
+static PyObject *
+PL_SolverType_max_iter_get(pl_solver_t *self, void *closure)
+{
+    if (!self->max_iter)
+        Py_RETURN_NONE;
+
+    return PyInt_FromLong(self->max_iter);
+}
+#ifdef EXT3
+#undef PyInt_FromLong
+#endif
+
+PyDoc_STRVAR(PL_SolverType_time_limit_doc,
+"The configured time limit (in seconds) or ``None``.\n\
+\n\
+:Type: ``float``");
+
+static PyObject *
+PL_SolverType_time_limit_get(pl_solver_t *self, void *closure)
+{
+    if (!(self->time_limit > 0))
+        Py_RETURN_NONE;
+
+    return PyFloat_FromDouble(self->time_limit);
+}
+
 PyDoc_STRVAR(PL_SolverType_nu_doc,
 "The configured nu parameter.\n\
 \n\
@@ -702,6 +979,36 @@ PL_SolverType_type_get(pl_solver_t *self, void *closure)
 #endif
 
 static PyGetSetDef PL_SolverType_getset[] = {
+    {"threads",
+     (getter)PL_SolverType_threads_get,
+     NULL,
+     PL_SolverType_threads_doc,
+     NULL},
+
+    {"seed",
+     (getter)PL_SolverType_seed_get,
+     NULL,
+     PL_SolverType_seed_doc,
+     NULL},
+
+    {"hogwild",
+     (getter)PL_SolverType_hogwild_get,
+     NULL,
+     PL_SolverType_hogwild_doc,
+     NULL},
+
+    {"max_iter",
+     (getter)PL_SolverType_max_iter_get,
+     NULL,
+     PL_SolverType_max_iter_doc,
+     NULL},
+
+    {"time_limit",
+     (getter)PL_SolverType_time_limit_get,
+     NULL,
+     PL_SolverType_time_limit_doc,
+     NULL},
+
     {"nu",
      (getter)PL_SolverType_nu_get,
      NULL,
@@ -764,17 +1071,23 @@ PL_SolverType_clear(pl_solver_t *self)
 static PyObject *
 PL_SolverType_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
 {
-    static char *kwlist[] = {"type", "C", "eps", "p", "nu", "weights", NULL};
+    static char *kwlist[] = {"type", "C", "eps", "p", "nu", "weights",
+                             "threads", "seed", "hogwild", "max_iter",
+                             "time_limit", NULL};
     PyObject *type_ = NULL, *C_ = NULL, *eps_ = NULL, *p_ = NULL, *nu_ = NULL,
-             *weights_ = NULL;
+             *weights_ = NULL, *threads_ = NULL, *seed_ = NULL,
+             *hogwild_ = NULL, *max_iter_ = NULL, *time_limit_ = NULL;
     pl_solver_t *self;
     double *weight;
     int *weight_label;
-    double C, eps, p, nu;
-    int int_type, nr_weight;
-
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OOOOOO", kwlist,
-                                     &type_, &C_, &eps_, &p_, &nu_, &weights_))
+    double C, eps, p, nu, time_limit = 0;
+    PY_UINT64_T seed = 0;
+    int int_type, nr_weight, threads = 1, hogwild = 0, max_iter = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OOOOOOOOOOO", kwlist,
+                                     &type_, &C_, &eps_, &p_, &nu_, &weights_,
+                                     &threads_, &seed_, &hogwild_, &max_iter_,
+                                     &time_limit_))
         return NULL;
 
     if (pl_solver_type_as_int(type_, &int_type) == -1)
@@ -824,6 +1137,45 @@ PL_SolverType_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
         }
     }
 
+    if (threads_ && threads_ != Py_None) {
+        Py_INCREF(threads_);
+        if (pl_as_int(threads_, &threads) == -1)
+            return NULL;
+        if (threads < 1) {
+            PyErr_SetString(PyExc_ValueError, "threads must be > 0");
+            return NULL;
+        }
+    }
+
+    if (seed_ && seed_ != Py_None) {
+        Py_INCREF(seed_);
+        if (pl_as_seed(seed_, &seed) == -1)
+            return NULL;
+    }
+
+    if (hogwild_ && (hogwild = PyObject_IsTrue(hogwild_)) == -1)
+        return NULL;
+
+    if (max_iter_ && max_iter_ != Py_None) {
+        Py_INCREF(max_iter_);
+        if (pl_as_int(max_iter_, &max_iter) == -1)
+            return NULL;
+        if (max_iter < 1) {
+            PyErr_SetString(PyExc_ValueError, "max_iter must be > 0");
+            return NULL;
+        }
+    }
+
+    if (time_limit_ && time_limit_ != Py_None) {
+        Py_INCREF(time_limit_);
+        if (pl_as_double(time_limit_, &time_limit) == -1)
+            return NULL;
+        if (!(time_limit > 0)) {
+            PyErr_SetString(PyExc_ValueError, "time_limit must be > 0");
+            return NULL;
+        }
+    }
+
     if (!weights_ || weights_ == Py_None) {
         weight = NULL;
         weight_label = NULL;
@@ -848,6 +1200,11 @@ PL_SolverType_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
     self->weight = weight;
     self->weight_label = weight_label;
     self->init_sol = NULL;
+    self->threads = threads;
+    self->seed = seed;
+    self->hogwild = hogwild;
+    self->max_iter = max_iter;
+    self->time_limit = time_limit;
 
     return (PyObject *)self;
 }
@@ -23,7 +23,9 @@
  */
 typedef struct pl_buf_t {
     struct pl_buf_t *prev;
-    PyObject *string;
+    PyObject *string;  /* NULL if the buf points into the mapped buffer */
+    char *data;
+    Py_ssize_t size;
     Py_ssize_t pos;
 } pl_buf_t;
 
@@ -39,10 +41,16 @@ typedef struct {
     PyObject *toko;
     pl_tok_t tok;
     int flags;
+
+    PyObject *map;     /* Buffer object scanned in place or NULL */
+#ifdef EXT3
+    Py_buffer view;
+#endif
 } pl_tokread_iter_ctx_t;
 
 
 #ifdef EXT3
+#define PyString_AS_STRING PyBytes_AS_STRING
 #define PyString_GET_SIZE PyBytes_GET_SIZE
 
 /*
@@ -106,6 +114,8 @@ pl_buf_new(pl_buf_t **buf_, PyObject *obj)
 
     buf->prev = *buf_;
     buf->string = str;
+    buf->data = PyString_AS_STRING(str);
+    buf->size = PyString_GET_SIZE(str);
     buf->pos = 0;
     *buf_ = buf;
 
@@ -114,6 +124,7 @@ pl_buf_new(pl_buf_t **buf_, PyObject *obj)
 
 #ifdef EXT3
 #undef PyString_GET_SIZE
+#undef PyString_AS_STRING
 #else
 #undef pl_obj_as_string
 #endif
@@ -129,7 +140,7 @@ pl_buf_clear(pl_buf_t **buf_)
 
     while ((buf = *buf_)) {
         *buf_ = buf->prev;
-        Py_DECREF(buf->string);
+        Py_XDECREF(buf->string);
         PyMem_Free(buf);
     }
 }
@@ -137,7 +148,6 @@ pl_buf_clear(pl_buf_t **buf_)
 
 #ifdef EXT3
 #define PyString_AS_STRING PyBytes_AS_STRING
-#define PyString_GET_SIZE PyBytes_GET_SIZE
 #define PyString_FromStringAndSize PyBytes_FromStringAndSize
 #endif
 
@@ -150,7 +160,7 @@ static int
 pl_tokread_tok(pl_tokread_iter_ctx_t *ctx, Py_ssize_t pos)
 {
     pl_buf_t *buf = ctx->buf;
-    char *t, *b = PyString_AS_STRING(buf->string);
+    char *t, *b = buf->data;
     Py_ssize_t size;
 
     if (!buf->prev) {
@@ -159,8 +169,7 @@ pl_tokread_tok(pl_tokread_iter_ctx_t *ctx, Py_ssize_t pos)
     }
     else {
         for (size = pos; (buf = buf->prev); )
-            size += PyString_GET_SIZE(buf->string)
-                                      - (!buf->prev ? buf->pos - 1 : 0);
+            size += buf->size - (!buf->prev ? buf->pos - 1 : 0);
         Py_CLEAR(ctx->toko);
         if (!(ctx->toko = PyString_FromStringAndSize(NULL, size)))
             return -1;
@@ -170,8 +179,8 @@ pl_tokread_tok(pl_tokread_iter_ctx_t *ctx, Py_ssize_t pos)
         t = ctx->tok.sentinel - pos;
         (void)memcpy(t, b, (size_t)pos);
         for (buf = ctx->buf; (buf = buf->prev); ) {
-            size = PyString_GET_SIZE(buf->string);
-            b = PyString_AS_STRING(buf->string);
+            size = buf->size;
+            b = buf->data;
             if (!buf->prev) {
                 size -= buf->pos - 1;
                 b += buf->pos - 1;
@@ -188,6 +197,29 @@ pl_tokread_tok(pl_tokread_iter_ctx_t *ctx, Py_ssize_t pos)
 }
 
 
+/*
+ * Copy the current token into its own string
+ *
+ * This is needed for the last token of a mapped buffer, which is not
+ * followed by any terminating byte.
+ *
+ * Return -1 on error
+ */
+static int
+pl_tokread_tok_copy(pl_tokread_iter_ctx_t *ctx)
+{
+    Py_ssize_t size = ctx->tok.sentinel - ctx->tok.start;
+
+    Py_CLEAR(ctx->toko);
+    if (!(ctx->toko = PyString_FromStringAndSize(ctx->tok.start, size)))
+        return -1;
+
+    ctx->tok.start = PyString_AS_STRING(ctx->toko);
+    ctx->tok.sentinel = ctx->tok.start + size;
+    return 0;
+}
+
+
 /*
  * Scan for next token
  *
@@ -203,26 +235,22 @@ pl_tokread_scan(pl_tokread_iter_ctx_t *ctx)
     if (!ctx->buf)
         return 1;
 
-    b = PyString_AS_STRING(ctx->buf->string);
+    b = ctx->buf->data;
     c = b + ctx->buf->pos;
-    s = b + PyString_GET_SIZE(ctx->buf->string);
+    s = b + ctx->buf->size;
 
     while (c < s) {
         /* Currently reading a tok */
         if (PL_FLAG_IN_TOK & ctx->flags) {
-            switch (*c) {
-            case ' ': case '\t': case '\n': case '\r':
-                return pl_tokread_tok(ctx, c - b);
+            if ((c = (char *)pl_scan_delim(c, s)) == s)
+                break;
 
-            case '\0':
+            if (!*c) {
                 PyErr_SetString(PyExc_ValueError,
                                 "Unexpected \\0 byte in token");
                 return -1;
-
-            default:
-                ++c;
-                break;
             }
+            return pl_tokread_tok(ctx, c - b);
         }
 
         /* Currently skipping space */
@@ -290,8 +318,9 @@ pl_tokread_iter_next(void *ctx_, void **tok_)
 
             if (PL_FLAG_EOF & ctx->flags) {
                 if (PL_FLAG_IN_TOK & ctx->flags) {
-                    if (-1 == pl_tokread_tok(ctx,
-                                        PyString_GET_SIZE(ctx->buf->string)))
+                    if (pl_tokread_tok(ctx, ctx->buf->size) == -1)
+                        return -1;
+                    if (!ctx->buf->string && pl_tokread_tok_copy(ctx) == -1)
                         return -1;
 
                     *tok_ = &ctx->tok;
@@ -326,7 +355,6 @@ pl_tokread_iter_next(void *ctx_, void **tok_)
 
 #ifdef EXT3
 #undef PyString_FromStringAndSize
-#undef PyString_GET_SIZE
 #undef PyString_AS_STRING
 #endif
 
@@ -340,6 +368,12 @@ pl_tokread_iter_clear(void *ctx_)
         Py_CLEAR(ctx->read);
         Py_CLEAR(ctx->toko);
         pl_buf_clear(&ctx->buf);
+        if (ctx->map) {
+#ifdef EXT3
+            PyBuffer_Release(&ctx->view);
+#endif
+            Py_CLEAR(ctx->map);
+        }
         PyMem_Free(ctx);
     }
 }
@@ -353,6 +387,7 @@ pl_tokread_iter_visit(void *ctx_, visitproc visit, void *arg)
     if (ctx) {
         Py_VISIT(ctx->read);
         Py_VISIT(ctx->toko);
+        Py_VISIT(ctx->map);
     }
 
     return 0;
@@ -378,6 +413,7 @@ pl_tokread_iter_new(PyObject *read)
     ctx->read = read;
     ctx->buf = NULL;
     ctx->toko = NULL;
+    ctx->map = NULL;
     ctx->flags = 0;
 
     if (!(result = pl_iter_new(ctx, pl_tokread_iter_next,
@@ -393,6 +429,77 @@ error_read:
     return NULL;
 }
 
+
+/*
+ * Create new tok reader scanning a buffer object in place
+ *
+ * map is stolen and cleared on error.
+ *
+ * Return NULL on error
+ */
+pl_iter_t *
+pl_tokread_iter_map_new(PyObject *map)
+{
+    pl_iter_t *result;
+    pl_tokread_iter_ctx_t *ctx;
+    pl_buf_t *buf;
+    const void *data;
+    Py_ssize_t size;
+
+    if (!(ctx = PyMem_Malloc(sizeof *ctx))) {
+        PyErr_SetNone(PyExc_MemoryError);
+        goto error_map;
+    }
+
+#ifdef EXT2
+    if (-1 == PyObject_AsReadBuffer(map, &data, &size))
+        goto error_ctx;
+#else
+    if (-1 == PyObject_GetBuffer(map, &ctx->view, PyBUF_SIMPLE))
+        goto error_ctx;
+    data = ctx->view.buf;
+    size = ctx->view.len;
+#endif
+
+    ctx->read = NULL;
+    ctx->buf = NULL;
+    ctx->toko = NULL;
+    ctx->map = map;
+    ctx->flags = PL_FLAG_EOF;
+
+    if (size > 0) {
+        if (!(buf = PyMem_Malloc(sizeof *buf))) {
+            PyErr_SetNone(PyExc_MemoryError);
+            goto error_view;
+        }
+        buf->prev = NULL;
+        buf->string = NULL;
+        buf->data = (char *)data;
+        buf->size = size;
+        buf->pos = 0;
+        ctx->buf = buf;
+    }
+
+    if (!(result = pl_iter_new(ctx, pl_tokread_iter_next,
+                               pl_tokread_iter_clear, pl_tokread_iter_visit)))
+        goto error_buf;
+
+    return result;
+
+error_buf:
+    if (ctx->buf)
+        PyMem_Free(ctx->buf);
+error_view:
+#ifdef EXT3
+    PyBuffer_Release(&ctx->view);
+#endif
+error_ctx:
+    PyMem_Free(ctx);
+error_map:
+    Py_DECREF(map);
+    return NULL;
+}
+
 #if (PL_TEST == 1)
 /* ---------------------- BEGIN TokReader DEFINITION --------------------- */
 
@@ -31,6 +31,15 @@ pl_unpack2(PyObject *obj, PyObject **one, PyObject **two)
     PyObject *iter;
     static const char *msg = "Expected 2-tuple";
 
+    if (PyTuple_CheckExact(obj) && PyTuple_GET_SIZE(obj) == 2) {
+        *one = PyTuple_GET_ITEM(obj, 0);
+        *two = PyTuple_GET_ITEM(obj, 1);
+        Py_INCREF(*one);
+        Py_INCREF(*two);
+        Py_DECREF(obj);
+        return 0;
+    }
+
     iter = PyObject_GetIter(obj);
     Py_DECREF(obj);
     if (!iter)
@@ -82,6 +91,12 @@ pl_as_double(PyObject *obj, double *result)
     if (!obj)
         return -1;
 
+    if (PyFloat_CheckExact(obj)) {
+        *result = PyFloat_AS_DOUBLE(obj);
+        Py_DECREF(obj);
+        return 0;
+    }
+
     tmp = PyNumber_Float(obj);
     Py_DECREF(obj);
     if (!tmp)
@@ -219,3 +234,36 @@ pl_attr(PyObject *obj, const char *name, PyObject **attr)
 
     return -1;
 }
+
+
+/*
+ * Convert object to a random seed
+ *
+ * Any integer is accepted, only the lower 64 bits are used.
+ *
+ * Reference to obj is stolen
+ *
+ * Return -1 on error
+ */
+int
+pl_as_seed(PyObject *obj, PY_UINT64_T *result)
+{
+    PyObject *tmp;
+    unsigned PY_LONG_LONG seed;
+
+    if (!obj)
+        return -1;
+
+    tmp = PyNumber_Index(obj);
+    Py_DECREF(obj);
+    if (!tmp)
+        return -1;
+
+    seed = PyLong_AsUnsignedLongLongMask(tmp);
+    Py_DECREF(tmp);
+    if (PyErr_Occurred())
+        return -1;
+
+    *result = (PY_UINT64_T)seed;
+    return 0;
+}
@@ -18,53 +18,285 @@
 #include "pyliblinear.h"
 
 
-/* Number of features per block */
-#define PL_FEATURE_BLOCK_SIZE \
-    ((size_t)((PL_BLOCK_LENGTH) / sizeof(struct feature_node)))
+/*
+ * Initialize an empty arena
+ */
+void
+pl_arena_init(pl_arena_t *arena)
+{
+    arena->nodes = NULL;
+    arena->nodes_size = arena->nodes_alloc = 0;
+    arena->rows = NULL;
+    arena->labels = NULL;
+    arena->rows_size = arena->rows_alloc = 0;
+    arena->width = 0;
+}
+
+
+/*
+ * Release the arena memory (the arena is empty afterwards)
+ */
+void
+pl_arena_clear(pl_arena_t *arena)
+{
+    void *ptr;
+
+    if ((ptr = arena->nodes))
+        PyMem_Free(ptr);
+    if ((ptr = arena->rows))
+        PyMem_Free(ptr);
+    if ((ptr = arena->labels))
+        PyMem_Free(ptr);
+
+    pl_arena_init(arena);
+}
+
+
+/*
+ * Empty the arena, but keep the memory for reuse
+ */
+void
+pl_arena_reset(pl_arena_t *arena)
+{
+    arena->nodes_size = 0;
+    arena->rows_size = 0;
+    arena->width = 0;
+}
+
+
+/*
+ * Compute a doubled capacity, so that size + more items fit
+ *
+ * Return 0 on overflow
+ */
+static size_t
+pl_arena_capacity(size_t alloc, size_t size, size_t more, size_t itemsize)
+{
+    size_t max = ((size_t)-1) / itemsize;
+
+    if (more > max - size)
+        return 0;
+
+    if (!alloc)
+        alloc = PL_BLOCK_LENGTH / itemsize;
+    while (alloc < size + more) {
+        if (alloc > max / 2)
+            return size + more;
+        alloc *= 2;
+    }
+
+    return alloc;
+}
+
+
+/*
+ * Make room for at least rows more rows and nodes more nodes
+ *
+ * Return -1 on error
+ */
+int
+pl_arena_reserve(pl_arena_t *arena, size_t rows, size_t nodes)
+{
+    void *ptr;
+    size_t alloc;
+
+    if (rows > arena->rows_alloc - arena->rows_size) {
+        if (!(alloc = pl_arena_capacity(arena->rows_alloc, arena->rows_size,
+                                        rows, sizeof *arena->rows)))
+            goto error;
+        if (!(ptr = PyMem_Realloc(arena->rows, alloc * sizeof *arena->rows)))
+            goto error;
+        arena->rows = ptr;
+        if (!(ptr = PyMem_Realloc(arena->labels,
+                                  alloc * sizeof *arena->labels)))
+            goto error;
+        arena->labels = ptr;
+        arena->rows_alloc = alloc;
+    }
+
+    if (nodes > arena->nodes_alloc - arena->nodes_size) {
+        if (!(alloc = pl_arena_capacity(arena->nodes_alloc,
+                                        arena->nodes_size, nodes,
+                                        sizeof *arena->nodes)))
+            goto error;
+        if (!(ptr = PyMem_Realloc(arena->nodes,
+                                  alloc * sizeof *arena->nodes)))
+            goto error;
+        arena->nodes = ptr;
+        arena->nodes_alloc = alloc;
+    }
+
+    return 0;
+
+error:
+    PyErr_SetNone(PyExc_MemoryError);
+    return -1;
+}
+
+
+/*
+ * Start a new row (adds the bias node)
+ *
+ * Return -1 on error
+ */
+int
+pl_arena_row_open(pl_arena_t *arena, double label)
+{
+    struct feature_node *node;
+
+    if (!(arena->rows_size < (size_t)(INT_MAX - 1))) {
+        PyErr_SetNone(PyExc_OverflowError);
+        return -1;
+    }
+    if (pl_arena_reserve(arena, 1, 2) == -1)
+        return -1;
+
+    arena->rows[arena->rows_size] = arena->nodes_size;
+    arena->labels[arena->rows_size++] = label;
+
+    node = &arena->nodes[arena->nodes_size++];
+    node->index = 0;
+    node->value = 0.0;
+
+    return 0;
+}
+
+
+/*
+ * Add a feature to the current row
+ *
+ * Zero values are skipped. The arena width is updated.
+ *
+ * Return -1 on error
+ */
+int
+pl_arena_feature_add(pl_arena_t *arena, int index, double value)
+{
+    struct feature_node *node;
+
+    if (value == 0.0)
+        return 0;
+
+    /* Keep room for the sentinel */
+    if (arena->nodes_alloc - arena->nodes_size < 2
+        && pl_arena_reserve(arena, 0, 2) == -1)
+        return -1;
+
+    if (index > arena->width)
+        arena->width = index;
+
+    node = &arena->nodes[arena->nodes_size++];
+    node->index = index;
+    node->value = value;
 
-typedef struct pl_feature_block {
-    struct pl_feature_block *prev;
-    size_t size;
-    struct feature_node feature[PL_FEATURE_BLOCK_SIZE];
-} pl_feature_block_t;
+    return 0;
+}
 
 
 /*
- * Clear all feature blocks
+ * Finish the current row (adds the sentinel)
+ *
+ * Return -1 on error
  */
-static void
-pl_feature_blocks_clear(pl_feature_block_t **features_)
+int
+pl_arena_row_close(pl_arena_t *arena)
 {
-    pl_feature_block_t *block;
+    struct feature_node *node;
+
+    if (pl_arena_reserve(arena, 0, 1) == -1)
+        return -1;
 
-    while ((block = *features_)) {
-        *features_ = block->prev;
-        PyMem_Free(block);
+    node = &arena->nodes[arena->nodes_size++];
+    node->index = -1;
+    node->value = 0.0;
+
+    return 0;
+}
+
+
+/*
+ * Add a complete row from an array of features
+ *
+ * The features are expected to be non-zero already. The arena width is
+ * updated.
+ *
+ * Return -1 on error
+ */
+int
+pl_arena_row_copy(pl_arena_t *arena, double label,
+                  const struct feature_node *features, size_t size)
+{
+    struct feature_node *node;
+    size_t j;
+    int width = arena->width;
+
+    if (pl_arena_row_open(arena, label) == -1)
+        return -1;
+    if (pl_arena_reserve(arena, 0, size + 1) == -1)
+        return -1;
+
+    node = &arena->nodes[arena->nodes_size];
+    for (j = 0; j < size; ++j) {
+        node[j] = features[j];
+        if (features[j].index > width)
+            width = features[j].index;
     }
+    arena->nodes_size += size;
+    arena->width = width;
+
+    return pl_arena_row_close(arena);
 }
 
 
 /*
- * Get new feature, allocate new block if needed
+ * Hand over the collected rows
+ *
+ * vectors receives the row pointers (pointing behind the bias nodes), nodes
+ * the node array they point into. All result arrays are NULL if there are no
+ * rows. The arena is empty afterwards.
  *
- * Return NULL on error
+ * Return -1 on error
  */
-static struct feature_node *
-pl_feature_new(pl_feature_block_t **features_)
+int
+pl_arena_finish(pl_arena_t *arena, struct feature_node ***vectors_,
+                struct feature_node **nodes_, double **labels_,
+                int *height_, int *width_)
 {
-    pl_feature_block_t *block = *features_;
+    struct feature_node **vectors = NULL, *nodes = NULL;
+    double *labels = NULL;
+    void *ptr;
+    size_t j;
 
-    if (!block || !(block->size < (PL_FEATURE_BLOCK_SIZE - 1))) {
-        if (!(block = PyMem_Malloc(sizeof *block))) {
+    if (arena->rows_size) {
+        if (!(vectors = PyMem_Malloc(arena->rows_size * (sizeof *vectors)))) {
             PyErr_SetNone(PyExc_MemoryError);
-            return NULL;
+            return -1;
         }
-        block->prev = *features_;
-        block->size = 0;
-        *features_ = block;
+
+        /* Give back the unused rest */
+        nodes = arena->nodes;
+        if ((ptr = PyMem_Realloc(nodes, arena->nodes_size * (sizeof *nodes))))
+            nodes = ptr;
+        labels = arena->labels;
+        if ((ptr = PyMem_Realloc(labels,
+                                 arena->rows_size * (sizeof *labels))))
+            labels = ptr;
+
+        for (j = 0; j < arena->rows_size; ++j)
+            vectors[j] = nodes + arena->rows[j] + 1; /* skip [0] (bias) */
+
+        arena->nodes = NULL;
+        arena->labels = NULL;
     }
 
-    return &block->feature[block->size++];
+    *vectors_ = vectors;
+    *nodes_ = nodes;
+    *labels_ = labels;
+    *height_ = (int)arena->rows_size;
+    *width_ = arena->width;
+
+    pl_arena_clear(arena);
+    return 0;
 }
 
 
@@ -137,78 +369,103 @@ pl_vector_iterator_find(PyObject **vector_, PyObject **iter_, char *how)
 
 
 /*
- * Create the array of features
- *
- * features are cleared in the process.
+ * Load the features of an exact dict ({index: value, ...})
  *
- * Return -1 on error
+ * Return -1 on failure
  */
 static int
-pl_features_as_array(pl_feature_block_t **features,
-                     struct feature_node **array_, int *size_)
+pl_vector_load_dict(PyObject *vector, pl_arena_t *arena)
 {
-    pl_feature_block_t *block;
-    struct feature_node *array, *node;
-    size_t no_features, idx_feature;
+    PyObject *key, *item;
+    Py_ssize_t pos = 0;
+    double value;
+    int index;
 
-    /* count number of features, plus 1 sentinel plus one bias node */
-    for (no_features = 2, block = *features; block; block = block->prev)
-        no_features += block->size;
+    while (PyDict_Next(vector, &pos, &key, &item)) {
+        /* The conversions may run python code, which may modify the dict */
+        Py_INCREF(key);
+        Py_INCREF(item);
+        if (pl_as_index(key, &index) == -1) {
+            Py_DECREF(item);
+            return -1;
+        }
+        if (pl_as_double(item, &value) == -1)
+            return -1;
 
-    if (no_features > (size_t)INT_MAX) {
-        PyErr_SetNone(PyExc_OverflowError);
-        goto error_features;
+        if (pl_arena_feature_add(arena, index, value) == -1)
+            return -1;
     }
 
-    if (!(array = PyMem_Malloc(no_features * (sizeof *array)))) {
-        PyErr_SetNone(PyExc_MemoryError);
-        goto error_features;
-    }
+    return 0;
+}
 
-    *array_ = array;
-    *size_ = (int)no_features;
 
-    /* Sentinel feature */
-    node = &array[--no_features];
-    node->index = -1;
-    node->value = 0.0;
+/*
+ * Load the features of an exact list or tuple ([value, ...])
+ *
+ * Return -1 on failure
+ */
+static int
+pl_vector_load_sequence(PyObject *vector, pl_arena_t *arena)
+{
+    PyObject *item;
+    Py_ssize_t j;
+    double value;
 
-    /* Real features */
-    for (block = *features; block; block = block->prev) {
-        for (idx_feature = block->size; idx_feature > 0; ) {
-            node = &array[--no_features];
-            node->index = block->feature[--idx_feature].index;
-            node->value = block->feature[idx_feature].value;
+    /* The size is re-read, because a list may shrink during conversion */
+    for (j = 0; j < PySequence_Fast_GET_SIZE(vector); ++j) {
+        if (!(j < (INT_MAX - 1))) {
+            PyErr_SetNone(PyExc_OverflowError);
+            return -1;
         }
+        item = PySequence_Fast_GET_ITEM(vector, j);
+        Py_INCREF(item);
+        if (pl_as_double(item, &value) == -1)
+            return -1;
+
+        if (pl_arena_feature_add(arena, (int)j + 1, value) == -1)
+            return -1;
     }
-    pl_feature_blocks_clear(features);
 
     return 0;
-
-error_features:
-    pl_feature_blocks_clear(features);
-    return -1;
 }
 
 
 /*
- * Load a pythonic feature vector into our own structures
+ * Load a pythonic feature vector into the arena as a new row
+ *
+ * Exact dicts, lists and tuples are read directly. Anything else is
+ * inspected for items() or keys() or just iterated over.
  *
  * Reference to vector_ is stolen
  *
  * Return -1 on failure
  */
 int
-pl_vector_load(PyObject *vector_, struct feature_node **array_, int *size_,
-               int *max_index)
+pl_vector_load(PyObject *vector_, double label, pl_arena_t *arena)
 {
     PyObject *item, *iter, *tmp, *tmp2;
-    pl_feature_block_t *features_ = NULL;
-    struct feature_node *feature;
     double value;
-    int index = 0;
+    int index = 0, res;
     char how;
 
+    if (pl_arena_row_open(arena, label) == -1) {
+        Py_DECREF(vector_);
+        return -1;
+    }
+
+    if (PyDict_CheckExact(vector_) || PyList_CheckExact(vector_)
+        || PyTuple_CheckExact(vector_)) {
+        if (PyDict_CheckExact(vector_))
+            res = pl_vector_load_dict(vector_, arena);
+        else
+            res = pl_vector_load_sequence(vector_, arena);
+        Py_DECREF(vector_);
+        if (res == -1)
+            return -1;
+        return pl_arena_row_close(arena);
+    }
+
     if (pl_vector_iterator_find(&vector_, &iter, &how) == -1)
         return -1;
 
@@ -249,31 +506,20 @@ pl_vector_load(PyObject *vector_, struct feature_node **array_, int *size_,
             break;
         }
 
-        if (value == 0.0)
-            continue;
-
-        if (index > *max_index)
-            *max_index = index;
-
-        if (!(feature = pl_feature_new(&features_)))
+        if (pl_arena_feature_add(arena, index, value) == -1)
             goto error_iter;
-
-        feature->index = index;
-        feature->value = value;
     }
     if (PyErr_Occurred())
         goto error_iter;
 
     Py_DECREF(iter);
     Py_XDECREF(vector_);
-    return pl_features_as_array(&features_, array_, size_);
+    return pl_arena_row_close(arena);
 
 error_item:
     Py_DECREF(item);
 error_iter:
     Py_DECREF(iter);
     Py_XDECREF(vector_);
-
-    pl_feature_blocks_clear(&features_);
     return -1;
 }
@@ -186,11 +186,16 @@ EXTENSIONS = lambda v: [
         "pyliblinear._liblinear",
         [
             "pyliblinear/bufwriter.c",
+            "pyliblinear/cancel.c",
             "pyliblinear/compat.c",
             "pyliblinear/iter.c",
+            "pyliblinear/lineparse.c",
             "pyliblinear/main.c",
             "pyliblinear/matrix.c",
             "pyliblinear/model.c",
+            "pyliblinear/numparse.c",
+            "pyliblinear/parallel.c",
+            "pyliblinear/scan.c",
             "pyliblinear/solver.c",
             "pyliblinear/tokreader.c",
             "pyliblinear/util.c",
@@ -204,6 +209,7 @@ EXTENSIONS = lambda v: [
         ],
         depends=[
             "pyliblinear/pyliblinear.h",
+            "pyliblinear/pow5.h",
             "pyliblinear/liblinear/linear.h",
             "pyliblinear/liblinear/newton.h",
             "pyliblinear/liblinear/blas/blasp.h",
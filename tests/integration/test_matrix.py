@@ -27,7 +27,12 @@ Tests for pyliblinear.FeatureMatrix
 """
 __author__ = u"Andr\xe9 Malo"
 
+import array as _array
+import bz2 as _bz2
+import io as _io
 import os as _os
+import random as _random
+import struct as _struct
 
 from pytest import raises
 
@@ -37,6 +42,11 @@ import pyliblinear as _pyliblinear
 # pylint: disable = protected-access
 
 
+def fix_path(name):
+    """Find fixture"""
+    return _os.path.join(_os.path.dirname(__file__), "fixtures", name)
+
+
 def test_matrix_dict():
     """FeatureMatrix from dicts"""
     matrix = _pyliblinear.FeatureMatrix(
@@ -64,6 +74,199 @@ def test_matrix_load_save(tmpdir):
     assert list(matrix.features()) == [{1: 7.0, 3: 4.0}, {2: 1.0}]
 
 
+def test_matrix_load_save_binary(tmpdir):
+    """FeatureMatrix load_binary / save_binary"""
+    filename = _os.path.join(str(tmpdir), "matrix_load_save_binary.bin")
+    with _bz2.BZ2File(fix_path("a1a.t.bz2")) as fp:
+        expected = _pyliblinear.FeatureMatrix.load(fp)
+    expected.save_binary(filename)
+
+    stream = _io.BytesIO()
+    expected.save_binary(stream)
+    with open(filename, "rb") as fp:
+        assert fp.read() == stream.getvalue()
+
+    for matrix in [
+        _pyliblinear.FeatureMatrix.load_binary(filename),
+        _pyliblinear.FeatureMatrix.load_binary(filename, mmap=False),
+        _pyliblinear.FeatureMatrix.load_binary(_io.BytesIO(stream.getvalue())),
+    ]:
+        assert matrix.width == expected.width
+        assert matrix.height == expected.height
+        assert list(matrix.labels()) == list(expected.labels())
+        assert list(matrix.features()) == list(expected.features())
+
+    matrix = _pyliblinear.FeatureMatrix([])
+    matrix.save_binary(filename)
+    matrix = _pyliblinear.FeatureMatrix.load_binary(filename)
+    assert matrix.height == 0
+    assert matrix.width == 0
+
+    data = stream.getvalue()
+    for broken in [b"", data[:100], b"X" + data[1:], data[:-8]]:
+        with raises(ValueError):
+            _pyliblinear.FeatureMatrix.load_binary(_io.BytesIO(broken))
+
+    # Feature indexes out of range are rejected, mapped or not
+    matrix = _pyliblinear.FeatureMatrix([(1, {1: 2.0, 2: 3.0})])
+    stream = _io.BytesIO()
+    matrix.save_binary(stream)
+    data = bytearray(stream.getvalue())
+    pos = bytes(data).index(_struct.pack("=d", 3.0)) - 8
+    assert _struct.unpack("=i", bytes(data[pos:pos + 4])) == (2,)
+    data[pos:pos + 4] = _struct.pack("=i", 50000000)
+    with open(filename, "wb") as fp:
+        fp.write(data)
+    for mmap in (True, False):
+        with raises(ValueError):
+            _pyliblinear.FeatureMatrix.load_binary(filename, mmap=mmap)
+
+
+def test_matrix_load_stream():
+    """FeatureMatrix load from stream"""
+    matrix = _pyliblinear.FeatureMatrix.load(_io.BytesIO(
+        b"1 3:4 1:7\r\n-2.7\t2:1  5:0\r3 \n4"
+    ))
+
+    assert matrix.width == 3
+    assert matrix.height == 4
+    assert list(matrix.labels()) == [1.0, -2.0, 3.0, 4.0]
+    assert list(matrix.features()) == [{1: 7.0, 3: 4.0}, {2: 1.0}, {}, {}]
+
+
+def test_matrix_load_mapped(tmpdir):
+    """FeatureMatrix load from mapped file"""
+    filename = _os.path.join(str(tmpdir), "matrix_load_mapped.matrix")
+    line = b"1 1:2 3:4.5\n"
+    data = line * (4096 // len(line) - 1)
+    data += b"2 " + b"0" * (4096 - len(data) - 5) + b"2:1"
+    assert len(data) == 4096
+    with open(filename, "wb") as fp:
+        fp.write(data)
+    matrix = _pyliblinear.FeatureMatrix.load(filename)
+
+    assert matrix.width == 3
+    assert matrix.height == 4096 // len(line)
+    assert list(matrix.labels())[-2:] == [1.0, 2.0]
+    assert list(matrix.features())[-2:] == [{1: 2.0, 3: 4.5}, {2: 1.0}]
+
+    with open(filename, "wb"):
+        pass
+    with raises(ValueError):
+        _pyliblinear.FeatureMatrix.load(filename)
+
+
+def test_matrix_load_threads(tmpdir):
+    """FeatureMatrix load with multiple threads"""
+    filename = _os.path.join(str(tmpdir), "matrix_load_threads.matrix")
+    with _bz2.BZ2File(fix_path("a1a.t.bz2")) as fp:
+        data = fp.read()
+    with open(filename, "wb") as fp:
+        fp.write(data)
+
+    expected = _pyliblinear.FeatureMatrix.load(_io.BytesIO(data))
+    for matrix in [
+        _pyliblinear.FeatureMatrix.load(filename, threads=4),
+        _pyliblinear.FeatureMatrix.load(_io.BytesIO(data), threads=3),
+    ]:
+        assert matrix.width == expected.width
+        assert matrix.height == expected.height
+        assert list(matrix.labels()) == list(expected.labels())
+        assert list(matrix.features()) == list(expected.features())
+
+    with raises(ValueError):
+        _pyliblinear.FeatureMatrix.load(
+            _io.BytesIO(data + b"\n" + data), threads=4
+        )
+    with raises(ValueError):
+        _pyliblinear.FeatureMatrix.load(filename, threads=0)
+
+
+def test_matrix_load_delimiters():
+    """FeatureMatrix load handles delimiters in long and short tokens"""
+    value = 0.12345678901234567
+    line = b"1\t" + b" ".join(
+        b"%d:%s" % (idx, repr(value * idx).encode("ascii"))
+        for idx in range(1, 40)
+    )
+    matrix = _pyliblinear.FeatureMatrix.load(_io.BytesIO(
+        line + b" \0\r" + line + b"\r\n" + line
+    ))
+    assert matrix.height == 3
+    assert list(matrix.features()) == [
+        dict((idx, value * idx) for idx in range(1, 40))
+    ] * 3
+
+    with raises(ValueError):
+        _pyliblinear.FeatureMatrix.load(_io.BytesIO(
+            line + b"\n1 " + b"1" * 40 + b"\0:1\n"
+        ))
+
+
+def test_matrix_load_numbers():
+    """FeatureMatrix load parses numbers exactly like float()"""
+    values = [
+        "1", "+2", "-3.", ".5", "-.25", "0.1", "1e-3", "2.5E+2", "-0",
+        "0.000", "9007199254740993", "0.30000000000000004",
+        "1.7976931348623157e308", "2.2250738585072014e-308", "5e-324",
+        "4.9406564584124654e-324", "1e-400", "123456789012345678901234",
+        "0." + "0" * 30 + "1", "1" + "0" * 400 + "e-400",
+        "2.00000000000000011102230246251565404236316680908203125",
+        "2.00000000000000011102230246251565404236316680908203124",
+        "2.00000000000000011102230246251565404236316680908203126",
+    ]
+    rand = _random.Random(42)
+    values.extend(repr(rand.uniform(-1e6, 1e6)) for _ in range(200))
+    values.extend(
+        "%.*fe%d" % (
+            rand.randint(0, 25), rand.random() * 10.0, rand.randint(-300, 300)
+        )
+        for _ in range(200)
+    )
+    values = [value for value in values if float(value)]
+
+    # subnormals make the threaded parser fall back to the token reader
+    for subset in [values, [
+        value for value in values if abs(float(value)) >= 1e-300
+    ]]:
+        line = b"1 " + b" ".join(
+            b"%d:%s" % (idx, value.encode("ascii"))
+            for idx, value in enumerate(subset, 1)
+        ) + b"\n"
+        expected = dict(
+            (idx, float(value)) for idx, value in enumerate(subset, 1)
+        )
+
+        data = line * (1 + (1 << 18) // len(line))
+        for matrix in [
+            _pyliblinear.FeatureMatrix.load(_io.BytesIO(line)),
+            _pyliblinear.FeatureMatrix.load(_io.BytesIO(data), threads=2),
+        ]:
+            assert all(vector == expected for vector in matrix.features())
+
+    matrix = _pyliblinear.FeatureMatrix.load(_io.BytesIO(b"-1e2 1:1\n"))
+    assert list(matrix.labels()) == [-100]
+
+
+def test_matrix_load_exc():
+    """FeatureMatrix load raises exceptions on invalid input"""
+    for data, exc in [
+        (b"1 1:1\n\n2 1:1\n", ValueError),
+        (b"x 1:1\n", ValueError),
+        (b"1 1\n", ValueError),
+        (b"1 1:x\n", ValueError),
+        (b"1 0:1\n", ValueError),
+        (b"1 -1:1\n", ValueError),
+        (b"nan 1:1\n", ValueError),
+        (b"1 99999999999:1\n", OverflowError),
+        (b"1e10 1:1\n", OverflowError),
+        (b"inf 1:1\n", OverflowError),
+        (b"1 1:1e999\n", OverflowError),
+    ]:
+        with raises(exc):
+            _pyliblinear.FeatureMatrix.load(_io.BytesIO(data))
+
+
 def test_matrix_dict_assign():
     """FeatureMatrix from dicts with assigned labels"""
     matrix = _pyliblinear.FeatureMatrix(
@@ -156,6 +359,46 @@ def test_matrix_keys_assign():
     ]
 
 
+class DictSubclass(dict):
+    """dict subclass (not an exact dict)"""
+
+
+class ListSubclass(list):
+    """list subclass (not an exact list)"""
+
+
+def test_matrix_vector_types():
+    """FeatureMatrix reads exact and other vector types the same way"""
+    dicts = [{3: 4, 1: 7.5, 2: 0}, {2: 1}]
+    lists = [[7.5, 0, 4], [0, 1]]
+
+    expected = [{1: 7.5, 3: 4.0}, {2: 1.0}]
+    for vectors in (
+        dicts,
+        [DictSubclass(vector) for vector in dicts],
+        lists,
+        [tuple(vector) for vector in lists],
+        [ListSubclass(vector) for vector in lists],
+        [iter(vector) for vector in lists],
+    ):
+        matrix = _pyliblinear.FeatureMatrix(vectors, assign_labels=1)
+        assert matrix.width == 3
+        assert matrix.height == 2
+        assert list(matrix.features()) == expected
+
+    for vector, exc in (
+        ({0: 1}, ValueError),
+        ({-1: 1}, ValueError),
+        ({1: "x"}, (TypeError, ValueError)),
+        ({"x": 1}, (TypeError, ValueError)),
+        ({2 ** 40: 1}, OverflowError),
+        ([1, None], TypeError),
+        ((1, "x"), (TypeError, ValueError)),
+    ):
+        with raises(exc):
+            _pyliblinear.FeatureMatrix([vector], assign_labels=1)
+
+
 def test_matrix_from_iterables_dict():
     """FeatureMatrix.from_iterables from dicts"""
     matrix = _pyliblinear.FeatureMatrix.from_iterables(
@@ -176,3 +419,128 @@ def test_matrix_from_iterables_exc():
             [2, 3],
             [{3: 4, 1: 7}, {2: 1}, {2, 1}],
         )
+
+
+def test_matrix_from_csr():
+    """FeatureMatrix.from_csr from buffers"""
+    matrix = _pyliblinear.FeatureMatrix.from_csr(
+        _array.array("i", [0, 2, 2, 5]),
+        _array.array("q", [0, 2, 1, 3, 4]),
+        _array.array("d", [7, 4, 1, -0.5, 0]),
+        _array.array("f", [2, -1.5, 3]),
+    )
+
+    assert matrix.width == 4
+    assert matrix.height == 3
+    assert list(matrix.labels()) == [2.0, -1.0, 3.0]
+    assert list(matrix.features()) == [
+        {1: 7.0, 3: 4.0}, {}, {2: 1.0, 4: -0.5}
+    ]
+
+    matrix = _pyliblinear.FeatureMatrix.from_csr(
+        b"\0", b"", _array.array("d"), _array.array("i")
+    )
+    assert matrix.height == 0
+    assert matrix.width == 0
+
+
+def test_matrix_from_csr_exc():
+    """FeatureMatrix.from_csr raises exceptions on invalid input"""
+    indptr, indices = _array.array("i", [0, 1]), _array.array("i", [0])
+    data, labels = _array.array("d", [1]), _array.array("d", [1])
+    for args, exc in [
+        ((indptr, _array.array("d", [0]), data, labels), TypeError),
+        ((indptr, indices, u"x", labels), TypeError),
+        ((indptr, indices, data, None), TypeError),
+        ((indptr, indices, _array.array("d"), labels), ValueError),
+        ((indptr, indices, data, _array.array("d", [1, 2])), ValueError),
+        ((_array.array("i", [0, 2]), indices, data, labels), ValueError),
+        ((_array.array("i", [1, 0]), indices, data, labels), ValueError),
+        ((_array.array("i", [1, 2, 3]), _array.array("i", [0, 2, 1]),
+          _array.array("d", [1, 2, 3]), _array.array("d", [1, 2])),
+         ValueError),
+        ((_array.array("i", [0, 1, 2]), _array.array("i", [0, 1, 2]),
+          _array.array("d", [1, 2, 3]), _array.array("d", [1, 2])),
+         ValueError),
+        ((indptr, _array.array("i", [-1]), data, labels), ValueError),
+        ((_array.array("i", [0, 2]), _array.array("i", [1, 0]),
+          _array.array("d", [1, 2]), labels), ValueError),
+        ((_array.array("i", [0, 2]), _array.array("i", [1, 1]),
+          _array.array("d", [1, 2]), labels), ValueError),
+        ((indptr, indices, data, _array.array("d", [1e20])), ValueError),
+        ((indptr, indices, data, _array.array("d", [float("nan")])),
+         ValueError),
+    ]:
+        with raises(exc):
+            _pyliblinear.FeatureMatrix.from_csr(*args)
+
+
+def test_matrix_from_dense():
+    """FeatureMatrix.from_dense from two-dimensional buffers"""
+    values = [
+        0, 1.5, 0, 0, 0, 0, 0, -2, 0.25,
+        0, 0, 0, -0.0, 0, 0, 0, 0, 0,
+        3, 0, 0, 0, 0, 0, 0, 0, float("inf"),
+    ]
+    for typecode in ["d", "f"]:
+        buf = memoryview(_array.array(typecode, values))
+        buf = buf.cast("B").cast(typecode, [3, 9])
+        matrix = _pyliblinear.FeatureMatrix.from_dense(
+            buf, _array.array("d", [1, 2, 3])
+        )
+        assert matrix.width == 9
+        assert matrix.height == 3
+        assert list(matrix.labels()) == [1.0, 2.0, 3.0]
+        assert list(matrix.features()) == [
+            {2: 1.5, 8: -2.0, 9: 0.25}, {}, {1: 3.0, 9: float("inf")}
+        ]
+
+    buf = memoryview(_array.array("i", [1, 0, 2, 0] * 2))
+    matrix = _pyliblinear.FeatureMatrix.from_dense(
+        buf.cast("B").cast("i", [2, 4]), _array.array("i", [1, 2])
+    )
+    assert matrix.width == 3
+    assert list(matrix.features()) == [{1: 1.0, 3: 2.0}] * 2
+
+    buf = memoryview(_array.array("f", values)).cast("B").cast("f", [3, 9])
+    matrix = _pyliblinear.FeatureMatrix.from_dense(
+        buf, _array.array("i", [1, 2, 3]), threshold=1.5
+    )
+    assert matrix.width == 9
+    assert list(matrix.features()) == [
+        {8: -2.0}, {}, {1: 3.0, 9: float("inf")}
+    ]
+
+    for args, exc in [
+        ((_array.array("d", values), [1, 2, 3]), TypeError),
+        ((buf, _array.array("i", [1, 2])), ValueError),
+        ((buf, _array.array("i", [1, 2, 3]), -1), ValueError),
+    ]:
+        with raises(exc):
+            _pyliblinear.FeatureMatrix.from_dense(*args)
+
+
+def test_matrix_cross_validate():
+    """FeatureMatrix.cross_validate with seeded, parallel folds"""
+    with _bz2.BZ2File(fix_path("a1a.bz2")) as fp:
+        matrix = _pyliblinear.FeatureMatrix.load(fp)
+
+    solver = _pyliblinear.Solver("L2R_LR")
+    acc, mse, scc = matrix.cross_validate(5, solver, seed=42)
+    assert 0.8 < acc < 0.9
+    assert abs(mse - (1.0 - acc) * 4) < 1e-12
+    assert (acc, mse, scc) == matrix.cross_validate(5, solver, None, 42)
+    assert (acc, mse, scc) == matrix.cross_validate(
+        5, _pyliblinear.Solver("L2R_LR", threads=4), seed=42
+    )
+    assert (acc, mse, scc) != matrix.cross_validate(5, solver)
+    assert (acc, mse, scc) == matrix.cross_validate(
+        5, _pyliblinear.Solver("L2R_LR", seed=42)
+    )
+
+    with raises(ValueError):
+        matrix.cross_validate(1)
+    with raises(TypeError):
+        matrix.cross_validate(5, seed="x")
+    with raises(ValueError):
+        _pyliblinear.FeatureMatrix.from_iterables([], []).cross_validate(5)
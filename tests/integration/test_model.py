@@ -28,7 +28,16 @@ Tests for pyliblinear.Model
 __author__ = u"Andr\xe9 Malo"
 
 import bz2 as _bz2
+import io as _io
+import json as _json
+import math as _math
 import os as _os
+import random as _random
+import subprocess as _subprocess
+import sys as _sys
+import threading as _threading
+
+from pytest import raises
 
 import pyliblinear as _pyliblinear
 
@@ -57,7 +66,7 @@ def test_model_train_save_load_predict(tmpdir):
     result = {}
     for item in model.predict(matrix):
         result[item] = result.get(item, 0) + 1
-    assert result == {-1.0: 24495, 1.0: 6461}
+    assert result == {-1.0: 24558, 1.0: 6398}
 
     model = _pyliblinear.Model.load(filename, mmap=True)
 
@@ -65,4 +74,507 @@ def test_model_train_save_load_predict(tmpdir):
     for item, dec in model.predict(matrix, label_only=False):
         result[item] = result.get(item, 0) + 1
         assert list(dec) == [1.0]
-    assert result == {-1.0: 24495, 1.0: 6461}
+    assert result == {-1.0: 24558, 1.0: 6398}
+
+
+def _dump(model):
+    """Serialize model"""
+    stream = _io.StringIO()
+    model.save(stream)
+    return stream.getvalue()
+
+
+def test_model_train_threads():
+    """Model.train on the same matrix from multiple threads"""
+    with _bz2.BZ2File(fix_path("a1a.bz2")) as fp:
+        matrix = _pyliblinear.FeatureMatrix.load(fp)
+
+    # The solvers seed their random numbers per training, so the results
+    # are stable. L1R_LR uses the transposed vectors, too.
+    for solver_type in ("L2R_LR", "L1R_LR"):
+        solver = _pyliblinear.Solver(solver_type)
+        biases = [None, 1.0, 2.0, 1.0]
+        expected = [
+            _dump(_pyliblinear.Model.train(matrix, solver, bias))
+            for bias in biases
+        ]
+        assert expected[1] != expected[2]
+
+        results = {}
+
+        def run(idx, bias):
+            """Train a few times"""
+            results[idx] = [
+                _dump(_pyliblinear.Model.train(matrix, solver, bias))
+                for _ in range(3)
+            ]
+
+        # A pending prediction keeps its bias nodes in use
+        model = _pyliblinear.Model.train(matrix, solver, 3.0)
+        predicted = model.predict(matrix)
+        first = next(predicted)
+
+        threads = [
+            _threading.Thread(target=run, args=(idx, bias))
+            for idx, bias in enumerate(biases)
+        ]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+
+        for idx, result in sorted(results.items()):
+            assert result == [expected[idx]] * 3
+        assert len(results) == len(biases)
+
+        assert [first] + list(predicted) == list(model.predict(matrix))
+
+
+def _weights(model):
+    """Extract the weights of a model"""
+    return [float(item) for item in _dump(model).split("w\n", 1)[1].split()]
+
+
+def test_model_train_solver_threads():
+    """Model.train with a multi-threaded primal solver"""
+    with _bz2.BZ2File(fix_path("a1a.t.bz2")) as fp:
+        matrix = _pyliblinear.FeatureMatrix.load(fp)
+
+    for solver_type in ("L2R_LR", "L2R_L2LOSS_SVC", "L2R_L2LOSS_SVR"):
+        expected = _weights(_pyliblinear.Model.train(
+            matrix, _pyliblinear.Solver(solver_type), 1.0
+        ))
+        result = _weights(_pyliblinear.Model.train(
+            matrix, _pyliblinear.Solver(solver_type, threads=4), 1.0
+        ))
+
+        # Only the summation order differs
+        assert len(result) == len(expected)
+        for weight, expected_weight in zip(result, expected):
+            assert abs(weight - expected_weight) < 1e-6
+
+
+_KERNELS_SCRIPT = r"""
+import io, json, random, sys
+import pyliblinear
+
+rnd = random.Random(11)
+hidden = dict((j, rnd.random() - 0.5) for j in range(1, 2001))
+labels, rows = [], []
+for _ in range(500):
+    row = dict((j, rnd.random()) for j in rnd.sample(range(1, 2001), 60))
+    labels.append(1 if sum(hidden[j] * v for j, v in row.items()) > 0 else 2)
+    rows.append(row)
+matrix = pyliblinear.FeatureMatrix.from_iterables(labels, rows)
+
+result = {}
+for solver_type in ("L2R_LR", "L2R_L2LOSS_SVC_DUAL", "L2R_L2LOSS_SVR"):
+    model = pyliblinear.Model.train(matrix, pyliblinear.Solver(solver_type))
+    fp = io.StringIO()
+    model.save(fp)
+    result[solver_type] = [
+        [float(item) for item in fp.getvalue().split("w\n", 1)[1].split()],
+        list(model.predict(matrix)),
+    ]
+json.dump(result, sys.stdout)
+"""
+
+
+def _train_kernels(**env):
+    """Train with the kernels selected by env in a fresh interpreter"""
+    env = dict(_os.environ, **env)
+    env["PYTHONPATH"] = _os.pathsep.join(path for path in _sys.path if path)
+    return _json.loads(_subprocess.check_output(
+        [_sys.executable, "-c", _KERNELS_SCRIPT], env=env
+    ).decode("ascii"))
+
+
+def test_model_train_kernels():
+    """Model.train with the AVX2 and with the scalar sparse kernels"""
+    # The default kernels are AVX2 ones where the CPU supports it
+    expected = _train_kernels(LIBLINEAR_NO_AVX2="1")
+    result = _train_kernels()
+
+    assert sorted(result) == sorted(expected)
+    for solver_type, (weights, predicted) in result.items():
+        # Only the summation order differs
+        assert len(weights) == len(expected[solver_type][0])
+        for weight, expected_weight in zip(weights, expected[solver_type][0]):
+            assert abs(weight - expected_weight) < 1e-6
+        for value, expected_value in zip(predicted, expected[solver_type][1]):
+            assert abs(value - expected_value) < 1e-6
+
+
+def test_model_train_ovr_threads():
+    """Model.train trains one-vs-rest classes in parallel"""
+    with _bz2.BZ2File(fix_path("a1a.bz2")) as fp:
+        matrix = _pyliblinear.FeatureMatrix.load(fp)
+
+    features = list(matrix.features())
+    labels = [min(vector) % 5 for vector in features]
+    matrix = _pyliblinear.FeatureMatrix.from_iterables(labels, features)
+
+    for solver_type in ("L2R_LR", "L2R_L2LOSS_SVC", "L2R_L2LOSS_SVC_DUAL",
+                        "L2R_L1LOSS_SVC_DUAL", "L2R_LR_DUAL", "L1R_LR",
+                        "L1R_L2LOSS_SVC"):
+        expected = _dump(_pyliblinear.Model.train(
+            matrix, _pyliblinear.Solver(solver_type), 1.0
+        ))
+        assert expected.startswith(
+            "solver_type %s\nnr_class 5\n" % solver_type
+        )
+        for threads in (2, 5, 8):
+            assert expected == _dump(_pyliblinear.Model.train(
+                matrix, _pyliblinear.Solver(solver_type, threads=threads), 1.0
+            ))
+
+
+def test_model_train_transposed():
+    """Model.train transposes the matrix in parallel for the L1R solvers"""
+    rnd = _random.Random(5)
+    labels, rows = [], []
+    for _ in range(10000):
+        rows.append(dict((j, rnd.random())
+                         for j in rnd.sample(range(1, 501), 10)))
+        labels.append(rnd.choice((1, 2, 3)))
+
+    def matrix():
+        """Fresh matrix, without transposed vectors yet"""
+        return _pyliblinear.FeatureMatrix.from_iterables(labels, rows)
+
+    for solver_type in ("L1R_LR", "L1R_L2LOSS_SVC"):
+        expected = [
+            _dump(_pyliblinear.Model.train(
+                matrix(), _pyliblinear.Solver(solver_type), bias
+            ))
+            for bias in (None, 1.0)
+        ]
+
+        # The transposed vectors are the same for any number of threads and
+        # are reused with any bias
+        threaded = matrix()
+        solver = _pyliblinear.Solver(solver_type, threads=4)
+        for bias in (1.0, None, 2.0, 1.0):
+            result = _dump(_pyliblinear.Model.train(threaded, solver, bias))
+            if bias is None:
+                assert result == expected[0]
+            elif bias == 1.0:
+                assert result == expected[1]
+
+
+def test_model_train_hogwild():
+    """Model.train with a multi-threaded dual solver"""
+    with _bz2.BZ2File(fix_path("a1a.t.bz2")) as fp:
+        matrix = _pyliblinear.FeatureMatrix.load(fp)
+    with _bz2.BZ2File(fix_path("a1a.bz2")) as fp:
+        test = _pyliblinear.FeatureMatrix.load(fp)
+    labels = list(test.labels())
+
+    def accuracy(model):
+        """Fraction of the test rows predicted correctly"""
+        predicted = model.predict(test, label_only=True)
+        return sum(a == b for a, b in zip(predicted, labels)) / len(labels)
+
+    for solver_type in ("L2R_L2LOSS_SVC_DUAL", "L2R_L1LOSS_SVC_DUAL",
+                        "L2R_LR_DUAL"):
+        expected = _pyliblinear.Model.train(
+            matrix, _pyliblinear.Solver(solver_type)
+        )
+
+        # A single thread runs the sequential solver
+        assert _dump(expected) == _dump(_pyliblinear.Model.train(
+            matrix, _pyliblinear.Solver(solver_type, hogwild=True)
+        ))
+
+        model = _pyliblinear.Model.train(
+            matrix, _pyliblinear.Solver(solver_type, threads=4, hogwild=True)
+        )
+        assert abs(accuracy(model) - accuracy(expected)) < 0.01
+
+
+def test_model_train_shotgun():
+    """Model.train with a multi-threaded L1R solver"""
+    rnd = _random.Random(3)
+    width = 10000
+    hidden = dict((j, rnd.gauss(0, 1))
+                  for j in rnd.sample(range(1, width + 1), 100))
+    labels, rows = [], []
+    for _ in range(2000):
+        row = dict((j, rnd.random())
+                   for j in rnd.sample(range(1, width + 1), 20))
+        margin = sum(hidden.get(j, 0) * value for j, value in row.items())
+        labels.append(1 if margin + rnd.gauss(0, 0.3) > 0 else -1)
+        rows.append(row)
+    matrix = _pyliblinear.FeatureMatrix.from_iterables(labels, rows)
+
+    def objective(model, loss):
+        """Objective value of a trained model"""
+        weights = _weights(model)
+        first = _dump(model).split("\nlabel ", 1)[1].split()[0]
+        sign = 1 if first == "1" else -1
+        result = sum(abs(weight) for weight in weights)
+        for label, row in zip(labels, rows):
+            margin = sign * sum(weights[j - 1] * value
+                                for j, value in row.items())
+            result += loss(label * margin)
+        return result
+
+    for solver_type, loss in (
+        ("L1R_LR", lambda z: _math.log1p(_math.exp(-z))),
+        ("L1R_L2LOSS_SVC", lambda z: max(0.0, 1 - z) ** 2),
+    ):
+        expected = objective(_pyliblinear.Model.train(
+            matrix, _pyliblinear.Solver(solver_type, eps=1e-4)
+        ), loss)
+        result = objective(_pyliblinear.Model.train(
+            matrix, _pyliblinear.Solver(solver_type, eps=1e-4, threads=4,
+                                        hogwild=True)
+        ), loss)
+        assert abs(result - expected) < 1e-4 * expected
+
+
+def test_model_train_init():
+    """Model.train warm starts from another model"""
+    with _bz2.BZ2File(fix_path("a1a.bz2")) as fp:
+        matrix = _pyliblinear.FeatureMatrix.load(fp)
+    features = list(matrix.features())
+
+    solver = _pyliblinear.Solver("L2R_LR")
+    model = _pyliblinear.Model.train(matrix, solver, 1.0)
+    assert _weights(model) == _weights(
+        _pyliblinear.Model.train(matrix, solver, 1.0, init=model)
+    )
+
+    # The classes are matched by label
+    labels = [min(vector) % 3 for vector in features]
+    model = _pyliblinear.Model.train(
+        _pyliblinear.FeatureMatrix.from_iterables(labels, features), solver
+    )
+    reversed_matrix = _pyliblinear.FeatureMatrix.from_iterables(
+        labels[::-1], features[::-1]
+    )
+    expected = _weights(_pyliblinear.Model.train(reversed_matrix, solver))
+    result = _weights(
+        _pyliblinear.Model.train(reversed_matrix, solver, init=model)
+    )
+    assert len(result) == len(expected)
+    for weight, expected_weight in zip(result, expected):
+        assert abs(weight - expected_weight) < 1e-6
+
+    small = _pyliblinear.FeatureMatrix.from_iterables([0, 1], [{1: 1}, {2: 1}])
+    for args, exc in [
+        ((matrix, solver, None, "model"), TypeError),
+        ((matrix, _pyliblinear.Solver("L1R_LR"), None, model), ValueError),
+        ((matrix, _pyliblinear.Solver("L2R_L2LOSS_SVR"), None, model),
+         ValueError),
+        ((matrix, solver, None, model), ValueError),
+        ((small, solver, None, model), ValueError),
+    ]:
+        with raises(exc):
+            _pyliblinear.Model.train(*args)
+
+
+def test_model_train_path():
+    """Model.train_path trains a warm started sequence of C values"""
+    with _bz2.BZ2File(fix_path("a1a.bz2")) as fp:
+        matrix = _pyliblinear.FeatureMatrix.load(fp)
+    features = list(matrix.features())
+    labels = [min(vector) % 3 for vector in features]
+    multi = _pyliblinear.FeatureMatrix.from_iterables(labels, features)
+
+    for solver_type, train_matrix in [
+        ("L2R_LR", matrix), ("L2R_L2LOSS_SVC", multi),
+        ("L2R_L2LOSS_SVR", matrix),
+    ]:
+        solver = _pyliblinear.Solver(solver_type, eps=1e-7)
+        path = _pyliblinear.Model.train_path(
+            train_matrix, solver, (4, 0.25, 1), 1.0
+        )
+        assert [C for C, _ in path] == [0.25, 1.0, 4.0]
+        for C, model in path:
+            expected = _weights(_pyliblinear.Model.train(
+                train_matrix, _pyliblinear.Solver(solver_type, C=C, eps=1e-7),
+                1.0
+            ))
+            result = _weights(model)
+            assert len(result) == len(expected)
+            for weight, expected_weight in zip(result, expected):
+                assert abs(weight - expected_weight) < 1e-3
+
+    assert _pyliblinear.Model.train_path(matrix, None, []) == []
+    for args, exc in [
+        ((matrix, None, None), TypeError),
+        ((matrix, None, [1, 0]), ValueError),
+        ((matrix, None, [None]), TypeError),
+    ]:
+        with raises(exc):
+            _pyliblinear.Model.train_path(*args)
+
+
+def test_model_train_dense_bias():
+    """Model.train on long rows doesn't depend on the previous biases"""
+    features = [
+        dict((j, float((i * 7 + j * 13) % 17 - 8)) for j in range(1, 41))
+        for i in range(300)
+    ]
+    labels = [i % 2 for i in range(300)]
+
+    for solver_type in ("L2R_LR", "L2R_L2LOSS_SVR"):
+        solver = _pyliblinear.Solver(solver_type)
+        expected = _dump(_pyliblinear.Model.train(
+            _pyliblinear.FeatureMatrix.from_iterables(labels, features),
+            solver, 0.5
+        ))
+
+        matrix = _pyliblinear.FeatureMatrix.from_iterables(labels, features)
+        unbiased = _dump(_pyliblinear.Model.train(matrix, solver))
+        assert _dump(_pyliblinear.Model.train(matrix, solver, 2.0)) not in (
+            expected, unbiased
+        )
+        assert _dump(_pyliblinear.Model.train(matrix, solver, 0.5)) == expected
+        assert _dump(_pyliblinear.Model.train(matrix, solver)) == unbiased
+
+
+def test_model_train_seed():
+    """Model.train draws the random numbers from the solver's seed"""
+    with _bz2.BZ2File(fix_path("a1a.bz2")) as fp:
+        matrix = _pyliblinear.FeatureMatrix.load(fp)
+
+    for solver_type in ("L2R_L2LOSS_SVC_DUAL", "MCSVM_CS", "L1R_LR",
+                        "L2R_L1LOSS_SVR_DUAL"):
+        expected = [
+            _dump(_pyliblinear.Model.train(
+                matrix, _pyliblinear.Solver(solver_type, seed=seed)
+            ))
+            for seed in (1, 2)
+        ]
+        assert expected[0] != expected[1]
+
+        # Independent of other trainings in between
+        assert expected == [
+            _dump(_pyliblinear.Model.train(
+                matrix, _pyliblinear.Solver(solver_type, seed=seed)
+            ))
+            for seed in (1, 2)
+        ]
+
+
+def test_model_train_limits():
+    """Model.train marks models stopped by the solver's limits"""
+    with _bz2.BZ2File(fix_path("a1a.bz2")) as fp:
+        matrix = _pyliblinear.FeatureMatrix.load(fp)
+
+    for solver_type in ("L2R_LR", "L2R_L2LOSS_SVC_DUAL", "L1R_LR",
+                        "L1R_L2LOSS_SVC", "MCSVM_CS", "ONECLASS_SVM"):
+        model = _pyliblinear.Model.train(
+            matrix, _pyliblinear.Solver(solver_type)
+        )
+        assert model.converged is True
+
+        model = _pyliblinear.Model.train(
+            matrix, _pyliblinear.Solver(solver_type, max_iter=1, eps=1e-9)
+        )
+        assert model.converged is False
+
+    model = _pyliblinear.Model.train(
+        matrix, _pyliblinear.Solver("L2R_LR", max_iter=1000)
+    )
+    assert model.converged is True
+
+    fp = _io.StringIO()
+    _pyliblinear.Model.train(
+        matrix, _pyliblinear.Solver("L2R_LR", max_iter=1, eps=1e-9)
+    ).save(fp)
+    fp.seek(0)
+    assert _pyliblinear.Model.load(fp).converged is True
+
+
+def test_model_train_cancel():
+    """Model.train stops early on a canceled handle"""
+    with _bz2.BZ2File(fix_path("a1a.bz2")) as fp:
+        matrix = _pyliblinear.FeatureMatrix.load(fp)
+
+    cancel = _pyliblinear.Cancel()
+    assert cancel.canceled is False
+    solver = _pyliblinear.Solver("L2R_L2LOSS_SVC_DUAL", eps=1e-9)
+    assert _pyliblinear.Model.train(matrix, solver,
+                                    cancel=cancel).converged is True
+
+    cancel.cancel()
+    assert cancel.canceled is True
+    model = _pyliblinear.Model.train(matrix, solver, cancel=cancel)
+    assert model.converged is False
+    assert len(list(model.predict(matrix))) == matrix.height
+
+    result = _pyliblinear.Model.train_path(matrix, solver, [0.5, 1],
+                                           cancel=cancel)
+    assert [model.converged for _, model in result] == [False, False]
+
+    cancel.reset()
+    assert cancel.canceled is False
+
+    # Canceled from another thread
+    timer = _threading.Timer(0.2, cancel.cancel)
+    timer.start()
+    try:
+        model = _pyliblinear.Model.train(
+            matrix, _pyliblinear.Solver("L2R_L2LOSS_SVC_DUAL", C=1e5,
+                                        eps=1e-12, max_iter=10 ** 9),
+            cancel=cancel
+        )
+    finally:
+        timer.join()
+    assert model.converged is False
+
+    with raises(TypeError):
+        _pyliblinear.Model.train(matrix, cancel=object())
+
+
+def test_model_train_stats():
+    """Model.train records the progress of the solvers on request"""
+    with _bz2.BZ2File(fix_path("a1a.bz2")) as fp:
+        matrix = _pyliblinear.FeatureMatrix.load(fp)
+
+    assert _pyliblinear.Model.train(matrix).stats is None
+
+    solver = _pyliblinear.Solver("L2R_LR")
+    stats = _pyliblinear.Model.train(matrix, solver, stats=True).stats
+    assert stats["prepare_time"] >= 0
+    assert stats["solve_time"] > 0
+    assert len(stats["runs"]) == 1
+
+    run = stats["runs"][0]
+    assert run["solver_type"] == "L2R_LR"
+    assert run["label"] is None
+    assert run["Xv_calls"] > 0 and run["Hv_calls"] > 0
+    assert [it["iter"] for it in run["iterations"]] == list(
+        range(len(run["iterations"]))
+    )
+    first, last = run["iterations"][0], run["iterations"][-1]
+    assert first["step_size"] is None
+    assert first["f"] > last["f"] == run["objective"]
+    assert last["inner_iter"] > 0 and last["line_search"] > 0
+    assert last["active_size"] is None
+
+    # one-vs-rest: one run per class
+    labels = [(j % 3) + 1 for j in range(matrix.height)]
+    matrix = _pyliblinear.FeatureMatrix.from_iterables(
+        labels, list(matrix.features())
+    )
+    for threads in (1, 3):
+        stats = _pyliblinear.Model.train(
+            matrix, _pyliblinear.Solver("L2R_L2LOSS_SVC_DUAL", threads=threads),
+            stats=True
+        ).stats
+        assert [run["label"] for run in stats["runs"]] == [1.0, 2.0, 3.0]
+        for run in stats["runs"]:
+            assert run["Xv_calls"] == 0
+            it = run["iterations"][-1]
+            assert it["f"] is None
+            assert 0 < it["active_size"] <= matrix.height
+
+    result = _pyliblinear.Model.train_path(
+        matrix, _pyliblinear.Solver("L1R_LR"), [0.5, 1], stats=True
+    )
+    assert [len(model.stats["runs"]) for _, model in result] == [3, 3]
+    assert result[1][1].stats["prepare_time"] == 0
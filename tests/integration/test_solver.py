@@ -27,8 +27,17 @@ Tests for pyliblinear.Solver.
 """
 __author__ = u"Andr\xe9 Malo"
 
+import bz2 as _bz2
+import os as _os
+
+from pytest import raises
+
 import pyliblinear as _pyliblinear
 
+def fix_path(name):
+    """Find fixture"""
+    return _os.path.join(_os.path.dirname(__file__), "fixtures", name)
+
 
 def test_solver_default():
     """Solver initializes with default arguments"""
@@ -39,6 +48,9 @@ def test_solver_default():
     assert solver.eps == 0.1
     assert solver.p == 0.1
     assert solver.weights() == {}
+    assert solver.threads == 1
+    assert solver.seed == 0
+    assert solver.hogwild is False
 
 
 def test_solver_types():
@@ -100,3 +112,79 @@ def test_solver_param():
     assert solver.eps == 0.0001
     assert solver.p == 3.0
     assert solver.weights() == {2: 5.0, 3: 4.0, 6: 9.5}
+
+
+def test_solver_threads():
+    """Solver accepts the number of threads"""
+    solver = _pyliblinear.Solver("L2R_LR", threads=4)
+    assert solver.threads == 4
+
+    for threads in (0, -1):
+        with raises(ValueError):
+            _pyliblinear.Solver("L2R_LR", threads=threads)
+
+
+def test_solver_seed():
+    """Solver accepts a seed"""
+    assert _pyliblinear.Solver(seed=42).seed == 42
+    assert _pyliblinear.Solver(seed=-1).seed == 2 ** 64 - 1
+
+    with raises(TypeError):
+        _pyliblinear.Solver(seed=1.5)
+
+
+def test_solver_hogwild():
+    """Solver accepts the hogwild flag"""
+    assert _pyliblinear.Solver(hogwild=True).hogwild is True
+    assert _pyliblinear.Solver(hogwild=0).hogwild is False
+
+
+def test_solver_limits():
+    """Solver accepts an iteration and a time limit"""
+    solver = _pyliblinear.Solver()
+    assert solver.max_iter is None
+    assert solver.time_limit is None
+
+    solver = _pyliblinear.Solver(max_iter=5, time_limit=2.5)
+    assert solver.max_iter == 5
+    assert solver.time_limit == 2.5
+
+    for kwargs in ({"max_iter": 0}, {"time_limit": 0}, {"time_limit": -1}):
+        with raises(ValueError):
+            _pyliblinear.Solver(**kwargs)
+
+
+def test_solver_find_parameters():
+    """Solver.find_parameters searches C (and p)"""
+    with _bz2.BZ2File(fix_path("a1a.bz2")) as fp:
+        matrix = _pyliblinear.FeatureMatrix.load(fp)
+
+    for solver_type in ("L2R_LR", "L2R_L2LOSS_SVC"):
+        for threads in (1, 4):
+            solver = _pyliblinear.Solver(solver_type, threads=threads)
+            best_C, best_p, score = solver.find_parameters(
+                matrix, 5, start_C=0.125
+            )
+            assert best_C in [0.125 * 2 ** j for j in range(14)]
+            assert best_p is None
+            assert 0.8 < score < 0.9
+
+    solver = _pyliblinear.Solver("L2R_L2LOSS_SVR", threads=2)
+    best_C, best_p, score = solver.find_parameters(
+        matrix, 3, start_C=1, start_p=0.1, bias=1
+    )
+    assert best_C >= 1
+    assert best_p in (0.0, 0.05, 0.1)
+    assert 0 < score < 1
+
+    with raises(ValueError):
+        _pyliblinear.Solver("L1R_LR").find_parameters(matrix, 5)
+    for args in ((1,), (5, 0), (5, None, -1), (5, None, None, -1)):
+        with raises(ValueError):
+            _pyliblinear.Solver("L2R_LR").find_parameters(matrix, *args)
+    with raises(ValueError):
+        _pyliblinear.Solver("L2R_LR").find_parameters(
+            _pyliblinear.FeatureMatrix.from_iterables([], []), 5
+        )
+    with raises(TypeError):
+        _pyliblinear.Solver("L2R_LR").find_parameters(None, 5)